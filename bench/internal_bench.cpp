@@ -0,0 +1,175 @@
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../jackclient/audiokernels.h"
+#include "../jackclient/connections.h"
+#include "../jackclient/cyclestats.h"
+#include "../jackclient/internalclient.h"
+#include "../jackclient/jackclient.h"
+
+// One link of a chain of pass-through clients. The same class runs as an
+// external client inside this process and, built with -DJACKCLIENT_INTERNAL,
+// as an internal client inside the server. The load_init string names a file
+// that receives the cycle statistics when the client goes away.
+class BenchClient : public JackClient {
+   private:
+    std::string statsPath;
+    std::unique_ptr<JackAudioInputPort> in;
+    std::unique_ptr<JackAudioOutputPort> out;
+
+   public:
+    explicit BenchClient(const char* statsPath) : JackClient("bench"), statsPath(statsPath) {
+        open();
+        this->in = this->createAudioInputPort("in");
+        this->out = this->createAudioOutputPort("out");
+        activate();
+    };
+    ~BenchClient() {
+        // The name may point into the client's connection, which close() frees.
+        std::string name = this->getName();
+        this->close();
+        if (this->statsPath.empty()) return;
+        JackCycleStats& stats = this->getCycleStats();
+        if (FILE* file = fopen(this->statsPath.c_str(), "a")) {
+            fprintf(file, "%s %llu %f %f %f %f\n", name.c_str(),
+                    (unsigned long long)stats.getCycleCount(), stats.getWakeupPercentile(50),
+                    stats.getWakeupPercentile(99), stats.getDurationPercentile(50),
+                    stats.getAverageLoad());
+            fclose(file);
+        }
+    };
+
+   protected:
+    int onProcess(const JackPortBuffers& buffers, uint32_t nframes) {
+        AudioKernels::copy(buffers.getBuffer(*out), buffers.getBuffer(*in), nframes);
+        return 0;
+    };
+};
+
+#ifdef JACKCLIENT_INTERNAL
+JACKCLIENT_INTERNAL_CLIENT(BenchClient)
+#else
+class Controller : public JackClient {
+   public:
+    Controller() : JackClient("bench_control") {
+        open();
+        activate();
+    };
+    ~Controller() { this->close(); };
+    int onProcess(const JackPortBuffers& buffers, uint32_t nframes) { return 0; };
+    float getServerLoad() { return jack_cpu_load(this->getHandle()); };
+};
+
+struct Result {
+    uint64_t cycles = 0;
+    float wakeupMedian = 0, wakeupP99 = 0, durationMedian = 0;
+    float serverLoad = 0;
+};
+
+// Connects the chain in order and lets it run, sampling the server's DSP load.
+static Result run(Controller& controller, const std::vector<std::string>& names, int seconds) {
+    JackConnector connector(&controller);
+    JackConnectionPlan plan;
+    for (size_t i = 0; i + 1 < names.size(); i++)
+        plan.connect(names[i] + ":out", names[i + 1] + ":in");
+    connector.apply(plan);
+    Result result;
+    int samples = 0;
+    for (auto end = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+         std::chrono::steady_clock::now() < end; samples++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        result.serverLoad += controller.getServerLoad();
+    }
+    result.serverLoad /= samples ? samples : 1;
+    return result;
+}
+
+// The statistics of the last client in the chain: its wakeup is the time the
+// signal needed to travel through all clients before it.
+static void collect(Result& result, const std::string& statsPath, const std::string& last) {
+    FILE* file = fopen(statsPath.c_str(), "r");
+    if (!file) return;
+    char name[256];
+    unsigned long long cycles;
+    float wakeupMedian, wakeupP99, durationMedian, load;
+    while (fscanf(file, "%255s %llu %f %f %f %f", name, &cycles, &wakeupMedian, &wakeupP99,
+                  &durationMedian, &load) == 6) {
+        if (last != name) continue;
+        result.cycles = cycles;
+        result.wakeupMedian = wakeupMedian;
+        result.wakeupP99 = wakeupP99;
+        result.durationMedian = durationMedian;
+    }
+    fclose(file);
+}
+
+static void print(const char* mode, const Result& result) {
+    printf("%-9s %10llu %12.1f %12.1f %12.2f %10.1f%%\n", mode, (unsigned long long)result.cycles,
+           result.wakeupMedian, result.wakeupP99, result.durationMedian, result.serverLoad);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr,
+                "usage: %s /absolute/path/internal_bench.so [clients=8] [seconds=10]\n"
+                "Start jackd first, e.g. jackd -d dummy -p 64\n",
+                argv[0]);
+        return 1;
+    }
+    std::string object = argv[1];
+    int clients = argc > 2 ? atoi(argv[2]) : 8;
+    int seconds = argc > 3 ? atoi(argv[3]) : 10;
+    std::string statsPath = "/tmp/internal_bench." + std::to_string(getpid());
+
+    try {
+        Controller controller;
+        printf("%d clients, period %u frames at %u Hz\n", clients, controller.getBufferSize(),
+               controller.getSampleRate());
+        printf("%-9s %10s %12s %12s %12s %11s\n", "mode", "cycles", "chain p50us",
+               "chain p99us", "client p50us", "server DSP");
+
+        std::string last;
+        Result external;
+        {
+            std::vector<std::unique_ptr<BenchClient>> chain;
+            std::vector<std::string> names;
+            for (int i = 0; i < clients; i++) {
+                chain.emplace_back(new BenchClient(statsPath.c_str()));
+                names.push_back(chain.back()->getName());
+            }
+            external = run(controller, names, seconds);
+            last = names.back();
+        }
+        collect(external, statsPath, last);
+        unlink(statsPath.c_str());
+        print("external", external);
+
+        Result internal;
+        {
+            std::vector<std::unique_ptr<JackInternalClient>> chain;
+            std::vector<std::string> names;
+            for (int i = 0; i < clients; i++) {
+                std::string name = "bench_internal_" + std::to_string(i);
+                chain.emplace_back(new JackInternalClient(&controller, name, object, statsPath));
+                names.push_back(chain.back()->getName());
+            }
+            internal = run(controller, names, seconds);
+            last = names.back();
+        }
+        collect(internal, statsPath, last);
+        unlink(statsPath.c_str());
+        print("internal", internal);
+    } catch (JackClientException& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
+#endif
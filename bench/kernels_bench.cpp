@@ -0,0 +1,110 @@
+#include <math.h>
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+#include "../jackclient/audiokernels.h"
+
+using namespace AudioKernels;
+
+static volatile float sink;
+
+static double timeCall(uint32_t nframes, const std::function<void()>& call) {
+    uint32_t repeats = (1u << 22) / nframes;
+    call();
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < repeats; i++) call();
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start)
+               .count() /
+           repeats;
+}
+
+struct Case {
+    const char* name;
+    std::function<void(float* dst, const float* src, float* const* planar, uint32_t n)> kernel;
+    std::function<void(float* dst, const float* src, float* const* planar, uint32_t n)> naive;
+};
+
+int main() {
+    const uint32_t maxFrames = 2048;
+    // One extra float so "unaligned" runs can start one sample into the buffers.
+    std::vector<float> srcStorage(2 * maxFrames + 16), dstStorage(2 * maxFrames + 16);
+    std::vector<float> left(maxFrames), right(maxFrames);
+    for (size_t i = 0; i < srcStorage.size(); i++) srcStorage[i] = sinf(i * 0.01f);
+    float* planar[] = {left.data(), right.data()};
+
+    std::vector<Case> cases = {
+        {"clear", [](float* d, const float*, float* const*, uint32_t n) { clear(d, n); },
+         [](float* d, const float*, float* const*, uint32_t n) {
+             for (uint32_t i = 0; i < n; i++) d[i] = 0.0f;
+         }},
+        {"copy", [](float* d, const float* s, float* const*, uint32_t n) { copy(d, s, n); },
+         [](float* d, const float* s, float* const*, uint32_t n) {
+             for (uint32_t i = 0; i < n; i++) d[i] = s[i];
+         }},
+        {"gain", [](float* d, const float* s, float* const*, uint32_t n) { gain(d, s, 0.5f, n); },
+         [](float* d, const float* s, float* const*, uint32_t n) {
+             for (uint32_t i = 0; i < n; i++) d[i] = s[i] * 0.5f;
+         }},
+        {"mixAdd",
+         [](float* d, const float* s, float* const*, uint32_t n) { mixAdd(d, s, 0.5f, n); },
+         [](float* d, const float* s, float* const*, uint32_t n) {
+             for (uint32_t i = 0; i < n; i++) d[i] += s[i] * 0.5f;
+         }},
+        {"gainRamp",
+         [](float* d, const float* s, float* const*, uint32_t n) { gainRamp(d, s, 0.0f, 1.0f, n); },
+         [](float* d, const float* s, float* const*, uint32_t n) {
+             float g = 0.0f, step = 1.0f / n;
+             for (uint32_t i = 0; i < n; i++, g += step) d[i] = s[i] * g;
+         }},
+        {"interleave",
+         [](float* d, const float*, float* const* p, uint32_t n) { interleave(d, p, 2, n); },
+         [](float* d, const float*, float* const* p, uint32_t n) {
+             for (uint32_t i = 0; i < n; i++) {
+                 d[2 * i] = p[0][i];
+                 d[2 * i + 1] = p[1][i];
+             }
+         }},
+        {"deinterleave",
+         [](float*, const float* s, float* const* p, uint32_t n) { deinterleave(p, s, 2, n); },
+         [](float*, const float* s, float* const* p, uint32_t n) {
+             for (uint32_t i = 0; i < n; i++) {
+                 p[0][i] = s[2 * i];
+                 p[1][i] = s[2 * i + 1];
+             }
+         }},
+        {"peak", [](float*, const float* s, float* const*, uint32_t n) { sink = peak(s, n); },
+         [](float*, const float* s, float* const*, uint32_t n) {
+             float m = 0.0f;
+             for (uint32_t i = 0; i < n; i++) m = fmaxf(m, fabsf(s[i]));
+             sink = m;
+         }},
+        {"rms", [](float*, const float* s, float* const*, uint32_t n) { sink = rms(s, n); },
+         [](float*, const float* s, float* const*, uint32_t n) {
+             float sum = 0.0f;
+             for (uint32_t i = 0; i < n; i++) sum += s[i] * s[i];
+             sink = sqrtf(sum / n);
+         }},
+    };
+
+    printf("kernel,impl,frames,aligned,kernel_ns,naive_ns,speedup\n");
+    for (Implementation impl : {Implementation::SCALAR, Implementation::SSE, Implementation::AVX2,
+                                Implementation::AVX512}) {
+        if (!useImplementation(impl)) continue;
+        for (const Case& c : cases) {
+            for (uint32_t n = 32; n <= maxFrames; n *= 2) {
+                for (int offset : {0, 1}) {
+                    float* dst = dstStorage.data() + offset;
+                    const float* src = srcStorage.data() + offset;
+                    double k = timeCall(n, [&]() { c.kernel(dst, src, planar, n); });
+                    double v = timeCall(n, [&]() { c.naive(dst, src, planar, n); });
+                    printf("%s,%s,%u,%s,%.1f,%.1f,%.2f\n", c.name, getImplementationName(impl), n,
+                           offset ? "no" : "yes", k, v, v / k);
+                }
+            }
+        }
+    }
+    return 0;
+}
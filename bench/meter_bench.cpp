@@ -0,0 +1,113 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../jackclient/jackclient.h"
+#include "../jackclient/meter.h"
+#include "../jackclient/simserver.h"
+
+// A client with many input ports, all fed from the same capture port, each
+// with a meter tap.
+class Metered : public JackClient {
+   public:
+    std::vector<std::unique_ptr<JackAudioInputPort>> ports;
+
+    explicit Metered(uint32_t count) : JackClient("metered") {
+        open();
+        for (uint32_t i = 0; i < count; i++)
+            this->ports.push_back(this->createAudioInputPort(("in_" + std::to_string(i)).c_str()));
+        activate();
+        for (auto& port : this->ports)
+            jack_connect(this->getHandle(), "system:capture_1", port->getName().c_str());
+    };
+    ~Metered() { this->close(); };
+    int onProcess(const JackPortBuffers& buffers, uint32_t nframes) { return 0; };
+};
+
+struct Result {
+    JackTapCost cost;
+    float passMicros, maxPassMicros;
+    uint64_t overruns;
+};
+
+// Runs the server in real time with a tap on every port of a new client and
+// reports what the process thread spent on the taps and how long the
+// analyzer passes took.
+static Result run(uint32_t count, const JackMeterOptions& options, uint32_t threads,
+                  int seconds) {
+    Metered client(count);
+    JackAnalyzer analyzer(threads);
+    std::vector<std::unique_ptr<JackMeterTap>> taps;
+    for (auto& port : client.ports)
+        taps.emplace_back(new JackMeterTap(&client, *port, analyzer, options));
+    JackSim::flush();
+    JackSim::start(true);
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    JackSim::stop();
+    Result result;
+    result.cost = client.getTapCost();
+    result.passMicros = analyzer.getPassMicros();
+    result.maxPassMicros = analyzer.getMaxPassMicros();
+    result.overruns = 0;
+    for (auto& tap : taps) result.overruns += tap->getSnapshot().overruns;
+    return result;
+}
+
+static void print(const char* mode, uint32_t threads, const Result& result) {
+    printf("%-9s %7u %10.3f %10.2f %12.1f %12.1f %9llu\n", mode, threads,
+           result.cost.tapMicros, result.cost.cycleMicros, result.passMicros,
+           result.maxPassMicros, (unsigned long long)result.overruns);
+}
+
+int main(int argc, char** argv) {
+    uint32_t count = argc > 1 ? (uint32_t)atoi(argv[1]) : 256;
+    uint32_t bufferSize = argc > 2 ? (uint32_t)atoi(argv[2]) : 256;
+    int seconds = argc > 3 ? atoi(argv[3]) : 2;
+    if (count < 1 || bufferSize < 1 || seconds < 1) {
+        fprintf(stderr, "usage: %s [taps=256] [buffer=256] [seconds=2]\n", argv[0]);
+        return 1;
+    }
+    JackSimConfig config;
+    config.bufferSize = bufferSize;
+    JackSim::configure(config);
+
+    try {
+        uint64_t frame = 0;
+        JackSim::setCycleHooks(
+            [&frame](uint32_t nframes) {
+                float* capture = JackSim::getAudioBuffer("system:capture_1");
+                for (uint32_t i = 0; i < nframes; i++, frame++)
+                    capture[i] = 0.5f * std::sin(2.0 * M_PI * 997.0 * frame / 48000.0);
+            },
+            nullptr);
+
+        uint32_t cores = std::max(1u, std::thread::hardware_concurrency());
+        printf("%u taps, %u frames at 48000 Hz, %u cores\n", count, bufferSize, cores);
+        printf("%-9s %7s %10s %10s %12s %12s %9s\n", "mode", "threads", "tap us", "cycle us",
+               "pass us", "max pass us", "overruns");
+
+        JackMeterOptions plain;
+        plain.loudness = false;
+        plain.truePeak = false;
+        JackMeterOptions spectrum = plain;
+        spectrum.fftSize = 2048;
+        JackMeterOptions full;
+        full.fftSize = 2048;
+        print("peak/rms", cores, run(count, plain, cores, seconds));
+        print("spectrum", cores, run(count, spectrum, cores, seconds));
+        for (uint32_t threads = 1; threads < cores; threads *= 2)
+            print("full", threads, run(count, full, threads, seconds));
+        print("full", cores, run(count, full, cores, seconds));
+        JackSim::setCycleHooks(nullptr, nullptr);
+    } catch (JackClientException& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,107 @@
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include "../jackclient/mididecoder.h"
+
+struct Event {
+    uint32_t time;
+    std::vector<unsigned char> data;
+};
+
+// A mix typical of a keyboard with MPE: notes, pressure, bends and CCs on
+// several channels, clock ticks, some running status and the odd SysEx.
+static std::vector<Event> makeCycle(uint32_t events, uint32_t seed) {
+    std::vector<Event> cycle;
+    for (uint32_t i = 0; i < events; i++) {
+        uint32_t r = (seed = seed * 1664525u + 1013904223u) >> 8;
+        unsigned char channel = r & 15;
+        unsigned char a = (r >> 4) & 127, b = (r >> 11) & 127;
+        Event ev{i, {}};
+        switch (r % 8) {
+            case 0:
+                ev.data = {(unsigned char)(0x90 | channel), a, b};
+                break;
+            case 1:
+                ev.data = {(unsigned char)(0x80 | channel), a, 0};
+                break;
+            case 2:
+                ev.data = {(unsigned char)(0xE0 | channel), a, b};
+                break;
+            case 3:
+                ev.data = {(unsigned char)(0xD0 | channel), a};
+                break;
+            case 4:
+                ev.data = {(unsigned char)(0xB0 | channel), 74, b};
+                break;
+            case 5:
+                // Three messages in one event through running status.
+                ev.data = {(unsigned char)(0xB0 | channel), 1, a, 2, b, 7, a};
+                break;
+            case 6:
+                ev.data = {0xF8};
+                break;
+            default:
+                ev.data = {0xF0, 0x7E, 0x7F, 0x06, 0x01, 0xF7};
+                break;
+        }
+        cycle.push_back(ev);
+    }
+    return cycle;
+}
+
+struct Counter {
+    uint64_t notes = 0;
+    uint64_t other = 0;
+    void note(const JackMIDIMessage& message) { notes += message.getNote(); };
+    void any(const JackMIDIMessage& message) { other += message.size; };
+};
+
+static void bench(uint32_t eventsPerCycle) {
+    const uint32_t cycles = (1u << 24) / eventsPerCycle;
+    std::vector<std::vector<Event>> input;
+    for (uint32_t i = 0; i < 64; i++) input.push_back(makeCycle(eventsPerCycle, i + 1));
+    JackMIDIDecoder decoder(eventsPerCycle * 3);
+    Counter counter;
+    JackMIDIDispatchTable table;
+    table.set<Counter, &Counter::note>(JackMIDIMessageType::NOTE_ON, counter);
+    table.set<Counter, &Counter::note>(JackMIDIMessageType::NOTE_OFF, counter);
+    table.set<Counter, &Counter::any>(JackMIDIMessageType::CONTROL_CHANGE, counter);
+    table.set<Counter, &Counter::any>(JackMIDIMessageType::PITCH_BEND, counter);
+    table.set<Counter, &Counter::any>(JackMIDIMessageType::SYSEX, counter);
+
+    uint64_t messages = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t c = 0; c < cycles; c++) {
+        decoder.beginCycle();
+        for (const Event& ev : input[c & 63])
+            decoder.decodeEvent(ev.time, ev.data.data(), ev.data.size());
+        messages += decoder.size();
+    }
+    double decodeMicros =
+        std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start)
+            .count();
+
+    start = std::chrono::steady_clock::now();
+    for (uint32_t c = 0; c < cycles; c++) {
+        decoder.beginCycle();
+        for (const Event& ev : input[c & 63])
+            decoder.decodeEvent(ev.time, ev.data.data(), ev.data.size());
+        decoder.dispatch(table);
+    }
+    double dispatchMicros =
+        std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start)
+            .count();
+
+    double events = (double)cycles * eventsPerCycle;
+    printf("events/cycle=%-5u decode: %.1f events/us %.1f messages/us  "
+           "decode+dispatch: %.1f events/us  malformed=%llu checksum=%llu\n",
+           eventsPerCycle, events / decodeMicros, messages / decodeMicros,
+           events / dispatchMicros, (unsigned long long)decoder.getMalformedCount(),
+           (unsigned long long)(counter.notes + counter.other));
+}
+
+int main() {
+    for (uint32_t events : {8u, 64u, 512u}) bench(events);
+    return 0;
+}
@@ -0,0 +1,507 @@
+#include <dlfcn.h>
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../jackclient/audiokernels.h"
+#include "../jackclient/jackclient.h"
+#include "../jackclient/staticclient.h"
+
+// Allocations made through operator new on the calling thread; everything in
+// the C++ layer allocates this way.
+static thread_local uint64_t allocations = 0;
+
+void* operator new(size_t size) {
+    allocations++;
+    if (void* p = malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t size) {
+    allocations++;
+    if (void* p = malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+static uint64_t threadCPUNanos() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Every process callback, raw or wrapped, is registered through the
+// interposer below and timed by the same trampoline, so both sides pay
+// the same measurement cost and the wrapper's per-cycle bookkeeping
+// before onProcess() is included.
+struct Probe {
+    JackProcessCallback callback = nullptr;
+    void* arg = nullptr;
+    std::atomic<bool> recording{false};
+    std::vector<uint32_t> durations;
+    std::atomic<size_t> count{0};
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> firstCPU{0};
+    std::atomic<uint64_t> lastCPU{0};
+
+    void arm(size_t capacity) {
+        this->durations.assign(capacity, 0);
+        this->count.store(0);
+        this->allocations.store(0);
+        this->firstCPU.store(0);
+        this->lastCPU.store(0);
+        this->recording.store(true);
+    };
+};
+
+static std::mutex probesMutex;
+static std::map<jack_client_t*, std::unique_ptr<Probe>> probes;
+
+static int timedProcess(jack_nframes_t nframes, void* arg) {
+    Probe* probe = static_cast<Probe*>(arg);
+    if (!probe->recording.load(std::memory_order_acquire))
+        return probe->callback(nframes, probe->arg);
+    size_t index = probe->count.load(std::memory_order_relaxed);
+    if (index >= probe->durations.size()) return probe->callback(nframes, probe->arg);
+    uint64_t cpu = threadCPUNanos();
+    if (index == 0) probe->firstCPU.store(cpu, std::memory_order_relaxed);
+    probe->lastCPU.store(cpu, std::memory_order_relaxed);
+    uint64_t before = allocations;
+    auto start = std::chrono::steady_clock::now();
+    int result = probe->callback(nframes, probe->arg);
+    auto end = std::chrono::steady_clock::now();
+    probe->allocations.fetch_add(allocations - before, std::memory_order_relaxed);
+    probe->durations[index] =
+        (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    probe->count.store(index + 1, std::memory_order_release);
+    return result;
+}
+
+extern "C" int jack_set_process_callback(jack_client_t* client, JackProcessCallback callback,
+                                         void* arg) {
+    typedef int (*Setter)(jack_client_t*, JackProcessCallback, void*);
+    static Setter real = (Setter)dlsym(RTLD_NEXT, "jack_set_process_callback");
+    if (!real) return -1;
+    Probe* probe;
+    {
+        std::lock_guard<std::mutex> lock(probesMutex);
+        std::unique_ptr<Probe>& slot = probes[client];
+        if (!slot) slot.reset(new Probe());
+        probe = slot.get();
+    }
+    probe->callback = callback;
+    probe->arg = arg;
+    return real(client, &timedProcess, probe);
+}
+
+static Probe* probeFor(jack_client_t* client) {
+    std::lock_guard<std::mutex> lock(probesMutex);
+    auto it = probes.find(client);
+    return it == probes.end() ? nullptr : it->second.get();
+}
+
+static void forgetProbe(jack_client_t* client) {
+    std::lock_guard<std::mutex> lock(probesMutex);
+    probes.erase(client);
+}
+
+struct Settings {
+    double seconds = 2.0;
+    uint32_t mixInputs = 16;
+    uint32_t midiEvents = 64;
+    uint32_t iterations = 500;
+    uint32_t nframes = 0;
+    uint32_t sampleRate = 0;
+};
+
+static double percentile(const std::vector<uint32_t>& sorted, double p) {
+    if (sorted.empty()) return 0.0;
+    size_t index = (size_t)(p / 100.0 * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+static void printTimes(std::vector<uint32_t>& times) {
+    std::sort(times.begin(), times.end());
+    double sum = 0;
+    for (uint32_t t : times) sum += t;
+    printf("\"mean_ns\":%.1f,\"p50_ns\":%.0f,\"p99_ns\":%.0f,\"p999_ns\":%.0f,\"max_ns\":%.0f",
+           times.empty() ? 0.0 : sum / times.size(), percentile(times, 50), percentile(times, 99),
+           percentile(times, 99.9), times.empty() ? 0.0 : (double)times.back());
+}
+
+// Records the callbacks of one client for the configured time and prints a JSON line.
+static void measure(const Settings& settings, const char* scenario, const char* impl,
+                    jack_client_t* handle) {
+    Probe* probe = probeFor(handle);
+    if (!probe) return;
+    std::this_thread::sleep_for(std::chrono::milliseconds(250));
+    double cycleSeconds = (double)settings.nframes / settings.sampleRate;
+    probe->arm((size_t)(settings.seconds / cycleSeconds * 1.5) + 64);
+    std::this_thread::sleep_for(std::chrono::duration<double>(settings.seconds));
+    probe->recording.store(false, std::memory_order_release);
+    // Let a cycle in flight finish before reading what it wrote.
+    std::this_thread::sleep_for(std::chrono::duration<double>(cycleSeconds * 4 + 0.01));
+    size_t cycles = probe->count.load(std::memory_order_acquire);
+    std::vector<uint32_t> times(probe->durations.begin(), probe->durations.begin() + cycles);
+    uint64_t cpu = probe->lastCPU.load() - probe->firstCPU.load();
+    printf("{\"scenario\":\"%s\",\"impl\":\"%s\",\"nframes\":%u,\"cycles\":%zu,", scenario, impl,
+           settings.nframes, cycles);
+    printTimes(times);
+    printf(",\"thread_cpu_ns_per_cycle\":%.1f,\"allocs_per_cycle\":%.3f}\n",
+           cycles > 1 ? (double)cpu / (cycles - 1) : 0.0,
+           cycles ? (double)probe->allocations.load() / cycles : 0.0);
+    fflush(stdout);
+}
+
+// Times a non-real-time operation on the calling thread.
+template <typename F>
+static void measureOps(const Settings& settings, const char* scenario, const char* impl, F op) {
+    for (uint32_t i = 0; i < settings.iterations / 10 + 1; i++) op();
+    std::vector<uint32_t> times;
+    times.reserve(settings.iterations);
+    uint64_t allocated = 0;
+    for (uint32_t i = 0; i < settings.iterations; i++) {
+        uint64_t before = allocations;
+        auto start = std::chrono::steady_clock::now();
+        op();
+        auto end = std::chrono::steady_clock::now();
+        allocated += allocations - before;
+        times.push_back(
+            (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    }
+    printf("{\"scenario\":\"%s\",\"impl\":\"%s\",\"ops\":%u,", scenario, impl, settings.iterations);
+    printTimes(times);
+    printf(",\"allocs_per_op\":%.3f}\n", times.empty() ? 0.0 : (double)allocated / times.size());
+    fflush(stdout);
+}
+
+// Raw C API clients.
+
+class RawClient {
+   public:
+    jack_client_t* handle = nullptr;
+    std::vector<jack_port_t*> inputs;
+    std::vector<jack_port_t*> outputs;
+    uint32_t events = 0;
+
+    RawClient(const char* name, uint32_t audioIn, uint32_t audioOut, uint32_t midiIn,
+              uint32_t midiOut, JackProcessCallback process, uint32_t events = 0)
+        : events(events) {
+        jack_status_t status;
+        this->handle = jack_client_open(name, JackNoStartServer, &status);
+        if (!this->handle) throw JackClientException("Could not open raw client");
+        char port[32];
+        for (uint32_t i = 0; i < audioIn + midiIn; i++) {
+            snprintf(port, sizeof(port), "in_%u", i + 1);
+            this->inputs.push_back(jack_port_register(
+                this->handle, port, i < audioIn ? JACK_DEFAULT_AUDIO_TYPE : JACK_DEFAULT_MIDI_TYPE,
+                JackPortIsInput, 0));
+        }
+        for (uint32_t i = 0; i < audioOut + midiOut; i++) {
+            snprintf(port, sizeof(port), "out_%u", i + 1);
+            this->outputs.push_back(jack_port_register(
+                this->handle, port,
+                i < audioOut ? JACK_DEFAULT_AUDIO_TYPE : JACK_DEFAULT_MIDI_TYPE, JackPortIsOutput,
+                0));
+        }
+        if (process) jack_set_process_callback(this->handle, process, this);
+        jack_activate(this->handle);
+    };
+    ~RawClient() {
+        jack_deactivate(this->handle);
+        jack_client_close(this->handle);
+        forgetProbe(this->handle);
+    };
+};
+
+static int rawEmpty(jack_nframes_t nframes, void* arg) { return 0; }
+
+static int rawPassthrough(jack_nframes_t nframes, void* arg) {
+    RawClient* c = static_cast<RawClient*>(arg);
+    AudioKernels::copy((float*)jack_port_get_buffer(c->outputs[0], nframes),
+                       (const float*)jack_port_get_buffer(c->inputs[0], nframes), nframes);
+    return 0;
+}
+
+static int rawMix(jack_nframes_t nframes, void* arg) {
+    RawClient* c = static_cast<RawClient*>(arg);
+    float* out = (float*)jack_port_get_buffer(c->outputs[0], nframes);
+    AudioKernels::clear(out, nframes);
+    for (jack_port_t* port : c->inputs)
+        AudioKernels::mixAdd(out, (const float*)jack_port_get_buffer(port, nframes), 1.0f,
+                             nframes);
+    return 0;
+}
+
+static int rawMIDISource(jack_nframes_t nframes, void* arg) {
+    RawClient* c = static_cast<RawClient*>(arg);
+    void* out = jack_port_get_buffer(c->outputs[0], nframes);
+    jack_midi_clear_buffer(out);
+    jack_midi_data_t note[3] = {0x90, 60, 100};
+    for (uint32_t i = 0; i < c->events; i++) {
+        note[1] = (jack_midi_data_t)(i & 127);
+        jack_midi_event_write(out, (jack_nframes_t)((uint64_t)i * nframes / c->events), note, 3);
+    }
+    return 0;
+}
+
+static int rawMIDIForward(jack_nframes_t nframes, void* arg) {
+    RawClient* c = static_cast<RawClient*>(arg);
+    void* in = jack_port_get_buffer(c->inputs[0], nframes);
+    void* out = jack_port_get_buffer(c->outputs[0], nframes);
+    jack_midi_clear_buffer(out);
+    uint32_t count = jack_midi_get_event_count(in);
+    jack_midi_event_t event;
+    for (uint32_t i = 0; i < count; i++)
+        if (jack_midi_event_get(&event, in, i) == 0)
+            jack_midi_event_write(out, event.time, event.buffer, event.size);
+    return 0;
+}
+
+// Wrapper clients.
+
+class WrapperClient : public JackClient {
+   public:
+    explicit WrapperClient(const char* name) : JackClient(name){};
+    using JackClient::getHandle;
+};
+
+class WrapperEmpty : public WrapperClient {
+   public:
+    WrapperEmpty() : WrapperClient("overhead_wrapper") {
+        open();
+        activate();
+    };
+    ~WrapperEmpty() { this->close(); };
+
+   protected:
+    int onProcess(const JackPortBuffers& buffers, uint32_t nframes) { return 0; };
+};
+
+// lookup selects the per-port getBuffer() path instead of the resolved buffer table.
+class WrapperMix : public WrapperClient {
+   private:
+    bool lookup;
+    std::vector<std::unique_ptr<JackAudioInputPort>> inputs;
+    std::unique_ptr<JackAudioOutputPort> out;
+
+   public:
+    WrapperMix(uint32_t count, bool lookup) : WrapperClient("overhead_wrapper"), lookup(lookup) {
+        open();
+        for (uint32_t i = 0; i < count; i++)
+            this->inputs.push_back(
+                this->createAudioInputPort(("in_" + std::to_string(i + 1)).c_str()));
+        this->out = this->createAudioOutputPort("out_1");
+        activate();
+    };
+    ~WrapperMix() { this->close(); };
+
+   protected:
+    int onProcess(const JackPortBuffers& buffers, uint32_t nframes) {
+        float* dst = lookup ? out->getBuffer() : buffers.getBuffer(*out);
+        if (inputs.size() == 1) {
+            float* src = lookup ? inputs[0]->getBuffer() : buffers.getBuffer(*inputs[0]);
+            AudioKernels::copy(dst, src, nframes);
+            return 0;
+        }
+        AudioKernels::clear(dst, nframes);
+        for (auto& in : inputs)
+            AudioKernels::mixAdd(dst, lookup ? in->getBuffer() : buffers.getBuffer(*in), 1.0f,
+                                 nframes);
+        return 0;
+    };
+};
+
+// vector selects getMIDIEvents(), which allocates, instead of the event range.
+class WrapperMIDIForward : public WrapperClient {
+   private:
+    bool vector;
+    std::unique_ptr<JackMIDIInputPort> in;
+    std::unique_ptr<JackMIDIOutputPort> out;
+
+   public:
+    explicit WrapperMIDIForward(bool vector) : WrapperClient("overhead_wrapper"), vector(vector) {
+        open();
+        this->in = this->createMIDIInputPort("in_1");
+        this->out = this->createMIDIOutputPort("out_1");
+        activate();
+    };
+    ~WrapperMIDIForward() { this->close(); };
+
+   protected:
+    int onProcess(const JackPortBuffers& buffers, uint32_t nframes) {
+        if (vector) {
+            for (auto& event : in->getMIDIEvents()) out->writeEvent(*event);
+        } else {
+            for (const JackMIDIEvent& event : in->getEvents())
+                out->write(event.getTime(), event.getMIDIData(), event.getSize());
+        }
+        return 0;
+    };
+};
+
+class WrapperPorts : public WrapperClient {
+   public:
+    std::unique_ptr<JackAudioOutputPort> out;
+    std::unique_ptr<JackAudioInputPort> in;
+
+    WrapperPorts() : WrapperClient("overhead_wrapper") {
+        open();
+        this->out = this->createAudioOutputPort("out_1");
+        this->in = this->createAudioInputPort("in_1");
+        activate();
+    };
+    ~WrapperPorts() { this->close(); };
+
+   protected:
+    int onProcess(const JackPortBuffers& buffers, uint32_t nframes) { return 0; };
+};
+
+// Callbacks bound at compile time; the port buffers are the process() arguments.
+class StaticPassthrough
+    : public JackStaticClient<StaticPassthrough, JackStaticAudioIn, JackStaticAudioOut> {
+    friend class JackStaticClient<StaticPassthrough, JackStaticAudioIn, JackStaticAudioOut>;
+
+   public:
+    StaticPassthrough() : JackStaticClient("overhead_wrapper", {{"in_1", "out_1"}}) {
+        open();
+        activate();
+    };
+    ~StaticPassthrough() { this->close(); };
+    using JackClient::getHandle;
+
+   private:
+    int process(uint32_t nframes, const float* in, float* out) {
+        AudioKernels::copy(out, in, nframes);
+        return 0;
+    };
+};
+
+static void runProcessScenarios(const Settings& settings) {
+    {
+        RawClient raw("overhead_raw", 0, 0, 0, 0, &rawEmpty);
+        measure(settings, "empty", "raw", raw.handle);
+    }
+    {
+        WrapperEmpty wrapper;
+        measure(settings, "empty", "wrapper", wrapper.getHandle());
+    }
+    {
+        RawClient raw("overhead_raw", 1, 1, 0, 0, &rawPassthrough);
+        measure(settings, "audio_passthrough", "raw", raw.handle);
+    }
+    for (bool lookup : {false, true}) {
+        WrapperMix wrapper(1, lookup);
+        measure(settings, "audio_passthrough", lookup ? "wrapper_port" : "wrapper",
+                wrapper.getHandle());
+    }
+    {
+        StaticPassthrough wrapper;
+        measure(settings, "audio_passthrough", "wrapper_static", wrapper.getHandle());
+    }
+    std::string mix = "mix_" + std::to_string(settings.mixInputs);
+    {
+        RawClient raw("overhead_raw", settings.mixInputs, 1, 0, 0, &rawMix);
+        measure(settings, mix.c_str(), "raw", raw.handle);
+    }
+    for (bool lookup : {false, true}) {
+        WrapperMix wrapper(settings.mixInputs, lookup);
+        measure(settings, mix.c_str(), lookup ? "wrapper_port" : "wrapper", wrapper.getHandle());
+    }
+
+    // A raw source feeds the same events to every forwarder.
+    RawClient source("overhead_midi_source", 0, 0, 0, 1, &rawMIDISource, settings.midiEvents);
+    std::string midi = "midi_" + std::to_string(settings.midiEvents);
+    const char* from = jack_port_name(source.outputs[0]);
+    {
+        RawClient raw("overhead_raw", 0, 0, 1, 1, &rawMIDIForward);
+        jack_connect(source.handle, from, jack_port_name(raw.inputs[0]));
+        measure(settings, midi.c_str(), "raw", raw.handle);
+    }
+    for (bool vector : {false, true}) {
+        WrapperMIDIForward wrapper(vector);
+        jack_connect(source.handle, from, (std::string(wrapper.getName()) + ":in_1").c_str());
+        measure(settings, midi.c_str(), vector ? "wrapper_vector" : "wrapper",
+                wrapper.getHandle());
+    }
+}
+
+static void runGraphScenarios(const Settings& settings) {
+    RawClient raw("overhead_raw", 1, 1, 0, 0, nullptr);
+    WrapperPorts wrapper;
+    size_t sink = 0;
+
+    measureOps(settings, "port_enumeration", "raw", [&] {
+        for (unsigned long flags : {JackPortIsInput, JackPortIsOutput}) {
+            const char** names = jack_get_ports(raw.handle, NULL, JACK_DEFAULT_AUDIO_TYPE, flags);
+            if (!names) continue;
+            for (const char** name = names; *name; name++) {
+                jack_port_t* port = jack_port_by_name(raw.handle, *name);
+                if (port)
+                    sink += strlen(jack_port_name(port)) + strlen(jack_port_short_name(port));
+            }
+            jack_free(names);
+        }
+    });
+    measureOps(settings, "port_enumeration", "wrapper", [&] {
+        for (auto& port : wrapper.getAudioInputPorts())
+            sink += port->getName().size() + port->getShortName().size();
+        for (auto& port : wrapper.getAudioOutputPorts())
+            sink += port->getName().size() + port->getShortName().size();
+    });
+
+    std::string source = jack_port_name(raw.outputs[0]);
+    std::string destination = jack_port_name(raw.inputs[0]);
+    measureOps(settings, "connection_churn", "raw", [&] {
+        jack_connect(raw.handle, source.c_str(), destination.c_str());
+        jack_disconnect(raw.handle, source.c_str(), destination.c_str());
+    });
+    measureOps(settings, "connection_churn", "wrapper", [&] {
+        wrapper.out->connectTo(*wrapper.in);
+        wrapper.out->disconnect(*wrapper.in);
+    });
+    if (sink == 0) fprintf(stderr, "no ports found\n");
+}
+
+int main(int argc, char** argv) {
+    Settings settings;
+    if (argc > 1) settings.seconds = atof(argv[1]);
+    if (argc > 2) settings.mixInputs = (uint32_t)atoi(argv[2]);
+    if (argc > 3) settings.midiEvents = (uint32_t)atoi(argv[3]);
+    if (argc > 4) settings.iterations = (uint32_t)atoi(argv[4]);
+    if (settings.seconds <= 0 || settings.mixInputs < 1) {
+        fprintf(stderr,
+                "usage: %s [seconds=2] [mix inputs=16] [midi events=64] [graph ops=500]\n"
+                "Start jackd first, e.g. jackd -d dummy -p 64\n"
+                "Writes one JSON object per measurement to stdout.\n",
+                argv[0]);
+        return 1;
+    }
+    try {
+        RawClient control("overhead_control", 0, 0, 0, 0, nullptr);
+        settings.nframes = jack_get_buffer_size(control.handle);
+        settings.sampleRate = jack_get_sample_rate(control.handle);
+        fprintf(stderr, "period %u frames at %u Hz, %.1f s per process scenario\n",
+                settings.nframes, settings.sampleRate, settings.seconds);
+        runProcessScenarios(settings);
+        runGraphScenarios(settings);
+    } catch (JackClientException& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,88 @@
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "../jackclient/ringbuffer.h"
+
+static const uint64_t TOTAL_FRAMES = 1ull << 26;
+
+static void benchAudio(uint32_t channels, uint32_t blockSize) {
+    JackAudioRingBuffer ring(channels, blockSize * 16);
+    std::vector<std::vector<float>> in(channels, std::vector<float>(blockSize, 0.5f));
+    std::vector<std::vector<float>> out(channels, std::vector<float>(blockSize));
+    std::vector<const float*> src;
+    std::vector<float*> dst;
+    for (uint32_t c = 0; c < channels; c++) {
+        src.push_back(in[c].data());
+        dst.push_back(out[c].data());
+    }
+    uint64_t blocks = TOTAL_FRAMES / blockSize / channels;
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread producer([&]() {
+        for (uint64_t i = 0; i < blocks;) {
+            if (ring.write(src.data(), blockSize))
+                i++;
+            else
+                std::this_thread::yield();
+        }
+    });
+    for (uint64_t i = 0; i < blocks;) {
+        if (ring.read(dst.data(), blockSize))
+            i++;
+        else
+            std::this_thread::yield();
+    }
+    producer.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double samples = (double)blocks * blockSize * channels;
+    std::cout << "audio channels=" << channels << " block=" << blockSize
+              << " Msamples/s=" << samples / seconds / 1e6
+              << " MB/s=" << samples * sizeof(float) / seconds / 1e6
+              << " overruns=" << ring.getOverruns() << " underruns=" << ring.getUnderruns()
+              << std::endl;
+}
+
+static void benchZeroCopy(uint32_t blockSize) {
+    JackRingBuffer<float> ring(blockSize * 16);
+    std::vector<float> in(blockSize, 0.25f);
+    uint64_t blocks = TOTAL_FRAMES / blockSize;
+    double sum = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread producer([&]() {
+        for (uint64_t i = 0; i < blocks;) {
+            if (ring.write(in.data(), blockSize))
+                i++;
+            else
+                std::this_thread::yield();
+        }
+    });
+    for (uint64_t consumed = 0; consumed < blocks * blockSize;) {
+        JackRingBufferState::Vector vec = ring.getReadVector();
+        const float* data = ring.getData();
+        for (size_t i = 0; i < vec.first.size; i++) sum += data[vec.first.offset + i];
+        for (size_t i = 0; i < vec.second.size; i++) sum += data[vec.second.offset + i];
+        ring.commitRead(vec.size());
+        consumed += vec.size();
+        if (!vec.size()) std::this_thread::yield();
+    }
+    producer.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "zero-copy read block=" << blockSize
+              << " Msamples/s=" << blocks * blockSize / seconds / 1e6
+              << " overruns=" << ring.getOverruns() << " checksum=" << sum << std::endl;
+}
+
+int main() {
+    for (uint32_t blockSize : {64u, 256u, 1024u}) {
+        benchAudio(1, blockSize);
+        benchAudio(2, blockSize);
+        benchAudio(8, blockSize);
+    }
+    for (uint32_t blockSize : {64u, 1024u}) benchZeroCopy(blockSize);
+    return 0;
+}
@@ -0,0 +1,119 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../jackclient/audiokernels.h"
+#include "../jackclient/cyclestats.h"
+#include "../jackclient/jackclient.h"
+#include "../jackclient/simserver.h"
+
+// One stage of a chain: a gain over a block of audio and MIDI passed through.
+// The gains of the whole chain multiply to one, so the output can be checked.
+class Stage : public JackClient {
+   private:
+    float level;
+    std::unique_ptr<JackAudioInputPort> in;
+    std::unique_ptr<JackAudioOutputPort> out;
+    std::unique_ptr<JackMIDIInputPort> midiIn;
+    std::unique_ptr<JackMIDIOutputPort> midiOut;
+
+   public:
+    explicit Stage(float level) : JackClient("stage"), level(level) {
+        open();
+        this->in = this->createAudioInputPort("in");
+        this->out = this->createAudioOutputPort("out");
+        this->midiIn = this->createMIDIInputPort("midi_in");
+        this->midiOut = this->createMIDIOutputPort("midi_out");
+        activate();
+    };
+    ~Stage() { this->close(); };
+    int connect(const std::string& from, const std::string& to) {
+        return jack_connect(this->getHandle(), from.c_str(), to.c_str());
+    };
+
+   protected:
+    int onProcess(const JackPortBuffers& buffers, uint32_t nframes) {
+        AudioKernels::gain(buffers.getBuffer(*out), buffers.getBuffer(*in), level, nframes);
+        for (const JackMIDIEvent& event : midiIn->getEvents())
+            midiOut->write(event.getTime(), event.getMIDIData(), event.getSize());
+        return 0;
+    };
+};
+
+int main(int argc, char** argv) {
+    int stages = argc > 1 ? atoi(argv[1]) : 8;
+    uint32_t bufferSize = argc > 2 ? (uint32_t)atoi(argv[2]) : 64;
+    uint32_t sampleRate = argc > 3 ? (uint32_t)atoi(argv[3]) : 48000;
+    uint64_t cycles = argc > 4 ? strtoull(argv[4], nullptr, 10) : 100000;
+    if (stages < 1 || bufferSize < 1 || sampleRate < 1) {
+        fprintf(stderr, "usage: %s [stages=8] [buffer=64] [rate=48000] [cycles=100000]\n",
+                argv[0]);
+        return 1;
+    }
+    JackSimConfig config;
+    config.bufferSize = bufferSize;
+    config.sampleRate = sampleRate;
+    JackSim::configure(config);
+
+    try {
+        std::vector<std::unique_ptr<Stage>> chain;
+        float level = std::pow(2.0f, 1.0f / stages);
+        for (int i = 0; i < stages; i++)
+            chain.emplace_back(new Stage(i + 1 < stages ? level : 1.0f / std::pow(level, i)));
+        std::string audio = "system:capture_1", midi = "system:midi_capture_1";
+        for (auto& stage : chain) {
+            std::string name = stage->getName();
+            stage->connect(audio, name + ":in");
+            stage->connect(midi, name + ":midi_in");
+            audio = name + ":out";
+            midi = name + ":midi_out";
+        }
+        chain.back()->connect(audio, "system:playback_1");
+        chain.back()->connect(midi, "system:midi_playback_1");
+        JackSim::flush();
+
+        // A ramp in, one note per cycle; both must come out of the far end unchanged.
+        uint64_t errors = 0, notes = 0;
+        JackSim::setCycleHooks(
+            [](uint32_t nframes) {
+                float* capture = JackSim::getAudioBuffer("system:capture_1");
+                for (uint32_t i = 0; i < nframes; i++) capture[i] = (float)i / nframes;
+                unsigned char note[3] = {0x90, 60, 100};
+                JackSim::sendMIDI("system:midi_capture_1", nframes / 2, note, sizeof(note));
+            },
+            [&errors, &notes](uint32_t nframes) {
+                const float* playback = JackSim::getAudioBuffer("system:playback_1");
+                for (uint32_t i = 0; i < nframes; i++)
+                    if (std::fabs(playback[i] - (float)i / nframes) > 1e-4f) errors++;
+                notes += JackSim::getMIDIEvents("system:midi_playback_1").size();
+            });
+        JackSim::startTransport();
+
+        auto start = std::chrono::steady_clock::now();
+        uint64_t ran = JackSim::run(cycles);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        JackSim::flush();
+
+        double audioSeconds = (double)ran * bufferSize / sampleRate;
+        printf("%d stages, %u frames at %u Hz, %llu cycles in %.3f s\n", stages, bufferSize,
+               sampleRate, (unsigned long long)ran, elapsed.count());
+        printf("%.0f cycles/s, %.1fx realtime, server DSP %.2f%%\n", ran / elapsed.count(),
+               audioSeconds / elapsed.count(), JackSim::getLoad());
+        JackCycleStats& stats = chain.back()->getCycleStats();
+        printf("stage process p50 %.2f us, p99 %.2f us, max %.2f us\n",
+               stats.getDurationPercentile(50), stats.getDurationPercentile(99),
+               stats.getMaxDuration());
+        Transport::JackTransportSnapshot transport = chain.front()->getTransportSnapshot();
+        printf("transport at frame %u, %llu sample errors, %llu/%llu notes\n", transport.frame,
+               (unsigned long long)errors, (unsigned long long)notes, (unsigned long long)ran);
+        JackSim::setCycleHooks(nullptr, nullptr);
+        return errors == 0 && notes == ran ? 0 : 1;
+    } catch (JackClientException& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+}
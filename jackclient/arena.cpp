@@ -0,0 +1,25 @@
+#include "arena.h"
+
+#include <stdlib.h>
+
+#include "jackclient.h"
+
+void JackArena::FreeDeleter::operator()(unsigned char* ptr) const { free(ptr); }
+
+JackArena::JackArena(size_t capacity) : highWater(0), failures(0) { this->rebuild(capacity); }
+
+void JackArena::rebuild(size_t capacity) {
+    void* ptr = nullptr;
+    if (capacity && posix_memalign(&ptr, JackCacheAligned::CACHE_LINE_SIZE, capacity))
+        throw std::bad_alloc();
+    this->storage.reset(static_cast<unsigned char*>(ptr));
+    this->capacity = capacity;
+    this->used = 0;
+    this->highWater.store(0, std::memory_order_relaxed);
+}
+
+void JackArena::reset() {
+    if (this->used > this->highWater.load(std::memory_order_relaxed))
+        this->highWater.store(this->used, std::memory_order_relaxed);
+    this->used = 0;
+}
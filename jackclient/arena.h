@@ -0,0 +1,92 @@
+#ifndef _JACKCLIENT_ARENA_H
+#define _JACKCLIENT_ARENA_H
+#include <stdint.h>
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <vector>
+
+/**
+ * Bump allocator for the process thread. Memory comes from one block
+ * allocated up front; allocate() only moves an offset and everything is
+ * released at once by reset(), which JackClient calls after every cycle.
+ * Allocations therefore live until the end of the cycle at most.
+ * */
+class JackArena {
+   private:
+    struct FreeDeleter {
+        void operator()(unsigned char* ptr) const;
+    };
+    std::unique_ptr<unsigned char, FreeDeleter> storage;
+    size_t capacity = 0;
+    size_t used = 0;
+    std::atomic<size_t> highWater;
+    std::atomic<uint64_t> failures;
+
+   public:
+    explicit JackArena(size_t capacity = 0);
+    /** Replaces the block with one of the given size; not real-time safe. */
+    void rebuild(size_t capacity);
+    /** nullptr if the arena is exhausted. */
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t)) {
+        size_t offset = (used + alignment - 1) & ~(alignment - 1);
+        if (offset + size > capacity) {
+            failures.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        used = offset + size;
+        return storage.get() + offset;
+    };
+    void reset();
+    size_t getCapacity() const { return capacity; };
+    size_t getUsed() const { return used; };
+    /** Most memory used in a single cycle; readable from any thread. */
+    size_t getHighWater() const { return highWater.load(std::memory_order_relaxed); };
+    /** Allocations that did not fit; readable from any thread. */
+    uint64_t getFailureCount() const { return failures.load(std::memory_order_relaxed); };
+};
+
+/**
+ * Standard allocator drawing from a JackArena, so containers can be used
+ * in onProcess without touching the heap. deallocate() is a no-op; the
+ * memory comes back with the arena's reset(). Throws std::bad_alloc when
+ * the arena is exhausted, as containers require; JackClient catches it
+ * around onProcess, silences the outputs for that cycle and counts it in
+ * getFailedCycleCount(). Code that can handle a full arena itself should
+ * call JackArena::allocate() and check for nullptr instead.
+ * */
+template <typename T>
+class JackArenaAllocator {
+    template <typename U>
+    friend class JackArenaAllocator;
+
+   private:
+    JackArena* arena;
+
+   public:
+    typedef T value_type;
+
+    JackArenaAllocator(JackArena& arena) : arena(&arena){};
+    template <typename U>
+    JackArenaAllocator(const JackArenaAllocator<U>& other) : arena(other.arena){};
+    T* allocate(size_t n) {
+        void* ptr = arena->allocate(n * sizeof(T), alignof(T));
+        if (!ptr) throw std::bad_alloc();
+        return static_cast<T*>(ptr);
+    };
+    void deallocate(T*, size_t){};
+    template <typename U>
+    bool operator==(const JackArenaAllocator<U>& other) const {
+        return arena == other.arena;
+    };
+    template <typename U>
+    bool operator!=(const JackArenaAllocator<U>& other) const {
+        return arena != other.arena;
+    };
+};
+
+template <typename T>
+using JackArenaVector = std::vector<T, JackArenaAllocator<T>>;
+#endif
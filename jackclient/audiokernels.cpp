@@ -0,0 +1,324 @@
+#include "audiokernels.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define AUDIOKERNELS_X86
+#include <immintrin.h>
+#endif
+
+namespace AudioKernels {
+namespace {
+struct KernelTable {
+    void (*clear)(float*, uint32_t);
+    void (*copy)(float*, const float*, uint32_t);
+    void (*gain)(float*, const float*, float, uint32_t);
+    void (*mixAdd)(float*, const float*, float, uint32_t);
+    void (*gainRamp)(float*, const float*, float, float, uint32_t);
+    void (*mixAddRamp)(float*, const float*, float, float, uint32_t);
+    void (*interleave)(float*, const float* const*, uint32_t, uint32_t);
+    void (*deinterleave)(float* const*, const float*, uint32_t, uint32_t);
+    float (*peak)(const float*, uint32_t);
+    float (*rms)(const float*, uint32_t);
+    void (*fromPCM16)(float*, const int16_t*, uint32_t);
+    void (*fromPCM24)(float*, const unsigned char*, uint32_t);
+    void (*butterfly)(float*, float*, float*, float*, const float*, const float*, uint32_t);
+    void (*power)(float*, const float*, const float*, uint32_t);
+};
+
+namespace scalar {
+#define KERNEL static inline
+typedef float vec;
+static const uint32_t WIDTH = 1;
+KERNEL vec load(const float* p) { return *p; }
+KERNEL void store(float* p, vec v) { *p = v; }
+KERNEL vec set1(float v) { return v; }
+KERNEL vec zero() { return 0.0f; }
+KERNEL vec lanes() { return 0.0f; }
+KERNEL vec add(vec a, vec b) { return a + b; }
+KERNEL vec sub(vec a, vec b) { return a - b; }
+KERNEL vec mul(vec a, vec b) { return a * b; }
+KERNEL vec fmadd(vec a, vec b, vec c) { return a * b + c; }
+KERNEL vec vabs(vec a) { return a < 0.0f ? -a : a; }
+KERNEL vec vmax(vec a, vec b) { return a > b ? a : b; }
+KERNEL float hsum(vec a) { return a; }
+KERNEL float hmax(vec a) { return a; }
+KERNEL void interleave2(vec a, vec b, float* dst) {
+    dst[0] = a;
+    dst[1] = b;
+}
+KERNEL void deinterleave2(const float* src, vec& a, vec& b) {
+    a = src[0];
+    b = src[1];
+}
+KERNEL vec loadPCM16(const int16_t* p) { return (float)*p; }
+KERNEL vec loadPCM24(const unsigned char* p) {
+    int32_t sample = (int32_t)((uint32_t)p[0] << 8 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 24);
+    return (float)(sample >> 8);
+}
+#include "audiokernels_simd.inc"
+#undef KERNEL
+}  // namespace scalar
+
+#ifdef AUDIOKERNELS_X86
+namespace sse {
+#define KERNEL static inline __attribute__((target("sse2")))
+typedef __m128 vec;
+static const uint32_t WIDTH = 4;
+KERNEL vec load(const float* p) { return _mm_loadu_ps(p); }
+KERNEL void store(float* p, vec v) { _mm_storeu_ps(p, v); }
+KERNEL vec set1(float v) { return _mm_set1_ps(v); }
+KERNEL vec zero() { return _mm_setzero_ps(); }
+KERNEL vec lanes() { return _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f); }
+KERNEL vec add(vec a, vec b) { return _mm_add_ps(a, b); }
+KERNEL vec sub(vec a, vec b) { return _mm_sub_ps(a, b); }
+KERNEL vec mul(vec a, vec b) { return _mm_mul_ps(a, b); }
+KERNEL vec fmadd(vec a, vec b, vec c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+KERNEL vec vabs(vec a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+KERNEL vec vmax(vec a, vec b) { return _mm_max_ps(a, b); }
+KERNEL float hsum(vec a) {
+    vec s = _mm_add_ps(a, _mm_movehl_ps(a, a));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+}
+KERNEL float hmax(vec a) {
+    vec m = _mm_max_ps(a, _mm_movehl_ps(a, a));
+    m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+    return _mm_cvtss_f32(m);
+}
+KERNEL void interleave2(vec a, vec b, float* dst) {
+    _mm_storeu_ps(dst, _mm_unpacklo_ps(a, b));
+    _mm_storeu_ps(dst + 4, _mm_unpackhi_ps(a, b));
+}
+KERNEL void deinterleave2(const float* src, vec& a, vec& b) {
+    vec x = _mm_loadu_ps(src);
+    vec y = _mm_loadu_ps(src + 4);
+    a = _mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 0, 2, 0));
+    b = _mm_shuffle_ps(x, y, _MM_SHUFFLE(3, 1, 3, 1));
+}
+KERNEL vec loadPCM16(const int16_t* p) {
+    __m128i x = _mm_loadl_epi64((const __m128i*)p);
+    // Each sample lands in the top half of a 32-bit lane; the shift sign-extends it.
+    return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16));
+}
+KERNEL vec loadPCM24(const unsigned char* p) {
+    // SSE2 has no byte shuffle, so the lanes are assembled from 32-bit loads.
+    int32_t a, b, c, d;
+    memcpy(&a, p, 4);
+    memcpy(&b, p + 3, 4);
+    memcpy(&c, p + 6, 4);
+    memcpy(&d, p + 9, 4);
+    __m128i x = _mm_slli_epi32(_mm_setr_epi32(a, b, c, d), 8);
+    return _mm_cvtepi32_ps(_mm_srai_epi32(x, 8));
+}
+#include "audiokernels_simd.inc"
+#undef KERNEL
+}  // namespace sse
+
+namespace avx2 {
+#define KERNEL static inline __attribute__((target("avx2,fma")))
+typedef __m256 vec;
+static const uint32_t WIDTH = 8;
+KERNEL vec load(const float* p) { return _mm256_loadu_ps(p); }
+KERNEL void store(float* p, vec v) { _mm256_storeu_ps(p, v); }
+KERNEL vec set1(float v) { return _mm256_set1_ps(v); }
+KERNEL vec zero() { return _mm256_setzero_ps(); }
+KERNEL vec lanes() { return _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f); }
+KERNEL vec add(vec a, vec b) { return _mm256_add_ps(a, b); }
+KERNEL vec sub(vec a, vec b) { return _mm256_sub_ps(a, b); }
+KERNEL vec mul(vec a, vec b) { return _mm256_mul_ps(a, b); }
+KERNEL vec fmadd(vec a, vec b, vec c) { return _mm256_fmadd_ps(a, b, c); }
+KERNEL vec vabs(vec a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+KERNEL vec vmax(vec a, vec b) { return _mm256_max_ps(a, b); }
+KERNEL float hsum(vec a) {
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+}
+KERNEL float hmax(vec a) {
+    __m128 m = _mm_max_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+    m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+    m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+    return _mm_cvtss_f32(m);
+}
+KERNEL void interleave2(vec a, vec b, float* dst) {
+    vec lo = _mm256_unpacklo_ps(a, b);
+    vec hi = _mm256_unpackhi_ps(a, b);
+    _mm256_storeu_ps(dst, _mm256_permute2f128_ps(lo, hi, 0x20));
+    _mm256_storeu_ps(dst + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+}
+KERNEL void deinterleave2(const float* src, vec& a, vec& b) {
+    vec x = _mm256_loadu_ps(src);
+    vec y = _mm256_loadu_ps(src + 8);
+    vec t0 = _mm256_permute2f128_ps(x, y, 0x20);
+    vec t1 = _mm256_permute2f128_ps(x, y, 0x31);
+    a = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(2, 0, 2, 0));
+    b = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 1, 3, 1));
+}
+KERNEL vec loadPCM16(const int16_t* p) {
+    return _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)p)));
+}
+KERNEL __m256i loadPCM24Lanes(const unsigned char* p) {
+    // Four samples per 128-bit lane, each moved to the top three bytes of a 32-bit word.
+    const __m256i spread = _mm256_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+                                            -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+    __m256i x = _mm256_setr_m128i(_mm_loadu_si128((const __m128i*)p),
+                                  _mm_loadu_si128((const __m128i*)(p + 12)));
+    return _mm256_srai_epi32(_mm256_shuffle_epi8(x, spread), 8);
+}
+KERNEL vec loadPCM24(const unsigned char* p) { return _mm256_cvtepi32_ps(loadPCM24Lanes(p)); }
+#include "audiokernels_simd.inc"
+#undef KERNEL
+}  // namespace avx2
+
+// GCC 12's AVX-512 intrinsics trip false uninitialised warnings (GCC PR 105593).
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+namespace avx512 {
+#define KERNEL static inline __attribute__((target("avx512f,avx2")))
+typedef __m512 vec;
+static const uint32_t WIDTH = 16;
+KERNEL vec load(const float* p) { return _mm512_loadu_ps(p); }
+KERNEL void store(float* p, vec v) { _mm512_storeu_ps(p, v); }
+KERNEL vec set1(float v) { return _mm512_set1_ps(v); }
+KERNEL vec zero() { return _mm512_setzero_ps(); }
+KERNEL vec lanes() {
+    return _mm512_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f, 8.0f, 9.0f, 10.0f,
+                          11.0f, 12.0f, 13.0f, 14.0f, 15.0f);
+}
+KERNEL vec add(vec a, vec b) { return _mm512_add_ps(a, b); }
+KERNEL vec sub(vec a, vec b) { return _mm512_sub_ps(a, b); }
+KERNEL vec mul(vec a, vec b) { return _mm512_mul_ps(a, b); }
+KERNEL vec fmadd(vec a, vec b, vec c) { return _mm512_fmadd_ps(a, b, c); }
+KERNEL vec vabs(vec a) { return _mm512_abs_ps(a); }
+KERNEL vec vmax(vec a, vec b) { return _mm512_max_ps(a, b); }
+KERNEL float hsum(vec a) { return _mm512_reduce_add_ps(a); }
+KERNEL float hmax(vec a) { return _mm512_reduce_max_ps(a); }
+KERNEL void interleave2(vec a, vec b, float* dst) {
+    __m512i lo = _mm512_setr_epi32(0, 16, 1, 17, 2, 18, 3, 19, 4, 20, 5, 21, 6, 22, 7, 23);
+    __m512i hi = _mm512_setr_epi32(8, 24, 9, 25, 10, 26, 11, 27, 12, 28, 13, 29, 14, 30, 15, 31);
+    _mm512_storeu_ps(dst, _mm512_permutex2var_ps(a, lo, b));
+    _mm512_storeu_ps(dst + 16, _mm512_permutex2var_ps(a, hi, b));
+}
+KERNEL void deinterleave2(const float* src, vec& a, vec& b) {
+    __m512i even = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30);
+    __m512i odd = _mm512_setr_epi32(1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23, 25, 27, 29, 31);
+    vec x = _mm512_loadu_ps(src);
+    vec y = _mm512_loadu_ps(src + 16);
+    a = _mm512_permutex2var_ps(x, even, y);
+    b = _mm512_permutex2var_ps(x, odd, y);
+}
+KERNEL vec loadPCM16(const int16_t* p) {
+    return _mm512_cvtepi32_ps(_mm512_cvtepi16_epi32(_mm256_loadu_si256((const __m256i*)p)));
+}
+KERNEL vec loadPCM24(const unsigned char* p) {
+    __m512i lanes = _mm512_castsi256_si512(avx2::loadPCM24Lanes(p));
+    return _mm512_cvtepi32_ps(_mm512_inserti64x4(lanes, avx2::loadPCM24Lanes(p + 24), 1));
+}
+#include "audiokernels_simd.inc"
+#undef KERNEL
+}  // namespace avx512
+#pragma GCC diagnostic pop
+#endif
+
+const KernelTable* tableFor(Implementation implementation) {
+    switch (implementation) {
+#ifdef AUDIOKERNELS_X86
+        case Implementation::AVX512:
+            return &avx512::table;
+        case Implementation::AVX2:
+            return &avx2::table;
+        case Implementation::SSE:
+            return &sse::table;
+#endif
+        default:
+            return &scalar::table;
+    }
+}
+
+Implementation detect() {
+#ifdef AUDIOKERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return Implementation::AVX512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return Implementation::AVX2;
+    if (__builtin_cpu_supports("sse2")) return Implementation::SSE;
+#endif
+    return Implementation::SCALAR;
+}
+
+// Constant-initialised so kernels used during static initialisation of other
+// translation units fall back to scalar code until detection has run.
+Implementation active = Implementation::SCALAR;
+const KernelTable* kernels = &scalar::table;
+}  // namespace
+
+Implementation getImplementation() { return active; }
+
+const char* getImplementationName(Implementation implementation) {
+    switch (implementation) {
+        case Implementation::AVX512:
+            return "avx512";
+        case Implementation::AVX2:
+            return "avx2";
+        case Implementation::SSE:
+            return "sse";
+        default:
+            return "scalar";
+    }
+}
+
+bool isSupported(Implementation implementation) { return implementation <= detect(); }
+
+bool useImplementation(Implementation implementation) {
+    if (!isSupported(implementation)) return false;
+    active = implementation;
+    kernels = tableFor(implementation);
+    return true;
+}
+
+namespace {
+struct Selector {
+    Selector() { useImplementation(detect()); }
+} selector;
+}  // namespace
+
+void clear(float* dst, uint32_t nframes) { kernels->clear(dst, nframes); }
+void copy(float* dst, const float* src, uint32_t nframes) { kernels->copy(dst, src, nframes); }
+void gain(float* dst, const float* src, float gain, uint32_t nframes) {
+    kernels->gain(dst, src, gain, nframes);
+}
+void mixAdd(float* dst, const float* src, float gain, uint32_t nframes) {
+    kernels->mixAdd(dst, src, gain, nframes);
+}
+void gainRamp(float* dst, const float* src, float start, float end, uint32_t nframes) {
+    kernels->gainRamp(dst, src, start, end, nframes);
+}
+void mixAddRamp(float* dst, const float* src, float start, float end, uint32_t nframes) {
+    kernels->mixAddRamp(dst, src, start, end, nframes);
+}
+void interleave(float* dst, const float* const* src, uint32_t channels, uint32_t nframes) {
+    kernels->interleave(dst, src, channels, nframes);
+}
+void deinterleave(float* const* dst, const float* src, uint32_t channels, uint32_t nframes) {
+    kernels->deinterleave(dst, src, channels, nframes);
+}
+float peak(const float* src, uint32_t nframes) { return kernels->peak(src, nframes); }
+float rms(const float* src, uint32_t nframes) { return kernels->rms(src, nframes); }
+void fromPCM16(float* dst, const int16_t* src, uint32_t count) {
+    kernels->fromPCM16(dst, src, count);
+}
+void fromPCM24(float* dst, const unsigned char* src, uint32_t count) {
+    kernels->fromPCM24(dst, src, count);
+}
+void butterfly(float* re0, float* im0, float* re1, float* im1, const float* wr, const float* wi,
+               uint32_t count) {
+    kernels->butterfly(re0, im0, re1, im1, wr, wi, count);
+}
+void power(float* dst, const float* re, const float* im, uint32_t count) {
+    kernels->power(dst, re, im, count);
+}
+}  // namespace AudioKernels
@@ -0,0 +1,47 @@
+#ifndef _JACKCLIENT_AUDIOKERNELS_H
+#define _JACKCLIENT_AUDIOKERNELS_H
+#include <stdint.h>
+
+/**
+ * Vectorised loops for float port buffers. The best implementation the CPU
+ * supports (AVX-512, AVX2/FMA, SSE or plain scalar code) is picked at
+ * startup. Buffers need no particular alignment and dst may equal src.
+ * */
+namespace AudioKernels {
+enum class Implementation { SCALAR, SSE, AVX2, AVX512 };
+
+Implementation getImplementation();
+const char* getImplementationName(Implementation implementation);
+bool isSupported(Implementation implementation);
+/** Switches all kernels to the given implementation, returns false if the CPU lacks it. */
+bool useImplementation(Implementation implementation);
+
+void clear(float* dst, uint32_t nframes);
+void copy(float* dst, const float* src, uint32_t nframes);
+/** dst = src * gain */
+void gain(float* dst, const float* src, float gain, uint32_t nframes);
+/** dst += src * gain */
+void mixAdd(float* dst, const float* src, float gain, uint32_t nframes);
+/** dst = src * g, g going linearly from start (first frame) towards end (frame nframes). */
+void gainRamp(float* dst, const float* src, float start, float end, uint32_t nframes);
+/** dst += src * g, ramping like gainRamp(). */
+void mixAddRamp(float* dst, const float* src, float start, float end, uint32_t nframes);
+void interleave(float* dst, const float* const* src, uint32_t channels, uint32_t nframes);
+void deinterleave(float* const* dst, const float* src, uint32_t channels, uint32_t nframes);
+/** Largest absolute sample value. */
+float peak(const float* src, uint32_t nframes);
+float rms(const float* src, uint32_t nframes);
+/** Converts count little-endian 16-bit samples to floats in [-1, 1). */
+void fromPCM16(float* dst, const int16_t* src, uint32_t count);
+/** Converts count packed little-endian 24-bit samples (3 bytes each) to floats in [-1, 1). */
+void fromPCM24(float* dst, const unsigned char* src, uint32_t count);
+/**
+ * Radix-2 FFT butterflies on split complex arrays: with t = (re1, im1) * (wr, wi),
+ * (re1, im1) = (re0, im0) - t and (re0, im0) += t, element by element.
+ * */
+void butterfly(float* re0, float* im0, float* re1, float* im1, const float* wr, const float* wi,
+               uint32_t count);
+/** dst = re * re + im * im */
+void power(float* dst, const float* re, const float* im, uint32_t count);
+}  // namespace AudioKernels
+#endif
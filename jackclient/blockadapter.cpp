@@ -0,0 +1,179 @@
+#include "blockadapter.h"
+
+#include <algorithm>
+#include <cstring>
+
+static uint32_t gcd(uint32_t a, uint32_t b) {
+    while (b) {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+JackBlockAdapter::JackBlockAdapter(JackClient* client, uint32_t inputs, uint32_t outputs,
+                                   uint32_t blockSize, BlockFunction function,
+                                   JackBlockMode mode, bool reportLatency)
+    : client(client),
+      function(function),
+      inputs(inputs),
+      outputs(outputs),
+      blockSize(blockSize),
+      mode(mode),
+      reportLatency(reportLatency),
+      blockIn(inputs),
+      blockOut(outputs),
+      helperIn(inputs),
+      helperOut(outputs),
+      lateBlocks(0),
+      underruns(0),
+      running(false) {
+    if (blockSize == 0) throw JackClientException("Block size must not be 0");
+    sem_init(&this->wakeup, 0, 0);
+    sem_init(&this->finished, 0, 0);
+    this->rebuild(client->getBufferSize());
+    if (mode == JackBlockMode::SPREAD) {
+        this->running.store(true);
+        this->helper = client->createRealtimeThread(&JackBlockAdapter::helperMain, this, -1);
+        this->helperStarted = true;
+    }
+    bool changed;
+    {
+        std::lock_guard<std::mutex> lock(client->adaptersMutex);
+        client->adapters.push_back(this);
+        changed = client->updateAdapterLatency();
+    }
+    if (changed) client->recomputeLatencies();
+}
+
+JackBlockAdapter::~JackBlockAdapter() {
+    bool changed;
+    {
+        std::lock_guard<std::mutex> lock(this->client->adaptersMutex);
+        std::vector<JackBlockAdapter*>& list = this->client->adapters;
+        list.erase(std::remove(list.begin(), list.end(), this), list.end());
+        changed = this->client->updateAdapterLatency();
+    }
+    if (changed) this->client->recomputeLatencies();
+    if (this->helperStarted) {
+        this->running.store(false);
+        sem_post(&this->wakeup);
+        this->client->stopThread(this->helper);
+    }
+    sem_destroy(&this->wakeup);
+    sem_destroy(&this->finished);
+}
+
+void JackBlockAdapter::rebuild(uint32_t period) {
+    // The helper may still be working on the last block handed over.
+    if (this->pending) {
+        while (sem_wait(&this->finished) != 0) {
+        }
+        this->pending = false;
+    }
+    uint32_t extra = this->mode == JackBlockMode::SPREAD ? this->blockSize : 0;
+    this->period = period;
+    this->latency = period ? this->blockSize - gcd(this->blockSize, period) + extra : 0;
+    size_t fifoSize = 1;
+    while (fifoSize < (size_t)this->latency + 2 * this->blockSize + period) fifoSize <<= 1;
+    this->fifoSize = fifoSize;
+    this->fifo.assign(fifoSize * this->outputs, 0.0f);
+    size_t channels = 2 * (this->inputs + this->outputs);
+    this->blockStorage.assign(channels * this->blockSize, 0.0f);
+    float* next = this->blockStorage.data();
+    for (std::vector<float*>* set : {&this->blockIn, &this->blockOut, &this->helperIn,
+                                     &this->helperOut}) {
+        for (float*& ptr : *set) {
+            ptr = next;
+            next += this->blockSize;
+        }
+    }
+    this->fill = 0;
+    this->readIndex = 0;
+    this->writeIndex = this->latency;
+}
+
+void* JackBlockAdapter::helperMain(void* arg) {
+    JackBlockAdapter* adapter = static_cast<JackBlockAdapter*>(arg);
+    for (;;) {
+        while (sem_wait(&adapter->wakeup) != 0) {
+        }
+        if (!adapter->running.load(std::memory_order_acquire)) break;
+        {
+            JackRTCheck::Scope realtime;
+            adapter->function(adapter->helperIn.data(), adapter->helperOut.data(),
+                              adapter->blockSize);
+        }
+        sem_post(&adapter->finished);
+    }
+    return nullptr;
+}
+
+void JackBlockAdapter::pushBlock(float* const* block) {
+    size_t mask = this->fifoSize - 1;
+    size_t start = this->writeIndex & mask;
+    size_t first = std::min((size_t)this->blockSize, this->fifoSize - start);
+    for (uint32_t c = 0; c < this->outputs; c++) {
+        float* channel = this->fifo.data() + c * this->fifoSize;
+        std::memcpy(channel + start, block[c], first * sizeof(float));
+        std::memcpy(channel, block[c] + first, (this->blockSize - first) * sizeof(float));
+    }
+    this->writeIndex += this->blockSize;
+}
+
+void JackBlockAdapter::completeBlock() {
+    if (this->mode == JackBlockMode::DIRECT) {
+        this->function(this->blockIn.data(), this->blockOut.data(), this->blockSize);
+        this->pushBlock(this->blockOut.data());
+        return;
+    }
+    if (this->pending) {
+        if (sem_trywait(&this->finished) != 0) {
+            this->lateBlocks.fetch_add(1, std::memory_order_relaxed);
+            while (sem_wait(&this->finished) != 0) {
+            }
+        }
+        this->pushBlock(this->helperOut.data());
+    }
+    // Swapping vectors only exchanges their pointers.
+    this->blockIn.swap(this->helperIn);
+    this->pending = true;
+    sem_post(&this->wakeup);
+}
+
+void JackBlockAdapter::process(const float* const* inputs, float* const* outputs,
+                               uint32_t nframes) {
+    if (nframes > this->period) {
+        this->underruns.fetch_add(1, std::memory_order_relaxed);
+        for (uint32_t c = 0; c < this->outputs; c++)
+            std::memset(outputs[c], 0, nframes * sizeof(float));
+        return;
+    }
+    for (uint32_t offset = 0; offset < nframes;) {
+        uint32_t count = std::min(this->blockSize - this->fill, nframes - offset);
+        for (uint32_t c = 0; c < this->inputs; c++)
+            std::memcpy(this->blockIn[c] + this->fill, inputs[c] + offset,
+                        count * sizeof(float));
+        this->fill += count;
+        offset += count;
+        if (this->fill == this->blockSize) {
+            this->completeBlock();
+            this->fill = 0;
+        }
+    }
+
+    size_t available = this->writeIndex - this->readIndex;
+    uint32_t count = (uint32_t)std::min((size_t)nframes, available);
+    if (count < nframes) this->underruns.fetch_add(1, std::memory_order_relaxed);
+    size_t mask = this->fifoSize - 1;
+    size_t start = this->readIndex & mask;
+    size_t first = std::min((size_t)count, this->fifoSize - start);
+    for (uint32_t c = 0; c < this->outputs; c++) {
+        const float* channel = this->fifo.data() + c * this->fifoSize;
+        std::memcpy(outputs[c], channel + start, first * sizeof(float));
+        std::memcpy(outputs[c] + first, channel, (count - first) * sizeof(float));
+        std::memset(outputs[c] + count, 0, (nframes - count) * sizeof(float));
+    }
+    this->readIndex += count;
+}
@@ -0,0 +1,97 @@
+#ifndef _JACKCLIENT_BLOCKADAPTER_H
+#define _JACKCLIENT_BLOCKADAPTER_H
+#include <semaphore.h>
+
+#include <atomic>
+#include <functional>
+#include <vector>
+
+#include "jackclient.h"
+
+enum class JackBlockMode {
+    /** Blocks run in the process thread as soon as they are complete. */
+    DIRECT,
+    /**
+     * Blocks run on a helper thread below the client's real-time priority
+     * while the next block is collected, so the work is spread over the
+     * periods of one block. Adds one block of latency. Only useful with
+     * blocks longer than the period; otherwise the process thread ends up
+     * waiting for the helper.
+     * */
+    SPREAD
+};
+
+/**
+ * Runs DSP that needs a fixed block size, such as FFT convolution, inside
+ * a client with any period. Input is collected until a block is complete
+ * and output is served from a FIFO primed with the smallest latency that
+ * never runs dry: blockSize - gcd(blockSize, period) frames in DIRECT mode,
+ * one block more in SPREAD mode. Unless disabled, the latency is reported
+ * to JACK as part of JackClient::getProcessingLatency(), which takes the
+ * largest of all adapters and setProcessingLatency().
+ *
+ * Buffers are sized for the current period and rebuilt from JackClient's
+ * buffer size callback, while JACK is not running the process callback, so
+ * process() never allocates.
+ * */
+class JackBlockAdapter {
+   public:
+    typedef std::function<void(const float* const* inputs, float* const* outputs,
+                               uint32_t blockSize)>
+        BlockFunction;
+
+   private:
+    JackClient* client;
+    BlockFunction function;
+    uint32_t inputs;
+    uint32_t outputs;
+    uint32_t blockSize;
+    JackBlockMode mode;
+    bool reportLatency;
+    uint32_t period = 0;
+    uint32_t latency = 0;
+    uint32_t fill = 0;
+    size_t fifoSize = 0;
+    size_t readIndex = 0;
+    size_t writeIndex = 0;
+    bool pending = false;
+    std::vector<float> blockStorage;
+    std::vector<float> fifo;
+    std::vector<float*> blockIn;
+    std::vector<float*> blockOut;
+    std::vector<float*> helperIn;
+    std::vector<float*> helperOut;
+    std::atomic<uint64_t> lateBlocks;
+    std::atomic<uint64_t> underruns;
+
+    jack_native_thread_t helper;
+    bool helperStarted = false;
+    std::atomic<bool> running;
+    sem_t wakeup;
+    sem_t finished;
+
+    static void* helperMain(void* arg);
+    void pushBlock(float* const* block);
+    void completeBlock();
+
+   public:
+    JackBlockAdapter(JackClient* client, uint32_t inputs, uint32_t outputs, uint32_t blockSize,
+                     BlockFunction function, JackBlockMode mode = JackBlockMode::DIRECT,
+                     bool reportLatency = true);
+    ~JackBlockAdapter();
+    /** Resizes the buffers for a new period and restarts with silence; not real-time safe. */
+    void rebuild(uint32_t period);
+    /** Feeds one period of input and fills one period of output. Call from onProcess. */
+    void process(const float* const* inputs, float* const* outputs, uint32_t nframes);
+
+    uint32_t getBlockSize() const { return blockSize; };
+    JackBlockMode getMode() const { return mode; };
+    /** Frames between input and the matching output. */
+    uint32_t getLatency() const { return latency; };
+    bool isReportingLatency() const { return reportLatency; };
+    /** SPREAD mode: blocks the helper thread had not finished when their output was due. */
+    uint64_t getLateBlockCount() const { return lateBlocks.load(std::memory_order_relaxed); };
+    /** Periods the output FIFO could not fill, e.g. when called with a changed period. */
+    uint64_t getUnderrunCount() const { return underruns.load(std::memory_order_relaxed); };
+};
+#endif
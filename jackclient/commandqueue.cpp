@@ -0,0 +1,92 @@
+#include "commandqueue.h"
+
+#include <algorithm>
+
+JackCommandQueue::JackCommandQueue(size_t minCapacity) : enqueuePos(0), dequeuePos(0) {
+    size_t capacity = 2;
+    while (capacity < minCapacity) capacity <<= 1;
+    this->cells.reset(new Cell[capacity]);
+    this->mask = capacity - 1;
+    for (size_t i = 0; i < capacity; i++)
+        this->cells[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+bool JackCommandQueue::push(const JackCommand& command) {
+    size_t pos = this->enqueuePos.load(std::memory_order_relaxed);
+    for (;;) {
+        Cell& cell = this->cells[pos & this->mask];
+        size_t seq = cell.sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            if (this->enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                cell.command = command;
+                cell.sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = this->enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+JackCommand* JackCommandQueue::front() {
+    Cell& cell = this->cells[this->dequeuePos & this->mask];
+    if (cell.sequence.load(std::memory_order_acquire) != this->dequeuePos + 1) return nullptr;
+    return &cell.command;
+}
+
+void JackCommandQueue::pop() {
+    Cell& cell = this->cells[this->dequeuePos & this->mask];
+    cell.sequence.store(this->dequeuePos + this->mask + 1, std::memory_order_release);
+    this->dequeuePos++;
+}
+
+namespace {
+// Frame times wrap, so they are compared by their signed distance.
+struct Later {
+    template <typename Entry>
+    bool operator()(const Entry& a, const Entry& b) const {
+        int32_t distance = (int32_t)(a.command.time - b.command.time);
+        return distance > 0 || (distance == 0 && a.sequence > b.sequence);
+    }
+};
+}  // namespace
+
+JackCommandSchedule::JackCommandSchedule(size_t capacity) : capacity(capacity) {
+    this->heap.reserve(capacity);
+}
+
+void JackCommandSchedule::push(const JackCommand& command) {
+    this->heap.push_back(Entry{command, this->sequence++});
+    std::push_heap(this->heap.begin(), this->heap.end(), Later());
+}
+
+void JackCommandSchedule::pop() {
+    std::pop_heap(this->heap.begin(), this->heap.end(), Later());
+    this->heap.pop_back();
+}
+
+JackParameter::JackParameter(JackClient* client, float value, bool smoothed)
+    : client(client), value(value), previous(value), smoothed(smoothed), changedCycle(0) {}
+
+void JackParameter::set(float value) {
+    uint64_t cycle = this->client->getCycleCount();
+    if (this->changedCycle != cycle) {
+        this->previous = this->value;
+        this->changedCycle = cycle;
+    }
+    this->value = value;
+}
+
+float JackParameter::getBlockStart() const {
+    if (this->smoothed && this->changedCycle == this->client->getCycleCount())
+        return this->previous;
+    return this->value;
+}
+
+float JackParameter::getIncrement(uint32_t nframes) const {
+    if (nframes == 0) return 0.0f;
+    return (this->value - this->getBlockStart()) / nframes;
+}
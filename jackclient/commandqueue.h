@@ -0,0 +1,106 @@
+#ifndef _JACKCLIENT_COMMANDQUEUE_H
+#define _JACKCLIENT_COMMANDQUEUE_H
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "jackclient.h"
+
+enum class JackCommandType { MIDI, PARAMETER, CALLBACK };
+
+/**
+ * A command sent to the process thread. time is an absolute frame time
+ * (see JackClient::getFrameTime()); commands due in a later cycle wait in
+ * the client's JackCommandSchedule until that cycle starts. Untimed
+ * commands carry the time they were sent, which only orders them, and
+ * apply at the start of the next cycle without counting as late.
+ * */
+struct JackCommand {
+    static const size_t MAX_MIDI_SIZE = 16;
+
+    JackCommandType type;
+    jack_nframes_t time;
+    bool timed;
+    void* target;
+    float value;
+    void (*function)(void* arg);
+    uint8_t size;
+    unsigned char data[MAX_MIDI_SIZE];
+};
+
+/**
+ * Bounded lock-free multi-producer/single-consumer queue. Any thread may
+ * push; only the process thread pops. All storage is allocated up front.
+ * */
+class JackCommandQueue : public JackCacheAligned {
+   private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        JackCommand command;
+    };
+    std::unique_ptr<Cell[]> cells;
+    size_t mask;
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> enqueuePos;
+    alignas(CACHE_LINE_SIZE) size_t dequeuePos;
+
+   public:
+    explicit JackCommandQueue(size_t minCapacity);
+    bool push(const JackCommand& command);
+    /** Oldest command, or nullptr if the queue is empty. Consumer only. */
+    JackCommand* front();
+    /** Removes the command returned by front(). Consumer only. */
+    void pop();
+    size_t getCapacity() const { return mask + 1; };
+};
+
+/**
+ * Commands taken off the queue, ordered by time and, at equal times, by
+ * arrival, so a command scheduled far ahead never holds up the ones behind
+ * it and MIDI from several producers is written in time order. Process
+ * thread only; the storage is allocated up front.
+ * */
+class JackCommandSchedule {
+   private:
+    struct Entry {
+        JackCommand command;
+        uint64_t sequence;
+    };
+    std::vector<Entry> heap;
+    size_t capacity;
+    uint64_t sequence = 0;
+
+   public:
+    explicit JackCommandSchedule(size_t capacity);
+    bool isEmpty() const { return heap.empty(); };
+    bool isFull() const { return heap.size() == capacity; };
+    void push(const JackCommand& command);
+    /** Earliest command; the schedule must not be empty. */
+    JackCommand& top() { return heap.front().command; };
+    void pop();
+};
+
+/**
+ * A DSP parameter owned by the process thread and updated through
+ * JackClient::setParameter(). With smoothing enabled, a change made in the
+ * current cycle ramps linearly from getBlockStart() to getValue() over the
+ * block; otherwise the new value applies to the whole block.
+ * */
+class JackParameter {
+   private:
+    JackClient* client;
+    float value;
+    float previous;
+    bool smoothed;
+    uint64_t changedCycle;
+
+   public:
+    JackParameter(JackClient* client, float value, bool smoothed = true);
+    /** Process thread only. */
+    void set(float value);
+    float getValue() const { return value; };
+    float getBlockStart() const;
+    /** Per-sample increment of the ramp for a block of nframes. */
+    float getIncrement(uint32_t nframes) const;
+    bool isSmoothed() const { return smoothed; };
+};
+#endif
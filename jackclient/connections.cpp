@@ -0,0 +1,318 @@
+#include "connections.h"
+
+#include <errno.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <regex>
+#include <set>
+#include <utility>
+
+#include "portgraph.h"
+
+typedef std::pair<uint32_t, uint32_t> Edge;
+
+JackConnectionPlan& JackConnectionPlan::connect(const std::string& source,
+                                                const std::string& destination) {
+    this->rules.push_back(
+        {source, destination, false, JackPatternSyntax::GLOB, JackPatternMode::PAIRWISE, true});
+    return *this;
+}
+
+JackConnectionPlan& JackConnectionPlan::connect(const std::vector<JackConnection>& connections) {
+    for (const JackConnection& connection : connections)
+        this->connect(connection.source, connection.destination);
+    return *this;
+}
+
+JackConnectionPlan& JackConnectionPlan::disconnect(const std::string& source,
+                                                   const std::string& destination) {
+    this->rules.push_back(
+        {source, destination, false, JackPatternSyntax::GLOB, JackPatternMode::PAIRWISE, false});
+    return *this;
+}
+
+JackConnectionPlan& JackConnectionPlan::connectPattern(const std::string& sources,
+                                                       const std::string& destinations,
+                                                       JackPatternSyntax syntax,
+                                                       JackPatternMode mode) {
+    this->rules.push_back({sources, destinations, true, syntax, mode, true});
+    return *this;
+}
+
+JackConnectionPlan& JackConnectionPlan::disconnectPattern(const std::string& sources,
+                                                          const std::string& destinations,
+                                                          JackPatternSyntax syntax) {
+    this->rules.push_back({sources, destinations, true, syntax, JackPatternMode::ALL, false});
+    return *this;
+}
+
+JackConnectionPlan& JackConnectionPlan::setExclusive(bool exclusive) {
+    this->exclusive = exclusive;
+    return *this;
+}
+
+static std::regex compilePattern(const std::string& pattern, JackPatternSyntax syntax) {
+    std::string expression;
+    if (syntax == JackPatternSyntax::REGEX) {
+        expression = pattern;
+    } else {
+        bool inClass = false;
+        for (size_t i = 0; i < pattern.size(); i++) {
+            char c = pattern[i];
+            if (inClass) {
+                if (c == ']') inClass = false;
+                if (c == '\\') expression += '\\';
+                expression += c;
+            } else if (c == '*') {
+                expression += ".*";
+            } else if (c == '?') {
+                expression += '.';
+            } else if (c == '[') {
+                inClass = true;
+                expression += '[';
+                if (i + 1 < pattern.size() && pattern[i + 1] == '!') {
+                    expression += '^';
+                    i++;
+                }
+            } else {
+                if (std::string("\\^$.|+()[]{}").find(c) != std::string::npos) expression += '\\';
+                expression += c;
+            }
+        }
+    }
+    try {
+        return std::regex(expression, std::regex::ECMAScript | std::regex::optimize);
+    } catch (std::regex_error&) {
+        throw JackClientException("Invalid port pattern " + pattern);
+    }
+}
+
+// Compares runs of digits by value, so "capture_2" sorts before "capture_10".
+static bool naturalLess(const std::string& a, const std::string& b) {
+    size_t i = 0, j = 0;
+    while (i < a.size() && j < b.size()) {
+        if (!isdigit((unsigned char)a[i]) || !isdigit((unsigned char)b[j])) {
+            if (a[i] != b[j]) return (unsigned char)a[i] < (unsigned char)b[j];
+            i++;
+            j++;
+            continue;
+        }
+        while (i < a.size() && a[i] == '0') i++;
+        while (j < b.size() && b[j] == '0') j++;
+        size_t startA = i, startB = j;
+        while (i < a.size() && isdigit((unsigned char)a[i])) i++;
+        while (j < b.size() && isdigit((unsigned char)b[j])) j++;
+        if (i - startA != j - startB) return i - startA < j - startB;
+        int order = a.compare(startA, i - startA, b, startB, j - startB);
+        if (order) return order < 0;
+    }
+    if (a.size() - i != b.size() - j) return a.size() - i < b.size() - j;
+    // Equal apart from leading zeros.
+    return a < b;
+}
+
+static std::vector<uint32_t> matchPorts(const JackPortGraphSnapshot& graph, const std::regex& regex,
+                                        int direction) {
+    std::vector<uint32_t> matches;
+    for (uint32_t i = 0; i < graph.size(); i++)
+        if ((graph[i].flags & direction) && std::regex_match(graph[i].name, regex))
+            matches.push_back(i);
+    std::sort(matches.begin(), matches.end(), [&graph](uint32_t a, uint32_t b) {
+        return naturalLess(graph[a].name, graph[b].name);
+    });
+    return matches;
+}
+
+static bool isConnected(const JackPortGraphSnapshot& graph, const Edge& edge) {
+    const std::vector<uint32_t>& connections = graph[edge.first].connections;
+    return std::find(connections.begin(), connections.end(), edge.second) != connections.end();
+}
+
+// Asks the server directly, as the cached graph may not have caught up yet.
+static bool isConnected(jack_client_t* client, const char* source, const char* destination) {
+    jack_port_t* port = jack_port_by_name(client, source);
+    const char** connections = port ? jack_port_get_all_connections(client, port) : NULL;
+    if (!connections) return false;
+    bool found = false;
+    for (size_t i = 0; connections[i] && !found; i++)
+        found = !std::strcmp(connections[i], destination);
+    jack_free(connections);
+    return found;
+}
+
+JackConnector::JackConnector(JackClient* client) : client(client) {}
+
+JackConnector::~JackConnector() {
+    {
+        std::lock_guard<std::mutex> lock(this->jobsMutex);
+        this->running = false;
+    }
+    this->jobsWakeup.notify_all();
+    if (this->worker.joinable()) this->worker.join();
+}
+
+std::vector<JackConnectionResult> JackConnector::resolve(const JackConnectionPlan& plan) {
+    std::shared_ptr<const JackPortGraphSnapshot> snapshot = this->client->getPortGraph();
+    const JackPortGraphSnapshot& graph = *snapshot;
+    std::vector<JackConnectionResult> results;
+    std::vector<Edge> desired;
+    std::set<Edge> desiredSet;
+    std::set<Edge> removals;
+
+    auto fail = [&results](const JackConnectionPlan::Rule& rule, int error) {
+        results.push_back({{rule.source, rule.destination},
+                           rule.connect ? JackConnectionAction::CONNECT
+                                        : JackConnectionAction::DISCONNECT,
+                           error});
+    };
+    auto add = [&](const JackConnectionPlan::Rule& rule, const Edge& edge) {
+        if (rule.connect) {
+            if (desiredSet.insert(edge).second) desired.push_back(edge);
+        } else {
+            removals.insert(edge);
+        }
+    };
+
+    for (const JackConnectionPlan::Rule& rule : plan.rules) {
+        if (!rule.pattern) {
+            const JackPortGraphSnapshot::Port* source = graph.find(rule.source);
+            const JackPortGraphSnapshot::Port* destination = graph.find(rule.destination);
+            if (!source || !destination) {
+                fail(rule, ENOENT);
+            } else if (source->type != destination->type || !(source->flags & JackPortIsOutput) ||
+                       !(destination->flags & JackPortIsInput)) {
+                fail(rule, EINVAL);
+            } else {
+                add(rule, Edge(source - &graph[0], destination - &graph[0]));
+            }
+            continue;
+        }
+        std::vector<uint32_t> sources =
+            matchPorts(graph, compilePattern(rule.source, rule.syntax), JackPortIsOutput);
+        std::vector<uint32_t> destinations =
+            matchPorts(graph, compilePattern(rule.destination, rule.syntax), JackPortIsInput);
+        if (rule.mode == JackPatternMode::PAIRWISE) {
+            size_t count = std::min(sources.size(), destinations.size());
+            for (size_t i = 0; i < count; i++) {
+                if (graph[sources[i]].type != graph[destinations[i]].type)
+                    results.push_back({{graph[sources[i]].name, graph[destinations[i]].name},
+                                       JackConnectionAction::CONNECT, EINVAL});
+                else
+                    add(rule, Edge(sources[i], destinations[i]));
+            }
+        } else {
+            for (uint32_t source : sources)
+                for (uint32_t destination : destinations)
+                    if (graph[source].type == graph[destination].type)
+                        add(rule, Edge(source, destination));
+        }
+    }
+
+    if (plan.exclusive) {
+        std::set<uint32_t> touched;
+        for (const Edge& edge : desired) {
+            touched.insert(edge.first);
+            touched.insert(edge.second);
+        }
+        for (uint32_t port : touched) {
+            bool isOutput = graph[port].flags & JackPortIsOutput;
+            for (uint32_t other : graph[port].connections) {
+                Edge edge = isOutput ? Edge(port, other) : Edge(other, port);
+                if (!desiredSet.count(edge)) removals.insert(edge);
+            }
+        }
+    }
+
+    for (const Edge& edge : removals) {
+        if (desiredSet.count(edge) || !isConnected(graph, edge)) continue;
+        results.push_back({{graph[edge.first].name, graph[edge.second].name},
+                           JackConnectionAction::DISCONNECT, 0});
+    }
+    for (const Edge& edge : desired) {
+        results.push_back({{graph[edge.first].name, graph[edge.second].name},
+                           isConnected(graph, edge) ? JackConnectionAction::UNCHANGED
+                                                    : JackConnectionAction::CONNECT,
+                           0});
+    }
+    return results;
+}
+
+void JackConnector::execute(std::vector<JackConnectionResult>& changes,
+                            const ResultCallback& callback) {
+    jack_client_t* handle = this->client->client;
+    JackPortGraph* graph = this->client->graph.get();
+    for (JackConnectionResult& result : changes) {
+        if (result.ok() && result.action != JackConnectionAction::UNCHANGED) {
+            const char* source = result.connection.source.c_str();
+            const char* destination = result.connection.destination.c_str();
+            if (result.action == JackConnectionAction::CONNECT) {
+                result.error = graph->connect(source, destination);
+                // The cached graph may lag behind the server by a few events.
+                if (result.error == EEXIST) {
+                    result.action = JackConnectionAction::UNCHANGED;
+                    result.error = 0;
+                }
+            } else {
+                result.error = graph->disconnect(source, destination);
+                if (result.error && !isConnected(handle, source, destination)) {
+                    result.action = JackConnectionAction::UNCHANGED;
+                    result.error = 0;
+                }
+            }
+        }
+        if (callback) callback(result);
+    }
+}
+
+std::vector<JackConnectionResult> JackConnector::preview(const JackConnectionPlan& plan) {
+    return this->resolve(plan);
+}
+
+std::vector<JackConnectionResult> JackConnector::apply(const JackConnectionPlan& plan,
+                                                       ResultCallback callback) {
+    if (this->client->getState() != JackState::ACTIVE)
+        throw JackClientException("Cannot connect ports when client is not active");
+    std::vector<JackConnectionResult> results = this->resolve(plan);
+    this->execute(results, callback);
+    return results;
+}
+
+std::future<std::vector<JackConnectionResult>> JackConnector::applyAsync(
+    const JackConnectionPlan& plan, ResultCallback callback) {
+    if (this->client->getState() != JackState::ACTIVE)
+        throw JackClientException("Cannot connect ports when client is not active");
+    std::future<std::vector<JackConnectionResult>> future;
+    {
+        std::lock_guard<std::mutex> lock(this->jobsMutex);
+        if (!this->running) {
+            this->running = true;
+            this->worker = std::thread(&JackConnector::run, this);
+        }
+        this->jobs.push_back({plan, callback, std::promise<std::vector<JackConnectionResult>>()});
+        future = this->jobs.back().promise.get_future();
+    }
+    this->jobsWakeup.notify_one();
+    return future;
+}
+
+void JackConnector::run() {
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(this->jobsMutex);
+            this->jobsWakeup.wait(lock, [this]() { return !this->running || !this->jobs.empty(); });
+            if (this->jobs.empty()) return;
+            job = std::move(this->jobs.front());
+            this->jobs.pop_front();
+        }
+        try {
+            std::vector<JackConnectionResult> results = this->resolve(job.plan);
+            this->execute(results, job.callback);
+            job.promise.set_value(std::move(results));
+        } catch (...) {
+            job.promise.set_exception(std::current_exception());
+        }
+    }
+}
@@ -0,0 +1,122 @@
+#ifndef _JACKCLIENT_CONNECTIONS_H
+#define _JACKCLIENT_CONNECTIONS_H
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "jackclient.h"
+
+enum class JackPatternSyntax { GLOB, REGEX };
+/**
+ * How ports matched by a source and a destination pattern are paired up.
+ * PAIRWISE sorts both sets of matches by full port name, with runs of
+ * digits compared by value, and connects the n-th source to the n-th
+ * destination, e.g. capture_2 to in_2 and capture_10 to in_10; ports left
+ * over in the larger set stay unconnected. ALL connects every source to
+ * every destination.
+ * */
+enum class JackPatternMode { PAIRWISE, ALL };
+enum class JackConnectionAction { CONNECT, DISCONNECT, UNCHANGED };
+
+struct JackConnection {
+    std::string source;
+    std::string destination;
+};
+
+struct JackConnectionResult {
+    JackConnection connection;
+    JackConnectionAction action;
+    /** 0 on success, otherwise the error of jack_(dis)connect, ENOENT or EINVAL. */
+    int error;
+    bool ok() const { return error == 0; };
+};
+
+/**
+ * The connections a set of ports should end up with. Patterns match full
+ * port names ("client:port") and are expanded against the port graph when
+ * the plan is applied. Sources are output ports, destinations input ports.
+ * */
+class JackConnectionPlan {
+    friend class JackConnector;
+
+   private:
+    struct Rule {
+        std::string source;
+        std::string destination;
+        bool pattern;
+        JackPatternSyntax syntax;
+        JackPatternMode mode;
+        bool connect;
+    };
+    std::vector<Rule> rules;
+    bool exclusive = false;
+
+   public:
+    JackConnectionPlan& connect(const std::string& source, const std::string& destination);
+    JackConnectionPlan& connect(const std::vector<JackConnection>& connections);
+    JackConnectionPlan& disconnect(const std::string& source, const std::string& destination);
+    JackConnectionPlan& connectPattern(const std::string& sources,
+                                       const std::string& destinations,
+                                       JackPatternSyntax syntax = JackPatternSyntax::GLOB,
+                                       JackPatternMode mode = JackPatternMode::PAIRWISE);
+    JackConnectionPlan& disconnectPattern(const std::string& sources,
+                                          const std::string& destinations,
+                                          JackPatternSyntax syntax = JackPatternSyntax::GLOB);
+    /**
+     * When set, existing connections of every port the plan connects that
+     * are not part of the plan are removed, e.g. to restore a saved patch.
+     * */
+    JackConnectionPlan& setExclusive(bool exclusive);
+    bool isEmpty() const { return rules.empty(); };
+};
+
+/**
+ * Applies connection plans for a client. A plan is diffed against the
+ * cached port graph, which includes the changes of earlier plans, so only
+ * missing connections are made and only existing ones removed; port types
+ * and directions are checked once while the plan is resolved. Plans can run
+ * on the calling thread or, in submission order, on the connector's worker
+ * thread.
+ * */
+class JackConnector {
+   public:
+    typedef std::function<void(const JackConnectionResult& result)> ResultCallback;
+
+   private:
+    struct Job {
+        JackConnectionPlan plan;
+        ResultCallback callback;
+        std::promise<std::vector<JackConnectionResult>> promise;
+    };
+    JackClient* client;
+    std::mutex jobsMutex;
+    std::condition_variable jobsWakeup;
+    std::deque<Job> jobs;
+    bool running = false;
+    std::thread worker;
+
+    std::vector<JackConnectionResult> resolve(const JackConnectionPlan& plan);
+    void execute(std::vector<JackConnectionResult>& changes, const ResultCallback& callback);
+    void run();
+
+   public:
+    explicit JackConnector(JackClient* client);
+    ~JackConnector();
+    /** Resolves the plan and returns what apply() would do, without changing anything. */
+    std::vector<JackConnectionResult> preview(const JackConnectionPlan& plan);
+    /** Applies the plan on the calling thread; callback is invoked after each change. */
+    std::vector<JackConnectionResult> apply(const JackConnectionPlan& plan,
+                                            ResultCallback callback = nullptr);
+    /**
+     * Applies the plan on the worker thread once the plans submitted before
+     * it are done. The plan is resolved when its turn comes.
+     * */
+    std::future<std::vector<JackConnectionResult>> applyAsync(const JackConnectionPlan& plan,
+                                                              ResultCallback callback = nullptr);
+};
+#endif
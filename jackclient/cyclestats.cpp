@@ -0,0 +1,193 @@
+#include "cyclestats.h"
+
+#include <math.h>
+
+#include <algorithm>
+#include <iomanip>
+
+JackTimeHistogram::JackTimeHistogram() { this->reset(); }
+
+void JackTimeHistogram::record(float micros) {
+    uint32_t bin = 0;
+    if (micros > 1.0f) {
+        bin = (uint32_t)ceilf(log2f(micros) * 4.0f);
+        if (bin >= BINS) bin = BINS - 1;
+    }
+    this->counts[bin].fetch_add(1, std::memory_order_relaxed);
+}
+
+float JackTimeHistogram::getBinLimit(uint32_t bin) { return exp2f(bin / 4.0f); }
+
+std::vector<uint64_t> JackTimeHistogram::getCounts() const {
+    std::vector<uint64_t> result(BINS);
+    for (uint32_t i = 0; i < BINS; i++) result[i] = this->counts[i].load(std::memory_order_relaxed);
+    return result;
+}
+
+float JackTimeHistogram::getPercentile(double percentile) const {
+    std::vector<uint64_t> snapshot = this->getCounts();
+    uint64_t total = 0;
+    for (uint64_t count : snapshot) total += count;
+    if (total == 0) return 0.0f;
+    double target = percentile / 100.0 * total;
+    double seen = 0;
+    for (uint32_t i = 0; i < BINS; i++) {
+        if (snapshot[i] == 0) continue;
+        if (seen + snapshot[i] >= target) {
+            float lower = i ? getBinLimit(i - 1) : 0.0f;
+            float upper = getBinLimit(i);
+            return lower + (upper - lower) * (float)((target - seen) / snapshot[i]);
+        }
+        seen += snapshot[i];
+    }
+    return getBinLimit(BINS - 1);
+}
+
+void JackTimeHistogram::reset() {
+    for (uint32_t i = 0; i < BINS; i++) this->counts[i].store(0, std::memory_order_relaxed);
+}
+
+JackCycleStats::JackCycleStats(size_t historySize)
+    : history(new JackSeqLock<JackCycleRecord>[historySize ? historySize : 1]),
+      historySize(historySize ? historySize : 1) {
+    this->reset();
+}
+
+JackCycleStats::~JackCycleStats() { this->stopDump(); }
+
+void JackCycleStats::record(const JackCycleRecord& record) {
+    uint64_t index = this->recorded.load(std::memory_order_relaxed);
+    this->history[index % this->historySize].store(record);
+    this->recorded.store(index + 1, std::memory_order_release);
+
+    this->durations.record(record.durationMicros);
+    this->wakeups.record(record.wakeupMicros);
+    if (record.headroomMicros < 0.0f)
+        this->lateCycles.store(this->lateCycles.load(std::memory_order_relaxed) + 1,
+                               std::memory_order_relaxed);
+    if (record.durationMicros > this->maxDuration.load(std::memory_order_relaxed))
+        this->maxDuration.store(record.durationMicros, std::memory_order_relaxed);
+    float load = record.periodMicros > 0.0f ? record.durationMicros / record.periodMicros : 0.0f;
+    if (load > this->maxLoad.load(std::memory_order_relaxed))
+        this->maxLoad.store(load, std::memory_order_relaxed);
+    this->totalLoad.store(this->totalLoad.load(std::memory_order_relaxed) + load,
+                          std::memory_order_relaxed);
+}
+
+uint64_t JackCycleStats::getCycleCount() const {
+    return this->recorded.load(std::memory_order_acquire);
+}
+
+uint64_t JackCycleStats::getLateCycleCount() const {
+    return this->lateCycles.load(std::memory_order_relaxed);
+}
+
+uint64_t JackCycleStats::getXRunCount() const { return this->xruns.load(std::memory_order_relaxed); }
+
+float JackCycleStats::getMaxDuration() const {
+    return this->maxDuration.load(std::memory_order_relaxed);
+}
+
+float JackCycleStats::getMaxLoad() const { return this->maxLoad.load(std::memory_order_relaxed); }
+
+float JackCycleStats::getAverageLoad() const {
+    uint64_t cycles = this->getCycleCount();
+    if (cycles == 0) return 0.0f;
+    return (float)(this->totalLoad.load(std::memory_order_relaxed) / cycles);
+}
+
+float JackCycleStats::getDurationPercentile(double percentile) const {
+    float value = this->durations.getPercentile(percentile);
+    float max = this->getMaxDuration();
+    return value < max ? value : max;
+}
+
+float JackCycleStats::getWakeupPercentile(double percentile) const {
+    return this->wakeups.getPercentile(percentile);
+}
+
+std::vector<JackCycleRecord> JackCycleStats::getRecentCycles(size_t count) const {
+    std::vector<JackCycleRecord> result;
+    uint64_t end = this->getCycleCount();
+    if (count > this->historySize) count = this->historySize;
+    if (count > end) count = end;
+    result.reserve(count);
+    for (uint64_t i = end - count; i < end; i++)
+        result.push_back(this->history[i % this->historySize].load());
+    // The process thread may reuse the oldest slots for newer cycles while they are copied.
+    std::sort(result.begin(), result.end(),
+              [](const JackCycleRecord& a, const JackCycleRecord& b) { return a.cycle < b.cycle; });
+    return result;
+}
+
+JackXRunReport JackCycleStats::captureXRun(float serverLoad) {
+    JackXRunReport report;
+    report.cycles = this->getRecentCycles(this->historySize);
+    report.cycle = report.cycles.empty() ? 0 : report.cycles.back().cycle;
+    report.serverLoad = serverLoad;
+    report.clientLate = false;
+    report.maxDurationMicros = 0.0f;
+    report.maxWakeupMicros = 0.0f;
+    for (const JackCycleRecord& record : report.cycles) {
+        if (record.headroomMicros < 0.0f) report.clientLate = true;
+        if (record.durationMicros > report.maxDurationMicros)
+            report.maxDurationMicros = record.durationMicros;
+        if (record.wakeupMicros > report.maxWakeupMicros)
+            report.maxWakeupMicros = record.wakeupMicros;
+    }
+    this->xruns.fetch_add(1, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(this->reportsMutex);
+    if (this->reports.size() == this->maxReports) this->reports.erase(this->reports.begin());
+    this->reports.push_back(report);
+    return report;
+}
+
+std::vector<JackXRunReport> JackCycleStats::getXRunReports() {
+    std::lock_guard<std::mutex> lock(this->reportsMutex);
+    return this->reports;
+}
+
+void JackCycleStats::reset() {
+    this->recorded.store(0, std::memory_order_relaxed);
+    this->lateCycles.store(0, std::memory_order_relaxed);
+    this->xruns.store(0, std::memory_order_relaxed);
+    this->maxDuration.store(0.0f, std::memory_order_relaxed);
+    this->maxLoad.store(0.0f, std::memory_order_relaxed);
+    this->totalLoad.store(0.0, std::memory_order_relaxed);
+    this->durations.reset();
+    this->wakeups.reset();
+    std::lock_guard<std::mutex> lock(this->reportsMutex);
+    this->reports.clear();
+}
+
+void JackCycleStats::dump(std::ostream& out) const {
+    out << std::fixed << std::setprecision(1) << "cycles=" << this->getCycleCount()
+        << " late=" << this->getLateCycleCount() << " xruns=" << this->getXRunCount()
+        << " load_avg=" << this->getAverageLoad() * 100.0f
+        << "% load_max=" << this->getMaxLoad() * 100.0f
+        << "% duration_us p50=" << this->getDurationPercentile(50)
+        << " p99=" << this->getDurationPercentile(99)
+        << " p99.9=" << this->getDurationPercentile(99.9)
+        << " max=" << this->getMaxDuration()
+        << " wakeup_us p50=" << this->getWakeupPercentile(50)
+        << " p99=" << this->getWakeupPercentile(99) << std::endl;
+}
+
+void JackCycleStats::startDump(std::ostream& out, std::chrono::milliseconds interval) {
+    this->stopDump();
+    this->dumping = true;
+    this->dumpThread = std::thread([this, &out, interval]() {
+        std::unique_lock<std::mutex> lock(this->dumpMutex);
+        while (!this->dumpWakeup.wait_for(lock, interval, [this]() { return !this->dumping; }))
+            this->dump(out);
+    });
+}
+
+void JackCycleStats::stopDump() {
+    {
+        std::lock_guard<std::mutex> lock(this->dumpMutex);
+        this->dumping = false;
+    }
+    this->dumpWakeup.notify_all();
+    if (this->dumpThread.joinable()) this->dumpThread.join();
+}
@@ -0,0 +1,116 @@
+#ifndef _JACKCLIENT_CYCLESTATS_H
+#define _JACKCLIENT_CYCLESTATS_H
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+#include "seqlock.h"
+
+/** Timing of one process cycle. All times in microseconds. */
+struct JackCycleRecord {
+    uint64_t cycle;
+    uint32_t nframes;
+    /** Frames elapsed since the cycle started when the callback was entered. */
+    uint32_t wakeupFrames;
+    float wakeupMicros;
+    float durationMicros;
+    float periodMicros;
+    /** Period left after wakeup and callback; negative when the cycle was late. */
+    float headroomMicros;
+};
+
+/** Cycles leading up to an xrun, captured from the notification thread. */
+struct JackXRunReport {
+    uint64_t cycle;
+    /** DSP load of the whole server in percent as reported by JACK. */
+    float serverLoad;
+    /** True if one of the captured cycles overran its period in this client. */
+    bool clientLate;
+    float maxDurationMicros;
+    float maxWakeupMicros;
+    std::vector<JackCycleRecord> cycles;
+};
+
+/**
+ * Log-scale histogram with quarter-octave bins from 1us to 65ms. Recording
+ * is wait-free; readers may see counts from slightly different cycles.
+ * */
+class JackTimeHistogram {
+   public:
+    static const uint32_t BINS = 64;
+
+   private:
+    std::atomic<uint64_t> counts[BINS];
+
+   public:
+    JackTimeHistogram();
+    void record(float micros);
+    /** Upper bound of a bin in microseconds. */
+    static float getBinLimit(uint32_t bin);
+    std::vector<uint64_t> getCounts() const;
+    /** Approximate percentile (0-100) in microseconds, interpolated within the bin. */
+    float getPercentile(double percentile) const;
+    void reset();
+};
+
+/**
+ * Per-cycle instrumentation of a JackClient's process callback. The
+ * process thread records each cycle without locks; all getters are meant
+ * for other threads.
+ * */
+class JackCycleStats {
+   private:
+    std::unique_ptr<JackSeqLock<JackCycleRecord>[]> history;
+    size_t historySize;
+    std::atomic<uint64_t> recorded;
+    std::atomic<uint64_t> lateCycles;
+    std::atomic<uint64_t> xruns;
+    std::atomic<float> maxDuration;
+    std::atomic<float> maxLoad;
+    std::atomic<double> totalLoad;
+    JackTimeHistogram durations;
+    JackTimeHistogram wakeups;
+    std::mutex reportsMutex;
+    std::vector<JackXRunReport> reports;
+    size_t maxReports = 16;
+
+    std::thread dumpThread;
+    std::mutex dumpMutex;
+    std::condition_variable dumpWakeup;
+    bool dumping = false;
+
+   public:
+    explicit JackCycleStats(size_t historySize = 64);
+    ~JackCycleStats();
+    /** Process thread only. */
+    void record(const JackCycleRecord& record);
+
+    uint64_t getCycleCount() const;
+    uint64_t getLateCycleCount() const;
+    uint64_t getXRunCount() const;
+    float getMaxDuration() const;
+    /** Callback duration relative to the period, 1.0 being the whole period. */
+    float getMaxLoad() const;
+    float getAverageLoad() const;
+    const JackTimeHistogram& getDurationHistogram() const { return durations; };
+    const JackTimeHistogram& getWakeupHistogram() const { return wakeups; };
+    float getDurationPercentile(double percentile) const;
+    float getWakeupPercentile(double percentile) const;
+    /** The most recent cycles, oldest first. */
+    std::vector<JackCycleRecord> getRecentCycles(size_t count) const;
+
+    JackXRunReport captureXRun(float serverLoad);
+    std::vector<JackXRunReport> getXRunReports();
+    void reset();
+
+    void dump(std::ostream& out) const;
+    /** Dumps a summary line to out every interval from a background thread. */
+    void startDump(std::ostream& out, std::chrono::milliseconds interval);
+    void stopDump();
+};
+#endif
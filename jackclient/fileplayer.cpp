@@ -0,0 +1,235 @@
+#include "fileplayer.h"
+
+#include <errno.h>
+#include <time.h>
+
+#include <algorithm>
+
+#include "audiokernels.h"
+
+JackFilePlayer::JackFilePlayer(JackClient* client, uint32_t readAheadFrames, uint32_t cacheFrames)
+    : client(client),
+      readAheadFrames(readAheadFrames),
+      cacheFrames(cacheFrames),
+      running(false),
+      followTransport(true),
+      playing(false),
+      seekTarget(NO_SEEK) {
+    // A quarter of the ring per step keeps every ring topped up while others are served.
+    this->chunkFrames = std::max(std::min(readAheadFrames / 4, 8192u), 1u);
+    sem_init(&this->wakeup, 0, 0);
+}
+
+JackFilePlayer::~JackFilePlayer() {
+    if (this->started) {
+        this->running.store(false);
+        sem_post(&this->wakeup);
+        this->prefetcher.join();
+    }
+    sem_destroy(&this->wakeup);
+}
+
+size_t JackFilePlayer::addStream(const std::string& path,
+                                 std::vector<JackAudioOutputPort*> outputs) {
+    if (this->started) throw JackClientException("Cannot add streams to a started file player");
+    std::unique_ptr<Stream> stream(new Stream());
+    stream->reader.reset(new JackWavReader(path, this->chunkFrames));
+    stream->outputs = std::move(outputs);
+    stream->buffers.resize(stream->outputs.size());
+    stream->channels = stream->reader->getChannelCount();
+    stream->frames = stream->reader->getFrameCount();
+    stream->cacheFrames = (uint32_t)std::min((uint64_t)this->cacheFrames, stream->frames);
+    stream->cache.resize((size_t)stream->cacheFrames * stream->channels);
+    stream->planar.resize(stream->channels);
+    for (uint32_t c = 0; c < stream->channels; c++)
+        stream->planar[c] = stream->cache.data() + (size_t)c * stream->cacheFrames;
+    stream->reader->read(0, stream->planar.data(), stream->cacheFrames);
+    stream->ring.reset(new JackAudioRingBuffer(stream->channels, this->readAheadFrames));
+    stream->requestFrame.store(stream->cacheFrames);
+    stream->requestGeneration.store(0);
+    stream->ackGeneration.store(0);
+    stream->staleFrames.store(0);
+    stream->underruns.store(0);
+    stream->fileFrame = stream->cacheFrames;
+    stream->fillFrom = stream->cacheFrames;
+    stream->ringFrame = stream->cacheFrames;
+    stream->synced = true;
+    this->streams.push_back(std::move(stream));
+    return this->streams.size() - 1;
+}
+
+void JackFilePlayer::start() {
+    if (this->started) return;
+    this->started = true;
+    this->running.store(true);
+    this->prefetcher = std::thread(&JackFilePlayer::prefetchMain, this);
+}
+
+void JackFilePlayer::prefetchMain() {
+    while (this->running.load(std::memory_order_acquire)) {
+        // One chunk per stream and round, so a long refill cannot starve the others.
+        bool busy = false;
+        for (auto& stream : this->streams) busy |= this->prefetch(*stream);
+        if (busy) continue;
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += 20 * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+        while (sem_timedwait(&this->wakeup, &deadline) != 0 && errno == EINTR) {
+        }
+    }
+}
+
+bool JackFilePlayer::prefetch(Stream& stream) {
+    uint32_t generation = stream.requestGeneration.load(std::memory_order_acquire);
+    if (generation != stream.seenGeneration) {
+        stream.fileFrame = stream.requestFrame.load(std::memory_order_relaxed);
+        stream.seenGeneration = generation;
+        // Everything written so far belongs to the old position.
+        stream.staleFrames.store(stream.produced, std::memory_order_relaxed);
+        stream.ackGeneration.store(generation, std::memory_order_release);
+    }
+    if (stream.fileFrame >= stream.frames) return false;
+    uint64_t left = stream.frames - stream.fileFrame;
+    uint32_t chunk = (uint32_t)std::min((uint64_t)this->chunkFrames, left);
+    if (stream.ring->getWriteSpace() < chunk) return false;
+
+    JackRingBufferState::Vector vec = stream.ring->getWriteVector();
+    uint32_t written = 0;
+    for (const JackRingBufferState::Segment& segment : {vec.first, vec.second}) {
+        uint32_t count = (uint32_t)std::min((size_t)(chunk - written), segment.size);
+        if (!count) break;
+        for (uint32_t c = 0; c < stream.channels; c++)
+            stream.planar[c] = stream.ring->getChannelData(c) + segment.offset;
+        written += stream.reader->read(stream.fileFrame + written, stream.planar.data(), count);
+    }
+    stream.ring->commitWrite(written);
+    stream.produced += written;
+    stream.fileFrame += written;
+    stream.reader->willNeed(stream.fileFrame, this->chunkFrames);
+    return true;
+}
+
+void JackFilePlayer::seekStream(Stream& stream, uint64_t frame) {
+    stream.position = frame;
+    // Frames inside the cache come from memory; the ring picks up where the cache ends.
+    stream.fillFrom = std::max(frame, (uint64_t)stream.cacheFrames);
+    stream.synced = false;
+    stream.requestFrame.store(stream.fillFrom, std::memory_order_relaxed);
+    stream.requestGeneration.store(++stream.generation, std::memory_order_release);
+    sem_post(&this->wakeup);
+}
+
+bool JackFilePlayer::acknowledge(Stream& stream) {
+    if (stream.synced) return true;
+    if (stream.ackGeneration.load(std::memory_order_acquire) != stream.generation) return false;
+    // The stale frames were published before the acknowledgement, so they are readable.
+    uint64_t stale = stream.staleFrames.load(std::memory_order_relaxed);
+    stream.ring->commitRead(stale - stream.consumed);
+    stream.consumed = stale;
+    stream.ringFrame = stream.fillFrom;
+    stream.synced = true;
+    return true;
+}
+
+bool JackFilePlayer::isReady(Stream& stream) {
+    bool acknowledged = this->acknowledge(stream);
+    if (stream.position < stream.cacheFrames || stream.position >= stream.frames) return true;
+    if (!acknowledged) return false;
+    uint64_t needed = std::min((uint64_t)this->chunkFrames, stream.frames - stream.position);
+    return stream.ringFrame + stream.ring->getReadSpace() >= stream.position + needed;
+}
+
+void JackFilePlayer::render(Stream& stream, const JackPortBuffers& buffers, uint32_t nframes,
+                            bool rolling) {
+    size_t outputs = stream.outputs.size();
+    uint32_t channels = (uint32_t)std::min((size_t)stream.channels, outputs);
+    float** out = stream.buffers.data();
+    for (size_t c = 0; c < outputs; c++) {
+        out[c] = buffers.getBuffer(*stream.outputs[c]);
+        if (c >= channels || !rolling) AudioKernels::clear(out[c], nframes);
+    }
+    // Drop stale frames early, also while the cache plays, to make room for the refill.
+    this->acknowledge(stream);
+    if (!rolling) return;
+
+    uint32_t done = 0;
+    while (done < nframes) {
+        uint32_t want = nframes - done;
+        if (stream.position < stream.cacheFrames) {
+            uint64_t cached = stream.cacheFrames - stream.position;
+            uint32_t count = (uint32_t)std::min((uint64_t)want, cached);
+            const float* cache = stream.cache.data() + stream.position;
+            for (uint32_t c = 0; c < channels; c++)
+                AudioKernels::copy(out[c] + done, cache + (size_t)c * stream.cacheFrames, count);
+            stream.position += count;
+            done += count;
+            continue;
+        }
+        if (stream.position >= stream.frames || !this->acknowledge(stream)) break;
+        // Skip what the ring holds before the position, e.g. after waiting for a seek.
+        size_t readable = stream.ring->getReadSpace();
+        if (stream.ringFrame < stream.position) {
+            size_t skip = (size_t)std::min((uint64_t)readable, stream.position - stream.ringFrame);
+            stream.ring->commitRead(skip);
+            stream.consumed += skip;
+            stream.ringFrame += skip;
+            readable -= skip;
+        }
+        uint32_t count = (uint32_t)std::min((size_t)want, readable);
+        if (!count || stream.ringFrame != stream.position) break;
+        JackRingBufferState::Vector vec = stream.ring->getReadVector();
+        uint32_t copied = 0;
+        for (const JackRingBufferState::Segment& segment : {vec.first, vec.second}) {
+            uint32_t part = (uint32_t)std::min((size_t)(count - copied), segment.size);
+            for (uint32_t c = 0; c < channels; c++)
+                AudioKernels::copy(out[c] + done + copied,
+                                   stream.ring->getChannelData(c) + segment.offset, part);
+            copied += part;
+        }
+        stream.ring->commitRead(count);
+        stream.consumed += count;
+        stream.ringFrame += count;
+        stream.position += count;
+        done += count;
+    }
+    if (done < nframes) {
+        for (uint32_t c = 0; c < channels; c++) AudioKernels::clear(out[c] + done, nframes - done);
+        if (stream.position < stream.frames)
+            stream.underruns.fetch_add(1, std::memory_order_relaxed);
+        // The playhead moves on regardless; the ring catches up by skipping.
+        stream.position += nframes - done;
+    }
+    if (stream.ring->getReadSpace() < stream.ring->getCapacity() / 2) sem_post(&this->wakeup);
+}
+
+void JackFilePlayer::process(const JackPortBuffers& buffers, uint32_t nframes) {
+    uint64_t frame;
+    bool rolling;
+    if (this->followTransport.load(std::memory_order_relaxed)) {
+        Transport::JackPosition pos;
+        rolling = this->client->getTransportPosition(pos) == Transport::JackTransportState::ROLLING;
+        frame = pos.frame;
+    } else {
+        uint64_t target = this->seekTarget.exchange(NO_SEEK, std::memory_order_relaxed);
+        frame = target != NO_SEEK ? target : this->playhead;
+        rolling = this->playing.load(std::memory_order_relaxed);
+    }
+    for (auto& stream : this->streams) {
+        if (stream->position != frame) this->seekStream(*stream, frame);
+        this->render(*stream, buffers, nframes, rolling);
+    }
+    this->playhead = rolling ? frame + nframes : frame;
+}
+
+bool JackFilePlayer::sync(Transport::JackTransportState state, Transport::JackPosition* pos) {
+    bool ready = true;
+    for (auto& stream : this->streams) {
+        if (stream->position != pos->frame) this->seekStream(*stream, pos->frame);
+        ready &= this->isReady(*stream);
+    }
+    return ready;
+}
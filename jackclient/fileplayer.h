@@ -0,0 +1,114 @@
+#ifndef _JACKCLIENT_FILEPLAYER_H
+#define _JACKCLIENT_FILEPLAYER_H
+#include <semaphore.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "jackclient.h"
+#include "ringbuffer.h"
+#include "wavfile.h"
+
+/**
+ * Streams WAV/RF64 files to audio output ports. Every stream maps its file
+ * and is fed by a single prefetch thread, which runs without real-time
+ * priority and converts fixed-size chunks into a lock-free ring buffer
+ * holding the configured read-ahead. The first cacheFrames of every file
+ * are preloaded, so playback from the start, or a seek into that range,
+ * is served at once while the ring is refilled behind it. Memory is bounded
+ * by the cache and the ring of each stream.
+ *
+ * By default the player follows the JACK transport: call process() from
+ * onProcess and sync() from onTransportSync, so that a relocate holds the
+ * transport until every stream has data at the new position. Otherwise it
+ * runs on its own through play(), stop() and seek(). The files are not
+ * resampled.
+ * */
+class JackFilePlayer {
+   private:
+    struct Stream {
+        std::unique_ptr<JackWavReader> reader;
+        std::vector<JackAudioOutputPort*> outputs;
+        std::vector<float*> buffers;
+        std::vector<float*> planar;
+        uint32_t channels;
+        uint64_t frames;
+        uint32_t cacheFrames;
+        std::vector<float> cache;
+        std::unique_ptr<JackAudioRingBuffer> ring;
+        std::atomic<uint64_t> requestFrame;
+        std::atomic<uint32_t> requestGeneration;
+        std::atomic<uint32_t> ackGeneration;
+        std::atomic<uint64_t> staleFrames;
+        std::atomic<uint64_t> underruns;
+        // Prefetch thread only.
+        uint32_t seenGeneration = 0;
+        uint64_t fileFrame = 0;
+        uint64_t produced = 0;
+        // Process thread only.
+        uint32_t generation = 0;
+        uint64_t position = 0;
+        uint64_t fillFrom = 0;
+        uint64_t ringFrame = 0;
+        uint64_t consumed = 0;
+        bool synced = false;
+    };
+    static const uint64_t NO_SEEK = ~0ull;
+
+    JackClient* client;
+    uint32_t readAheadFrames;
+    uint32_t cacheFrames;
+    uint32_t chunkFrames;
+    std::vector<std::unique_ptr<Stream>> streams;
+    bool started = false;
+    std::thread prefetcher;
+    std::atomic<bool> running;
+    sem_t wakeup;
+    std::atomic<bool> followTransport;
+    std::atomic<bool> playing;
+    std::atomic<uint64_t> seekTarget;
+    uint64_t playhead = 0;
+
+    void prefetchMain();
+    bool prefetch(Stream& stream);
+    void seekStream(Stream& stream, uint64_t frame);
+    bool acknowledge(Stream& stream);
+    bool isReady(Stream& stream);
+    void render(Stream& stream, const JackPortBuffers& buffers, uint32_t nframes, bool rolling);
+
+   public:
+    /** readAheadFrames: ring size per stream. cacheFrames: frames preloaded from each file. */
+    JackFilePlayer(JackClient* client, uint32_t readAheadFrames = 1 << 17,
+                   uint32_t cacheFrames = 1 << 14);
+    ~JackFilePlayer();
+    /**
+     * Opens a file for playback on the given ports, one per file channel;
+     * missing ports drop channels and extra ports get silence. Returns the
+     * stream index. Not allowed after start().
+     * */
+    size_t addStream(const std::string& path, std::vector<JackAudioOutputPort*> outputs);
+    /** Starts the prefetch thread; no streams can be added afterwards. */
+    void start();
+    /** Writes this cycle's audio of every stream. Call from onProcess. */
+    void process(const JackPortBuffers& buffers, uint32_t nframes);
+    /** Call from onTransportSync; false until every stream can play from pos. */
+    bool sync(Transport::JackTransportState state, Transport::JackPosition* pos);
+
+    /** Follow the JACK transport (default) or run on play(), stop() and seek(). */
+    void setFollowTransport(bool follow) { followTransport.store(follow); };
+    void play() { playing.store(true); };
+    void stop() { playing.store(false); };
+    /** Moves the free-running playhead; applied at the start of the next cycle. */
+    void seek(uint64_t frame) { seekTarget.store(frame); };
+
+    size_t getStreamCount() const { return streams.size(); };
+    uint64_t getFrameCount(size_t stream) const { return streams[stream]->frames; };
+    /** Cycles in which a stream had to output silence for want of data. */
+    uint64_t getUnderrunCount(size_t stream) const {
+        return streams[stream]->underruns.load(std::memory_order_relaxed);
+    };
+};
+#endif
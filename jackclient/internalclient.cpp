@@ -0,0 +1,47 @@
+#include "internalclient.h"
+
+#include <cstdlib>
+
+int JackInternalClient::start(JackClient* client, jack_client_t* handle) {
+    // A constructor that never called open() leaves the handle unclaimed.
+    if (client->getHandle() != handle) {
+        adopt(NULL);
+        delete client;
+        return 1;
+    }
+    try {
+        if (client->getState() != JackState::ACTIVE) client->activate();
+    } catch (...) {
+        delete client;
+        return 1;
+    }
+    return 0;
+}
+
+void JackInternalClient::finish(void* arg) { delete static_cast<JackClient*>(arg); }
+
+JackInternalClient::JackInternalClient(JackClient* controller, const std::string& name,
+                                       const std::string& objectPath,
+                                       const std::string& loadInit)
+    : controller(controller), name(name) {
+    if (controller->getState() == JackState::CLOSED)
+        throw JackClientException("cannot load internal client when client is not opened");
+    jack_status_t status;
+    this->id = jack_internal_client_load(controller->getHandle(), name.c_str(),
+                                         (jack_options_t)(JackLoadName | JackLoadInit), &status,
+                                         objectPath.c_str(), loadInit.c_str());
+    if (this->id == 0 || (status & JackFailure))
+        throw JackClientException("Could not load internal client " + objectPath);
+    if (char* actual = jack_get_internal_client_name(controller->getHandle(), this->id)) {
+        this->name = actual;
+        free(actual);
+    }
+}
+
+JackInternalClient::~JackInternalClient() { this->unload(); }
+
+void JackInternalClient::unload() {
+    if (!this->id) return;
+    jack_internal_client_unload(this->controller->getHandle(), this->id);
+    this->id = 0;
+}
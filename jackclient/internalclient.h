@@ -0,0 +1,83 @@
+#ifndef _JACKCLIENT_INTERNALCLIENT_H
+#define _JACKCLIENT_INTERNALCLIENT_H
+#include <jack/intclient.h>
+
+#include <string>
+#include <type_traits>
+
+#include "jackclient.h"
+
+/**
+ * Runs a JackClient subclass inside the JACK server, so the server calls
+ * its process callback directly instead of waking another process every
+ * period. The same class works in both modes: its constructor calls open()
+ * as usual, which takes over the handle passed to jack_initialize instead
+ * of connecting. Build the class into a shared object containing
+ *
+ *     JACKCLIENT_INTERNAL_CLIENT(MyClient)
+ *
+ * and load it with a JackInternalClient from any client, or with
+ * jack_load. MyClient is constructed from the load_init string if it has
+ * such a constructor and default-constructed otherwise; it is activated if
+ * the constructor did not do so and deleted by jack_finish.
+ *
+ * A crash in an internal client takes down the server; develop in external
+ * mode.
+ * */
+class JackInternalClient {
+   private:
+    JackClient* controller;
+    jack_intclient_t id = 0;
+    std::string name;
+
+    template <typename T>
+    static T* construct(const char* loadInit, std::true_type) {
+        return new T(loadInit);
+    };
+    template <typename T>
+    static T* construct(const char* loadInit, std::false_type) {
+        return new T();
+    };
+    static void adopt(jack_client_t* handle) { JackClient::internalHandle = handle; };
+    static int start(JackClient* client, jack_client_t* handle);
+
+   public:
+    /**
+     * Loads objectPath into the server as a client called name, through the
+     * controller's connection. Throws if the server cannot load it.
+     * */
+    JackInternalClient(JackClient* controller, const std::string& name,
+                       const std::string& objectPath, const std::string& loadInit = "");
+    ~JackInternalClient();
+    JackInternalClient(const JackInternalClient&) = delete;
+    JackInternalClient& operator=(const JackInternalClient&) = delete;
+    /** Asks the server to call jack_finish and close the client. */
+    void unload();
+    bool isLoaded() const { return id != 0; };
+    /** Name the server gave the client; differs from the requested one if that was taken. */
+    const std::string& getName() const { return name; };
+
+    /** Body of jack_initialize for T; exceptions are reported as a failed load. */
+    template <typename T>
+    static int initialize(jack_client_t* handle, const char* loadInit) {
+        JackClient* client = nullptr;
+        try {
+            adopt(handle);
+            client = construct<T>(loadInit ? loadInit : "",
+                                  std::is_constructible<T, const char*>());
+        } catch (...) {
+            adopt(NULL);
+            return 1;
+        }
+        return start(client, handle);
+    };
+    /** Body of jack_finish; arg is the process callback argument, i.e. the client. */
+    static void finish(void* arg);
+};
+
+#define JACKCLIENT_INTERNAL_CLIENT(Class)                                            \
+    extern "C" int jack_initialize(jack_client_t* client, const char* load_init) { \
+        return JackInternalClient::initialize<Class>(client, load_init);          \
+    }                                                                              \
+    extern "C" void jack_finish(void* arg) { JackInternalClient::finish(arg); }
+#endif
@@ -1,5 +1,34 @@
 #include "jackclient.h"
-jack_nframes_t JackClient::nframes = 0;
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <thread>
+
+#include "arena.h"
+#include "blockadapter.h"
+#include "commandqueue.h"
+#include "cyclestats.h"
+#include "latency.h"
+#include "meter.h"
+#include "portgraph.h"
+#include "portgroup.h"
+
+constexpr size_t JackCacheAligned::CACHE_LINE_SIZE;
+
+void* JackCacheAligned::operator new(size_t size) {
+    void* ptr;
+    if (posix_memalign(&ptr, CACHE_LINE_SIZE, size)) throw std::bad_alloc();
+    return ptr;
+}
+
+void* JackCacheAligned::operator new[](size_t size) { return JackCacheAligned::operator new(size); }
+// Not inlined, so GCC pairs the calls with operator new instead of seeing free() on its result
+// (-Wmismatched-new-delete).
+__attribute__((noinline)) void JackCacheAligned::operator delete(void* ptr) { free(ptr); }
+void JackCacheAligned::operator delete[](void* ptr) { JackCacheAligned::operator delete(ptr); }
 
 JackPort::JackPort(JackClient* client, jack_port_t* port, JackPortType type)
     : client(client), portType(type) {
@@ -25,7 +54,9 @@ JackPort::JackPort(JackClient* client, const char* name, JackPortType type)
     this->client_handle = client->client;
 }
 
-JackPort::~JackPort() {}
+JackPort::~JackPort() {
+    if (this->bufferIndex >= 0) this->client->unregisterPort(this);
+}
 
 JackInputPort::JackInputPort(JackClient* client, const char* name, JackPortType type)
     : JackPort(client, name, type) {
@@ -35,6 +66,7 @@ JackInputPort::JackInputPort(JackClient* client, const char* name, JackPortType
     else if (type == JackPortType::MIDI)
         this->port = jack_port_register(this->client_handle, name, JACK_DEFAULT_MIDI_TYPE,
                                         JackPortIsInput, 0);
+    if (this->port) client->registerPort(this, false);
 }
 
 JackOutputPort::JackOutputPort(JackClient* client, const char* name, JackPortType type)
@@ -45,6 +77,7 @@ JackOutputPort::JackOutputPort(JackClient* client, const char* name, JackPortTyp
     else if (type == JackPortType::MIDI)
         this->port = jack_port_register(this->client_handle, name, JACK_DEFAULT_MIDI_TYPE,
                                         JackPortIsOutput, 0);
+    if (this->port) client->registerPort(this, type == JackPortType::MIDI);
 }
 
 JackAudioInputPort::JackAudioInputPort(JackClient* client, const char* name)
@@ -60,27 +93,29 @@ JackMIDIOutputPort::JackMIDIOutputPort(JackClient* client, const char* name)
 JackMIDIEvent::JackMIDIEvent(uint32_t time, size_t size, unsigned char* buffer)
     : time(time), size(size), buffer(buffer) {}
 
-uint32_t JackMIDIEvent::getTime() { return this->time; }
-size_t JackMIDIEvent::getSize() { return this->size; }
+uint32_t JackMIDIEvent::getTime() const { return this->time; }
+size_t JackMIDIEvent::getSize() const { return this->size; }
+
+unsigned char* JackMIDIEvent::getMIDIData() const { return this->buffer; }
 
-unsigned char* JackMIDIEvent::getMIDIData() { return this->buffer; }
+JackMIDIEventRange::JackMIDIEventRange(void* buffer)
+    : buffer(buffer), count(buffer ? jack_midi_get_event_count(buffer) : 0) {}
 
-void* JackPort::getBufferInternal() {
-    return jack_port_get_buffer(this->port, JackClient::nframes);
+bool JackPort::isBufferResolved() const {
+    return this->client->buffers.valid && this->bufferIndex >= 0;
 }
 
+void* JackPort::getBufferInternal() { return this->client->buffers.lookup(*this); }
+
 template <typename T>
 std::vector<std::unique_ptr<T>> JackPort::listConnections() {
     std::vector<std::unique_ptr<T>> list;
-    const char** portList = jack_port_get_all_connections(this->client_handle, this->port);
-    if (portList) {
-        unsigned int portNum = 0;
-        while (portList[portNum]) {
-            jack_port_t* _port = jack_port_by_name(this->client_handle, portList[portNum]);
-            list.push_back(std::make_unique<T>(this->client, _port));
-            portNum++;
-        }
-        jack_free(portList);
+    std::shared_ptr<const JackPortGraphSnapshot> graph = this->client->getPortGraph();
+    const JackPortGraphSnapshot::Port* self = graph->find(this->port);
+    if (self) {
+        list.reserve(self->connections.size());
+        for (uint32_t index : self->connections)
+            list.push_back(std::make_unique<T>(this->client, (*graph)[index].handle));
     }
     return list;
 }
@@ -98,7 +133,22 @@ bool JackPort::isMine() {
 
 JackPortType JackPort::getPortType() { return this->portType; }
 
-void JackPort::disconnectAll() { jack_port_disconnect(this->client_handle, this->port); }
+void JackPort::disconnectAll() {
+    if (this->client->graph)
+        this->client->graph->disconnectAll(this->port);
+    else
+        jack_port_disconnect(this->client_handle, this->port);
+}
+
+JackLatencyRange JackPort::getLatencyRange(JackLatencyMode mode) {
+    JackLatencyRange range;
+    jack_port_get_latency_range(this->port, (jack_latency_callback_mode_t)mode, &range);
+    return range;
+}
+
+void JackPort::setLatencyRange(JackLatencyMode mode, JackLatencyRange range) {
+    jack_port_set_latency_range(this->port, (jack_latency_callback_mode_t)mode, &range);
+}
 
 float* JackAudioInputPort::getBuffer() { return (float*)getBufferInternal(); }
 
@@ -109,13 +159,16 @@ void JackOutputPort::connectTo(JackInputPort& inPort) {
         throw JackClientException("Cannot connect ports with different types");
     if (this->client->getState() != JackState::ACTIVE)
         throw JackClientException("Cannot connect ports when client is not active");
-    int err =
-        jack_connect(this->client_handle, jack_port_name(this->port), jack_port_name(inPort.port));
+    int err = this->client->graph->connect(jack_port_name(this->port), jack_port_name(inPort.port));
     if (err != 0 && err != EEXIST) throw JackClientException("Connecting port failed");
 }
 
 void JackOutputPort::disconnect(JackInputPort& inPort) {
-    jack_disconnect(this->client_handle, jack_port_name(this->port), jack_port_name(inPort.port));
+    if (this->client->graph)
+        this->client->graph->disconnect(jack_port_name(this->port), jack_port_name(inPort.port));
+    else
+        jack_disconnect(this->client_handle, jack_port_name(this->port),
+                        jack_port_name(inPort.port));
 }
 
 void JackInputPort::connectTo(JackOutputPort& outPort) {
@@ -124,12 +177,16 @@ void JackInputPort::connectTo(JackOutputPort& outPort) {
     if (this->client->getState() != JackState::ACTIVE)
         throw JackClientException("Cannot connect ports when client is not active");
     int err =
-        jack_connect(this->client_handle, jack_port_name(outPort.port), jack_port_name(this->port));
+        this->client->graph->connect(jack_port_name(outPort.port), jack_port_name(this->port));
     if (err != 0 && err != EEXIST) throw JackClientException("Connecting port failed");
 }
 
 void JackInputPort::disconnect(JackOutputPort& outPort) {
-    jack_disconnect(this->client_handle, jack_port_name(outPort.port), jack_port_name(this->port));
+    if (this->client->graph)
+        this->client->graph->disconnect(jack_port_name(outPort.port), jack_port_name(this->port));
+    else
+        jack_disconnect(this->client_handle, jack_port_name(outPort.port),
+                        jack_port_name(this->port));
 }
 
 std::vector<std::unique_ptr<JackAudioOutputPort>> JackAudioInputPort::getConnections() {
@@ -140,41 +197,289 @@ std::vector<std::unique_ptr<JackAudioInputPort>> JackAudioOutputPort::getConnect
     return this->listConnections<JackAudioInputPort>();
 }
 
+JackMIDIEventRange JackMIDIInputPort::getEvents() {
+    return JackMIDIEventRange(this->getBufferInternal());
+}
+
 std::vector<std::unique_ptr<JackMIDIEvent>> JackMIDIInputPort::getMIDIEvents() {
     std::vector<std::unique_ptr<JackMIDIEvent>> events;
-    void* internalBuf = this->getBufferInternal();
-    uint32_t count = jack_midi_get_event_count(internalBuf);
-
-    for (uint32_t i = 0; i < count; i++) {
-        jack_midi_event_t ev;
-        if (!jack_midi_event_get(&ev, this->getBufferInternal(), i)) {
-            events.push_back(std::make_unique<JackMIDIEvent>(ev.time, ev.size, ev.buffer));
+    JackMIDIEventRange range = this->getEvents();
+    events.reserve(range.size());
+    for (const JackMIDIEvent& ev : range) {
+        if (ev.getMIDIData()) {
+            events.push_back(std::make_unique<JackMIDIEvent>(ev));
         }
     }
     return events;
 }
 
-void JackMIDIOutputPort::clearBuffer() { jack_midi_clear_buffer(getBufferInternal()); }
+void JackMIDIOutputPort::clearBuffer() {
+    // Registered MIDI outputs are cleared at the start of every cycle, before queued
+    // commands are written; clearing again would drop those events.
+    if (this->isBufferResolved()) return;
+    jack_midi_clear_buffer(getBufferInternal());
+}
 
-void JackMIDIOutputPort::writeEvent(JackMIDIEvent& event) {
-    this->write(event.getTime(), event.getMIDIData(), event.getSize());
+bool JackMIDIOutputPort::writeEvent(JackMIDIEvent& event) {
+    return this->write(event.getTime(), event.getMIDIData(), event.getSize());
 }
 
-void JackMIDIOutputPort::write(uint32_t time, unsigned char* buffer, size_t size) {
-    // Exception ? Return ErrorCode ? Do Nothing if it fails?
-    jack_midi_event_write(getBufferInternal(), time, buffer, size);
+bool JackMIDIOutputPort::write(uint32_t time, unsigned char* buffer, size_t size) {
+    return jack_midi_event_write(getBufferInternal(), time, buffer, size) == 0;
 }
 
 JackMIDIInputPort::~JackMIDIInputPort() {}
 
-JackClient::JackClient(const char* name) : name(name) {}
-JackClient::~JackClient() {}
+void* JackPortBuffers::lookup(const JackPort& port) const {
+    if (this->valid && port.bufferIndex >= 0) return this->buffers[port.bufferIndex];
+    return jack_port_get_buffer(port.port, port.client->nframes);
+}
+
+float* JackPortBuffers::getBuffer(const JackAudioInputPort& port) const {
+    return (float*)this->lookup(port);
+}
+
+float* JackPortBuffers::getBuffer(const JackAudioOutputPort& port) const {
+    return (float*)this->lookup(port);
+}
+
+void* JackPortBuffers::getBuffer(const JackMIDIInputPort& port) const { return this->lookup(port); }
+
+void* JackPortBuffers::getBuffer(const JackMIDIOutputPort& port) const {
+    return this->lookup(port);
+}
+
+JackClient::JackClient(const char* name, size_t commandQueueSize)
+    : stats(new JackCycleStats()),
+      arena(new JackArena()),
+      clearList(new std::vector<jack_port_t*>()),
+      clearing(false),
+      commands(new JackCommandQueue(commandQueueSize)),
+      schedule(new JackCommandSchedule(commands->getCapacity())),
+      lateCommands(0),
+      droppedMIDI(0),
+      failedCycles(0),
+      processingLatency(0),
+      adapterLatency(0),
+      tapCycles(0),
+      tapCaptures(0),
+      tapNanos(0),
+      tapMaxNanos(0),
+      name(name) {}
+JackClient::~JackClient() {
+    std::lock_guard<std::mutex> lock(this->portsMutex);
+    for (JackPort* port : this->ports) port->bufferIndex = -1;
+    delete this->clearList.load();
+}
 
 JackState JackClient::getState() { return jackState; }
 
+void JackClient::registerPort(JackPort* port, bool clearEachCycle) {
+    std::lock_guard<std::mutex> lock(this->portsMutex);
+    port->bufferIndex = (int)this->ports.size();
+    this->ports.push_back(port);
+    this->portHandles.push_back(port->port);
+    this->buffers.buffers.push_back(nullptr);
+    // Inactive clients rescan the server for every graph anyway.
+    if (jackState == JackState::ACTIVE && this->graph) this->graph->addOwnPort(port->port);
+    if (clearEachCycle) {
+        this->clearHandles.push_back(port->port);
+        this->publishClearList();
+    }
+}
+
+void JackClient::unregisterPort(JackPort* port) {
+    std::lock_guard<std::mutex> lock(this->portsMutex);
+    size_t index = port->bufferIndex;
+    size_t last = this->ports.size() - 1;
+    if (index != last) {
+        this->ports[index] = this->ports[last];
+        this->portHandles[index] = this->portHandles[last];
+        this->ports[index]->bufferIndex = (int)index;
+    }
+    this->ports.pop_back();
+    this->portHandles.pop_back();
+    this->buffers.buffers.pop_back();
+    port->bufferIndex = -1;
+    auto handle = std::find(this->clearHandles.begin(), this->clearHandles.end(), port->port);
+    if (handle != this->clearHandles.end()) {
+        this->clearHandles.erase(handle);
+        this->publishClearList();
+    }
+}
+
+void JackClient::publishClearList() {
+    std::vector<jack_port_t*>* old =
+        this->clearList.exchange(new std::vector<jack_port_t*>(this->clearHandles));
+    // The process thread raises clearing before it loads the list, so once it is seen low
+    // the old list is no longer in use.
+    while (this->clearing.load()) std::this_thread::yield();
+    delete old;
+}
+
+void JackClient::clearMIDIOutputs(jack_nframes_t nframes) {
+    this->clearing.store(true);
+    for (jack_port_t* handle : *this->clearList.load())
+        jack_midi_clear_buffer(jack_port_get_buffer(handle, nframes));
+    this->clearing.store(false);
+}
+
+void JackClient::resolveBuffers(jack_nframes_t nframes) {
+    void** table = this->buffers.buffers.data();
+    jack_port_t** handles = this->portHandles.data();
+    size_t count = this->portHandles.size();
+    for (size_t i = 0; i < count; i++) table[i] = jack_port_get_buffer(handles[i], nframes);
+}
+
+void JackClient::drainCommands(jack_nframes_t nframes) {
+    jack_nframes_t cycleStart = jack_last_frame_time(this->client);
+    jack_time_t deadline = jack_get_time() + this->commandBudgetMicros;
+    uint32_t count = 0;
+    // Everything queued moves into the schedule, so commands due later wait there without
+    // holding up the ones behind them, and MIDI is written in time order.
+    while (!this->schedule->isFull()) {
+        JackCommand* command = this->commands->front();
+        if (!command) break;
+        this->schedule->push(*command);
+        this->commands->pop();
+    }
+    while (!this->schedule->isEmpty()) {
+        if (count == this->commandBudget) break;
+        if ((count & 15) == 15 && jack_get_time() > deadline) break;
+        JackCommand& command = this->schedule->top();
+        int32_t offset = (int32_t)(command.time - cycleStart);
+        if (offset >= (int32_t)nframes) break;
+        if (offset < 0) {
+            offset = 0;
+            if (command.timed) this->lateCommands.fetch_add(1, std::memory_order_relaxed);
+        }
+        switch (command.type) {
+            case JackCommandType::MIDI:
+                if (!static_cast<JackMIDIOutputPort*>(command.target)
+                         ->write(offset, command.data, command.size))
+                    this->droppedMIDI.fetch_add(1, std::memory_order_relaxed);
+                break;
+            case JackCommandType::PARAMETER:
+                static_cast<JackParameter*>(command.target)->set(command.value);
+                break;
+            case JackCommandType::CALLBACK:
+                command.function(command.target);
+                break;
+        }
+        this->schedule->pop();
+        count++;
+    }
+}
+
+void JackClient::recordCycle(jack_nframes_t nframes, jack_nframes_t wakeup,
+                             std::chrono::steady_clock::time_point start) {
+    std::chrono::duration<float, std::micro> duration = std::chrono::steady_clock::now() - start;
+    float microsPerFrame = this->sampleRate ? 1e6f / this->sampleRate : 0.0f;
+    JackCycleRecord record;
+    record.cycle = this->cycle;
+    record.nframes = nframes;
+    record.wakeupFrames = wakeup;
+    record.wakeupMicros = wakeup * microsPerFrame;
+    record.durationMicros = duration.count();
+    record.periodMicros = nframes * microsPerFrame;
+    record.headroomMicros = record.periodMicros - record.wakeupMicros - record.durationMicros;
+    this->stats->record(record);
+}
+
+JackClient::CycleScope::CycleScope(JackClient& client, jack_nframes_t nframes)
+    : client(client),
+      start(std::chrono::steady_clock::now()),
+      nframes(nframes),
+      wakeup(jack_frames_since_cycle_start(client.client)),
+      // Port (un)registration holds the lock from a non-RT thread; if it is busy this cycle
+      // the ports fall back to looking up their buffers individually and queued commands
+      // wait for the next cycle. MIDI outputs are cleared either way.
+      lock(client.portsMutex, std::try_to_lock) {
+    client.nframes = nframes;
+    client.buffers.nframes = nframes;
+    client.cycle++;
+    client.captureTransport();
+    client.clearMIDIOutputs(nframes);
+    if (this->lock.owns_lock()) {
+        client.resolveBuffers(nframes);
+        client.buffers.valid = true;
+        client.drainCommands(nframes);
+    }
+}
+
+JackClient::CycleScope::~CycleScope() {
+    this->client.captureTaps(this->nframes);
+    this->client.buffers.valid = false;
+    this->client.arena->reset();
+    this->client.recordCycle(this->nframes, this->wakeup, this->start);
+}
+
+// Failure path only; the flags and types are looked up per port.
+static void silencePort(jack_port_t* handle, jack_nframes_t nframes) {
+    if (!(jack_port_flags(handle) & JackPortIsOutput)) return;
+    void* buffer = jack_port_get_buffer(handle, nframes);
+    if (!buffer) return;
+    if (!std::strcmp(jack_port_type(handle), JACK_DEFAULT_MIDI_TYPE))
+        jack_midi_clear_buffer(buffer);
+    else
+        std::memset(buffer, 0, nframes * sizeof(float));
+}
+
+void JackClient::CycleScope::fail(jack_port_t* const* extra, size_t extraCount) {
+    this->client.failedCycles.fetch_add(1, std::memory_order_relaxed);
+    if (this->lock.owns_lock())
+        for (jack_port_t* handle : this->client.portHandles) silencePort(handle, this->nframes);
+    for (size_t i = 0; i < extraCount; i++) silencePort(extra[i], this->nframes);
+}
+
+void JackClient::captureTransport() {
+    // One query per cycle; the process thread reads cyclePosition, other threads the snapshot.
+    Transport::JackPosition& pos = this->cyclePosition;
+    jack_transport_state_t state = jack_transport_query(this->client, &pos);
+    Transport::JackTransportSnapshot snapshot;
+    snapshot.state = static_cast<Transport::JackTransportState>(state);
+    snapshot.cycle = this->cycle;
+    snapshot.frame = pos.frame;
+    snapshot.frameRate = pos.frame_rate;
+    snapshot.hasBBT = (pos.valid & JackPositionBBT) != 0;
+    snapshot.bar = snapshot.hasBBT ? pos.bar : 0;
+    snapshot.beat = snapshot.hasBBT ? pos.beat : 0;
+    snapshot.tick = snapshot.hasBBT ? pos.tick : 0;
+    snapshot.beatsPerBar = snapshot.hasBBT ? pos.beats_per_bar : 0.0f;
+    snapshot.beatType = snapshot.hasBBT ? pos.beat_type : 0.0f;
+    snapshot.ticksPerBeat = snapshot.hasBBT ? pos.ticks_per_beat : 0.0;
+    snapshot.beatsPerMinute = snapshot.hasBBT ? pos.beats_per_minute : 0.0;
+    snapshot.barStartTick = snapshot.hasBBT ? pos.bar_start_tick : 0.0;
+    this->transportSnapshot.store(snapshot);
+}
+
+void JackClient::captureTaps(jack_nframes_t nframes) {
+    // Taps are added and removed from other threads; a busy list skips one cycle of metering.
+    std::unique_lock<std::mutex> lock(this->tapsMutex, std::try_to_lock);
+    if (!lock.owns_lock() || this->taps.empty()) return;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (JackMeterTap* tap : this->taps) tap->capture(nframes);
+    uint64_t nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    this->tapCycles.fetch_add(1, std::memory_order_relaxed);
+    this->tapCaptures.fetch_add(this->taps.size(), std::memory_order_relaxed);
+    this->tapNanos.fetch_add(nanos, std::memory_order_relaxed);
+    if (nanos > this->tapMaxNanos.load(std::memory_order_relaxed))
+        this->tapMaxNanos.store(nanos, std::memory_order_relaxed);
+}
+
 int JackClient::process(jack_nframes_t nframes, void* arg) {
     JackClient* cl = static_cast<JackClient*>(arg);
-    return cl->onProcess(nframes);
+    CycleScope cycle(*cl, nframes);
+    // An exception must not unwind into libjack. Returning an error would make JACK drop the
+    // client, so a cycle that ran out of memory is silenced and the next one starts afresh.
+    try {
+        return cl->onProcess(cl->buffers, nframes);
+    } catch (std::bad_alloc&) {
+        cycle.fail();
+        return 0;
+    }
 }
 
 void JackClient::jack_shutdown(void* arg) {
@@ -183,15 +488,103 @@ void JackClient::jack_shutdown(void* arg) {
 }
 
 int JackClient::buffer_size_callback(jack_nframes_t nframes, void* arg) {
-    JackClient::nframes = nframes;
+    JackClient* cl = static_cast<JackClient*>(arg);
+    cl->bufferSize = nframes;
+    cl->nframes = nframes;
+    // JACK does not run the process callback while the buffer size changes.
+    if (cl->arenaBytesPerFrame)
+        cl->arena->rebuild(cl->arenaBytes + cl->arenaBytesPerFrame * nframes);
+    {
+        std::lock_guard<std::mutex> lock(cl->groupsMutex);
+        for (JackAudioPortGroup* group : cl->groups) group->reserve(nframes);
+    }
+    {
+        std::lock_guard<std::mutex> lock(cl->compensatorsMutex);
+        for (JackLatencyCompensator* compensator : cl->compensators) compensator->reserve(nframes);
+    }
+    std::lock_guard<std::mutex> lock(cl->adaptersMutex);
+    for (JackBlockAdapter* adapter : cl->adapters) adapter->rebuild(nframes);
+    // Server requests from this callback can deadlock, so the updater thread makes it.
+    if (cl->updateAdapterLatency() && cl->graph) cl->graph->requestLatencyRecompute();
+    return 0;
+}
+
+int JackClient::sample_rate_callback(jack_nframes_t nframes, void* arg) {
+    static_cast<JackClient*>(arg)->sampleRate = nframes;
     return 0;
 }
 
 int JackClient::xrun_callback(void* arg) {
-    static_cast<JackClient*>(arg)->onXRun();
+    JackClient* cl = static_cast<JackClient*>(arg);
+    cl->onXRun(cl->captureXRunReport());
     return 0;
 }
 
+void JackClient::latency_callback(jack_latency_callback_mode_t mode, void* arg) {
+    JackClient* cl = static_cast<JackClient*>(arg);
+    cl->updateLatencyCompensation((JackLatencyMode)mode);
+    cl->onLatency((JackLatencyMode)mode);
+}
+
+void JackClient::updateLatencyCompensation(JackLatencyMode mode) {
+    // Capture latencies of our inputs are final once JACK asks for our capture latency.
+    if (mode != JackLatencyMode::CAPTURE) return;
+    std::lock_guard<std::mutex> lock(this->compensatorsMutex);
+    for (JackLatencyCompensator* compensator : this->compensators) compensator->update();
+}
+
+void JackClient::propagateLatency(JackLatencyMode mode) { this->propagateLatency(mode, NULL, 0); }
+
+void JackClient::propagateLatency(JackLatencyMode mode, jack_port_t* const* extra,
+                                  size_t extraCount) {
+    // Capture latency flows from our inputs to our outputs, playback latency the other way.
+    unsigned long from = mode == JackLatencyMode::CAPTURE ? JackPortIsInput : JackPortIsOutput;
+    jack_latency_callback_mode_t jackMode = (jack_latency_callback_mode_t)mode;
+    std::lock_guard<std::mutex> lock(this->portsMutex);
+    jack_port_t* const* lists[2] = {this->portHandles.data(), extra};
+    size_t counts[2] = {this->portHandles.size(), extraCount};
+    JackLatencyRange range = {UINT32_MAX, 0};
+    for (int list = 0; list < 2; list++) {
+        for (size_t i = 0; i < counts[list]; i++) {
+            if (!(jack_port_flags(lists[list][i]) & from)) continue;
+            JackLatencyRange portRange;
+            jack_port_get_latency_range(lists[list][i], jackMode, &portRange);
+            if (portRange.min < range.min) range.min = portRange.min;
+            if (portRange.max > range.max) range.max = portRange.max;
+        }
+    }
+    if (range.min > range.max) range.min = 0;
+    uint32_t added = this->getProcessingLatency();
+    range.min += added;
+    range.max += added;
+    for (int list = 0; list < 2; list++)
+        for (size_t i = 0; i < counts[list]; i++)
+            if (!(jack_port_flags(lists[list][i]) & from))
+                jack_port_set_latency_range(lists[list][i], jackMode, &range);
+}
+
+void JackClient::setProcessingLatency(uint32_t frames) {
+    this->processingLatency.store(frames, std::memory_order_relaxed);
+    this->recomputeLatencies();
+}
+
+bool JackClient::updateAdapterLatency() {
+    uint32_t latency = 0;
+    for (JackBlockAdapter* adapter : this->adapters)
+        if (adapter->isReportingLatency() && adapter->getLatency() > latency)
+            latency = adapter->getLatency();
+    return this->adapterLatency.exchange(latency, std::memory_order_relaxed) != latency;
+}
+
+void JackClient::recomputeLatencies() {
+    if (jackState != JackState::CLOSED && this->client != NULL)
+        jack_recompute_total_latencies(this->client);
+}
+
+JackXRunReport JackClient::captureXRunReport() {
+    return this->stats->captureXRun(jack_cpu_load(this->client));
+}
+
 int JackClient::sync_callback(jack_transport_state_t state, jack_position_t* pos, void* arg) {
     return static_cast<JackClient*>(arg)->onTransportSync(
         static_cast<Transport::JackTransportState>(state),
@@ -206,7 +599,26 @@ void JackClient::timebase_callback(jack_transport_state_t state, jack_nframes_t
 }
 
 void JackClient::open() {
-    this->client = jack_client_open(this->name, JackNoStartServer, &this->status, NULL);
+    this->openConnection();
+    if (this->client == NULL) return;
+    jack_set_process_callback(this->client, &JackClient::process, this);
+    jack_set_xrun_callback(this->client, &JackClient::xrun_callback, this);
+    jack_set_sync_callback(this->client, &JackClient::sync_callback, this);
+    jack_set_latency_callback(this->client, &JackClient::latency_callback, this);
+}
+
+thread_local jack_client_t* JackClient::internalHandle = NULL;
+
+void JackClient::openConnection() {
+    if (internalHandle) {
+        this->client = internalHandle;
+        this->internal = true;
+        this->status = (jack_status_t)0;
+        this->name = jack_get_client_name(this->client);
+        internalHandle = NULL;
+    } else {
+        this->client = jack_client_open(this->name, JackNoStartServer, &this->status, NULL);
+    }
     if (this->client == NULL) {
         if (this->status & JackServerFailed) {
             throw JackClientException("Unable to connect to JACK server");
@@ -214,17 +626,24 @@ void JackClient::open() {
         return;
     }
     if (this->status & JackNameNotUnique) this->name = jack_get_client_name(client);
-    jack_set_process_callback(this->client, &JackClient::process, this);
+    this->bufferSize = jack_get_buffer_size(this->client);
+    this->sampleRate = jack_get_sample_rate(this->client);
+    this->nframes = this->bufferSize;
+    this->arena->rebuild(this->arenaBytes + this->arenaBytesPerFrame * this->bufferSize);
     jack_on_shutdown(this->client, &JackClient::jack_shutdown, this);
     jack_set_buffer_size_callback(this->client, &JackClient::buffer_size_callback, this);
-    jack_set_xrun_callback(this->client, &JackClient::xrun_callback, this);
-    jack_set_sync_callback(this->client, &JackClient::sync_callback, this);
+    jack_set_sample_rate_callback(this->client, &JackClient::sample_rate_callback, this);
+    this->graph.reset(new JackPortGraph(this->client));
     jackState = JackState::INACTIVE;
 }
 
 void JackClient::close() {
     if (jackState != JackState::CLOSED) {
-        if (this->client != NULL) jack_client_close(this->client);
+        // The server closes internal clients itself after jack_finish.
+        if (this->internal && jackState == JackState::ACTIVE) jack_deactivate(this->client);
+        if (this->graph) this->graph->stop();
+        if (this->client != NULL && !this->internal) jack_client_close(this->client);
+        this->graph.reset();
         jackState = JackState::CLOSED;
     }
 }
@@ -233,6 +652,8 @@ void JackClient::activate() {
     if ((jackState == JackState::INACTIVE) && this->client != NULL && jack_activate(this->client)) {
         throw JackClientException("cannot activate client");
     }
+    // Changes made while inactive were not reported through the graph callbacks.
+    if (jackState == JackState::INACTIVE && this->graph) this->graph->refresh();
     jackState = JackState::ACTIVE;
 }
 
@@ -265,6 +686,22 @@ std::unique_ptr<JackMIDIOutputPort> JackClient::createMIDIOutputPort(const char*
     return std::make_unique<JackMIDIOutputPort>(this, name);
 }
 
+std::unique_ptr<JackAudioInputGroup> JackClient::createAudioInputGroup(const char* prefix,
+                                                                       uint32_t channels,
+                                                                       uint32_t maxFrames) {
+    if (jackState == JackState::CLOSED)
+        throw JackClientException("cannot create port when client is not opened");
+    return std::make_unique<JackAudioInputGroup>(this, prefix, channels, maxFrames);
+}
+
+std::unique_ptr<JackAudioOutputGroup> JackClient::createAudioOutputGroup(const char* prefix,
+                                                                         uint32_t channels,
+                                                                         uint32_t maxFrames) {
+    if (jackState == JackState::CLOSED)
+        throw JackClientException("cannot create port when client is not opened");
+    return std::make_unique<JackAudioOutputGroup>(this, prefix, channels, maxFrames);
+}
+
 void JackClient::startFreewheel() {
     if (jack_set_freewheel(this->client, 1))
         throw JackClientException("Error starting freewheel-mode");
@@ -296,21 +733,11 @@ std::vector<std::unique_ptr<JackMIDIOutputPort>> JackClient::getMIDIOutputPorts(
 template <typename T>
 std::vector<std::unique_ptr<T>> JackClient::createPorts(JackPortType type, JackPortFlags flags) {
     std::vector<std::unique_ptr<T>> list;
-    const char** portList;
-
-    if (type == JackPortType::AUDIO) {
-        portList = jack_get_ports(this->client, NULL, JACK_DEFAULT_AUDIO_TYPE, flags);
-    } else {
-        portList = jack_get_ports(this->client, NULL, JACK_DEFAULT_MIDI_TYPE, flags);
-    }
-
-    unsigned int portNum = 0;
-    while (portList[portNum]) {
-        jack_port_t* _port = jack_port_by_name(this->client, portList[portNum]);
-        list.push_back(std::make_unique<T>(this, _port));
-        portNum++;
-    }
-    jack_free(portList);
+    std::shared_ptr<const JackPortGraphSnapshot> graph = this->getPortGraph();
+    const std::vector<uint32_t>& selection = graph->select(type, flags);
+    list.reserve(selection.size());
+    for (uint32_t index : selection)
+        list.push_back(std::make_unique<T>(this, (*graph)[index].handle));
     return list;
 }
 
@@ -353,4 +780,134 @@ Transport::JackTransportState JackClient::getTransportState() {
     return static_cast<Transport::JackTransportState>(jack_transport_query(this->client, NULL));
 }
 
-uint32_t JackClient::getSampleRate() { return jack_get_sample_rate(this->client); }
\ No newline at end of file
+Transport::JackTransportState JackClient::getTransportPosition(Transport::JackPosition& pos) {
+    return static_cast<Transport::JackTransportState>(jack_transport_query(this->client, &pos));
+}
+
+void JackClient::setBufferSize(uint32_t bufSize) {
+    if (jack_set_buffer_size(this->client, bufSize))
+        throw JackClientException("Could not set buffer size");
+}
+
+uint32_t JackClient::getBufferSize() { return this->bufferSize; }
+
+uint32_t JackClient::getSampleRate() { return jack_get_sample_rate(this->client); }
+
+uint32_t JackClient::getFrameTime() { return jack_frame_time(this->client); }
+
+uint32_t JackClient::getCycleStartTime() { return jack_last_frame_time(this->client); }
+
+bool JackClient::pushCommand(const JackCommand& command) { return this->commands->push(command); }
+
+bool JackClient::sendMIDI(JackMIDIOutputPort& port, const unsigned char* data, size_t size) {
+    return this->queueMIDI(port, data, size, this->getFrameTime(), false);
+}
+
+bool JackClient::sendMIDI(JackMIDIOutputPort& port, const unsigned char* data, size_t size,
+                          uint32_t time) {
+    return this->queueMIDI(port, data, size, time, true);
+}
+
+bool JackClient::queueMIDI(JackMIDIOutputPort& port, const unsigned char* data, size_t size,
+                           uint32_t time, bool timed) {
+    if (size > JackCommand::MAX_MIDI_SIZE)
+        throw JackClientException("MIDI message too large for the command queue");
+    JackCommand command;
+    command.type = JackCommandType::MIDI;
+    command.time = time;
+    command.timed = timed;
+    command.target = &port;
+    command.size = (uint8_t)size;
+    std::memcpy(command.data, data, size);
+    return this->pushCommand(command);
+}
+
+bool JackClient::setParameter(JackParameter& parameter, float value) {
+    return this->queueParameter(parameter, value, this->getFrameTime(), false);
+}
+
+bool JackClient::setParameter(JackParameter& parameter, float value, uint32_t time) {
+    return this->queueParameter(parameter, value, time, true);
+}
+
+bool JackClient::queueParameter(JackParameter& parameter, float value, uint32_t time,
+                                bool timed) {
+    JackCommand command;
+    command.type = JackCommandType::PARAMETER;
+    command.time = time;
+    command.timed = timed;
+    command.target = &parameter;
+    command.value = value;
+    return this->pushCommand(command);
+}
+
+bool JackClient::post(void (*function)(void* arg), void* arg) {
+    JackCommand command;
+    command.type = JackCommandType::CALLBACK;
+    command.time = this->getFrameTime();
+    command.timed = false;
+    command.target = arg;
+    command.function = function;
+    return this->pushCommand(command);
+}
+
+void JackClient::setCommandBudget(uint32_t maxCommands, uint32_t maxMicroseconds) {
+    this->commandBudget = maxCommands;
+    this->commandBudgetMicros = maxMicroseconds;
+}
+
+JackCycleStats& JackClient::getCycleStats() { return *this->stats; }
+
+JackArena& JackClient::getArena() { return *this->arena; }
+
+void JackClient::setArenaSize(size_t bytes, size_t bytesPerFrame) {
+    if (jackState == JackState::ACTIVE)
+        throw JackClientException("cannot resize the arena while the client is active");
+    this->arenaBytes = bytes;
+    this->arenaBytesPerFrame = bytesPerFrame;
+    this->arena->rebuild(bytes + bytesPerFrame * this->bufferSize);
+}
+
+std::shared_ptr<const JackPortGraphSnapshot> JackClient::getPortGraph() {
+    if (!this->graph) throw JackClientException("cannot list ports when client is not opened");
+    if (jackState != JackState::ACTIVE) this->graph->refresh();
+    return this->graph->getSnapshot();
+}
+
+uint64_t JackClient::getLateCommandCount() {
+    return this->lateCommands.load(std::memory_order_relaxed);
+}
+
+uint64_t JackClient::getDroppedMIDICount() {
+    return this->droppedMIDI.load(std::memory_order_relaxed);
+}
+
+uint64_t JackClient::getFailedCycleCount() {
+    return this->failedCycles.load(std::memory_order_relaxed);
+}
+
+JackTapCost JackClient::getTapCost() const {
+    JackTapCost cost;
+    cost.cycles = this->tapCycles.load(std::memory_order_relaxed);
+    cost.captures = this->tapCaptures.load(std::memory_order_relaxed);
+    double micros = this->tapNanos.load(std::memory_order_relaxed) / 1000.0;
+    cost.cycleMicros = cost.cycles ? (float)(micros / cost.cycles) : 0.0f;
+    cost.tapMicros = cost.captures ? (float)(micros / cost.captures) : 0.0f;
+    cost.maxCycleMicros = this->tapMaxNanos.load(std::memory_order_relaxed) / 1000.0f;
+    return cost;
+}
+jack_native_thread_t JackClient::createRealtimeThread(void* (*routine)(void* arg), void* arg,
+                                                      int priorityOffset) {
+    if (jackState == JackState::CLOSED)
+        throw JackClientException("cannot create thread when client is not opened");
+    jack_native_thread_t thread;
+    if (jack_client_create_thread(this->client, &thread,
+                                  jack_client_real_time_priority(this->client) + priorityOffset,
+                                  jack_is_realtime(this->client), routine, arg))
+        throw JackClientException("Could not create thread");
+    return thread;
+}
+
+void JackClient::stopThread(jack_native_thread_t thread) {
+    jack_client_stop_thread(this->client, thread);
+}
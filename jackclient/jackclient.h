@@ -2,11 +2,19 @@
 #define _JACKCLIENT_H
 #include <jack/jack.h>
 #include <jack/midiport.h>
+#include <jack/thread.h>
 
+#include <atomic>
+#include <chrono>
+#include <iterator>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
+#include "rtcheck.h"
+#include "seqlock.h"
+
 enum class JackPortType { AUDIO, MIDI };
 enum class JackState { ACTIVE, INACTIVE, CLOSED };
 namespace Transport {
@@ -16,9 +24,58 @@ enum class JackTransportState {
     STOPPED = JackTransportStopped
 };
 using JackPosition = jack_position_t;
+/**
+ * Transport state and position at the start of a process cycle. The BBT
+ * fields are only meaningful if hasBBT is set, i.e. if a timebase master
+ * supplied them; bar and beat count from 1 as in JACK.
+ * */
+struct JackTransportSnapshot {
+    JackTransportState state;
+    uint64_t cycle;
+    uint32_t frame;
+    uint32_t frameRate;
+    bool hasBBT;
+    int32_t bar;
+    int32_t beat;
+    int32_t tick;
+    float beatsPerBar;
+    float beatType;
+    double ticksPerBeat;
+    double beatsPerMinute;
+    double barStartTick;
+};
 }  // namespace Transport
+enum class JackLatencyMode { CAPTURE = JackCaptureLatency, PLAYBACK = JackPlaybackLatency };
+using JackLatencyRange = jack_latency_range_t;
+
+/**
+ * Base for types with cache-line aligned members: C++14 operator new does
+ * not honour extended alignment, so these allocate aligned storage themselves.
+ * */
+struct JackCacheAligned {
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+    static void* operator new(size_t size);
+    static void* operator new[](size_t size);
+    static void operator delete(void* ptr);
+    static void operator delete[](void* ptr);
+};
 
 class JackClient;
+class JackCommandQueue;
+class JackCommandSchedule;
+class JackParameter;
+class JackCycleStats;
+class JackArena;
+class JackPortGraph;
+class JackAudioPortGroup;
+class JackAudioInputGroup;
+class JackAudioOutputGroup;
+class JackPortGraphSnapshot;
+class JackLatencyCompensator;
+class JackBlockAdapter;
+class JackMeterTap;
+struct JackXRunReport;
+struct JackTapCost;
 /**
  *
  *
@@ -39,12 +96,17 @@ class JackClientException : public std::exception {
  *
  * */
 class JackPort {
+    friend class JackClient;
+    friend class JackPortBuffers;
+
    protected:
     JackClient* client;
     JackPortType portType;
     jack_client_t* client_handle;
     uint32_t bufSize;
     jack_port_t* port;
+    int bufferIndex = -1;
+    bool isBufferResolved() const;
     JackPort(JackClient* client, const char* name, JackPortType type);
     JackPort(JackClient* client, jack_port_t* port, JackPortType type);
     void* getBufferInternal();
@@ -59,6 +121,14 @@ class JackPort {
     std::string getShortName();
     bool isPhysical();
     bool isMine();
+    /**
+     * Capture latency: frames since the data arriving at this port entered
+     * the graph. Playback latency: frames until data leaving this port
+     * reaches the end of the graph.
+     * */
+    JackLatencyRange getLatencyRange(JackLatencyMode mode);
+    /** Only valid inside JackClient::onLatency(). */
+    void setLatencyRange(JackLatencyMode mode, JackLatencyRange range);
 };
 /**
  *
@@ -122,9 +192,59 @@ class JackMIDIEvent {
 
    public:
     JackMIDIEvent(uint32_t time, size_t size, unsigned char* buffer);
-    uint32_t getTime();
-    size_t getSize();
-    unsigned char* getMIDIData();
+    uint32_t getTime() const;
+    size_t getSize() const;
+    unsigned char* getMIDIData() const;
+};
+
+/**
+ * Non-allocating view over the events of a MIDI port buffer. The buffer is
+ * fetched once when the range is created and events are read in place, so the
+ * range is only valid within the process cycle it was obtained in.
+ * */
+class JackMIDIEventRange {
+   private:
+    void* buffer;
+    uint32_t count;
+
+   public:
+    class iterator {
+       private:
+        void* buffer;
+        uint32_t index;
+
+       public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = JackMIDIEvent;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = JackMIDIEvent;
+
+        iterator(void* buffer, uint32_t index) : buffer(buffer), index(index){};
+        JackMIDIEvent operator*() const {
+            jack_midi_event_t ev;
+            if (jack_midi_event_get(&ev, buffer, index)) return JackMIDIEvent(0, 0, nullptr);
+            return JackMIDIEvent(ev.time, ev.size, ev.buffer);
+        };
+        iterator& operator++() {
+            ++index;
+            return *this;
+        };
+        iterator operator++(int) {
+            iterator it = *this;
+            ++index;
+            return it;
+        };
+        bool operator==(const iterator& other) const { return index == other.index; };
+        bool operator!=(const iterator& other) const { return index != other.index; };
+    };
+
+    JackMIDIEventRange(void* buffer);
+    iterator begin() const { return iterator(buffer, 0); };
+    iterator end() const { return iterator(buffer, count); };
+    uint32_t size() const { return count; };
+    bool empty() const { return count == 0; };
+    JackMIDIEvent operator[](uint32_t index) const { return *iterator(buffer, index); };
 };
 
 class JackMIDIInputPort : public JackInputPort {
@@ -133,6 +253,7 @@ class JackMIDIInputPort : public JackInputPort {
    public:
     JackMIDIInputPort(JackClient* client, const char* name);
     JackMIDIInputPort(JackClient* client, jack_port_t* port);
+    JackMIDIEventRange getEvents();
     std::vector<std::unique_ptr<JackMIDIEvent>> getMIDIEvents();
     ~JackMIDIInputPort();
 };
@@ -144,8 +265,34 @@ class JackMIDIOutputPort : public JackOutputPort {
     JackMIDIOutputPort(JackClient* client, const char* name);
     JackMIDIOutputPort(JackClient* client, jack_port_t* port);
     void clearBuffer();
-    void writeEvent(JackMIDIEvent& event);
-    void write(uint32_t time, unsigned char* buffer, size_t size);
+    bool writeEvent(JackMIDIEvent& event);
+    /** False if the event does not fit in the buffer or is out of time order. */
+    bool write(uint32_t time, unsigned char* buffer, size_t size);
+};
+
+/**
+ * Buffers of all ports registered by a client, resolved once at the start of
+ * every process cycle. Only valid inside the cycle that received it.
+ * */
+class JackPortBuffers {
+    friend class JackClient;
+    friend class JackMeterTap;
+    friend class JackPort;
+
+   private:
+    std::vector<void*> buffers;
+    uint32_t nframes = 0;
+    bool valid = false;
+    void* lookup(const JackPort& port) const;
+
+   public:
+    uint32_t getFrameCount() const { return nframes; };
+    size_t size() const { return buffers.size(); };
+    void* operator[](size_t index) const { return buffers[index]; };
+    float* getBuffer(const JackAudioInputPort& port) const;
+    float* getBuffer(const JackAudioOutputPort& port) const;
+    void* getBuffer(const JackMIDIInputPort& port) const;
+    void* getBuffer(const JackMIDIOutputPort& port) const;
 };
 
 /**
@@ -154,59 +301,257 @@ class JackMIDIOutputPort : public JackOutputPort {
  *
  * */
 class JackClient {
+    friend class JackConnector;
+    friend class JackAudioPortGroup;
+    friend class JackLatencyCompensator;
+    friend class JackBlockAdapter;
+    friend class JackInternalClient;
+    friend class JackMeterTap;
     friend class JackPort;
+    friend class JackInputPort;
+    friend class JackOutputPort;
+    friend class JackPortBuffers;
 
    private:
     JackState jackState = JackState::CLOSED;
     jack_status_t status;
     jack_client_t* client;
-    static jack_nframes_t nframes;
+    bool internal = false;
+    // Handle handed over by jack_initialize, adopted by the next openConnection() on this thread.
+    static thread_local jack_client_t* internalHandle;
+    jack_nframes_t bufferSize = 0;
+    jack_nframes_t sampleRate = 0;
+    jack_nframes_t nframes = 0;
+    uint64_t cycle = 0;
+    Transport::JackPosition cyclePosition = {};
+    JackSeqLock<Transport::JackTransportSnapshot> transportSnapshot;
+    std::unique_ptr<JackCycleStats> stats;
+    std::unique_ptr<JackPortGraph> graph;
+    std::unique_ptr<JackArena> arena;
+    size_t arenaBytes = 65536;
+    size_t arenaBytesPerFrame = 0;
+    std::mutex portsMutex;
+    std::vector<JackPort*> ports;
+    std::vector<jack_port_t*> portHandles;
+    // MIDI outputs cleared every cycle. The process thread reads a published copy, as it
+    // must clear them even in cycles where portsMutex is busy.
+    std::vector<jack_port_t*> clearHandles;
+    std::atomic<std::vector<jack_port_t*>*> clearList;
+    std::atomic<bool> clearing;
+    JackPortBuffers buffers;
+    std::unique_ptr<JackCommandQueue> commands;
+    std::unique_ptr<JackCommandSchedule> schedule;
+    uint32_t commandBudget = 256;
+    uint32_t commandBudgetMicros = 100;
+    std::atomic<uint64_t> lateCommands;
+    std::atomic<uint64_t> droppedMIDI;
+    std::atomic<uint64_t> failedCycles;
+    std::atomic<uint32_t> processingLatency;
+    // Largest latency of the JackBlockAdapters that report theirs.
+    std::atomic<uint32_t> adapterLatency;
+    std::mutex groupsMutex;
+    std::vector<JackAudioPortGroup*> groups;
+    std::mutex compensatorsMutex;
+    std::vector<JackLatencyCompensator*> compensators;
+    std::mutex adaptersMutex;
+    std::vector<JackBlockAdapter*> adapters;
+    std::mutex tapsMutex;
+    std::vector<JackMeterTap*> taps;
+    std::atomic<uint64_t> tapCycles;
+    std::atomic<uint64_t> tapCaptures;
+    std::atomic<uint64_t> tapNanos;
+    std::atomic<uint64_t> tapMaxNanos;
     const char* name;
     static int process(jack_nframes_t nframes, void* arg);
     static void jack_shutdown(void* arg);
     static void handleShutdown(void* arg);
     static int buffer_size_callback(jack_nframes_t nframes, void* arg);
+    static int sample_rate_callback(jack_nframes_t nframes, void* arg);
     static int xrun_callback(void* arg);
     static int sync_callback(jack_transport_state_t state, jack_position_t* pos, void* arg);
     static void timebase_callback(jack_transport_state_t state, jack_nframes_t nframes,
                                   jack_position_t* pos, int new_pos, void* arg);
+    static void latency_callback(jack_latency_callback_mode_t mode, void* arg);
     template <typename T>
     std::vector<std::unique_ptr<T>> createPorts(JackPortType type, JackPortFlags flags);
+    void registerPort(JackPort* port, bool clearEachCycle);
+    void unregisterPort(JackPort* port);
+    void publishClearList();
+    void clearMIDIOutputs(jack_nframes_t nframes);
+    void resolveBuffers(jack_nframes_t nframes);
+    void drainCommands(jack_nframes_t nframes);
+    bool pushCommand(const struct JackCommand& command);
+    bool queueMIDI(JackMIDIOutputPort& port, const unsigned char* data, size_t size,
+                   uint32_t time, bool timed);
+    bool queueParameter(JackParameter& parameter, float value, uint32_t time, bool timed);
+    void recordCycle(jack_nframes_t nframes, jack_nframes_t wakeup,
+                     std::chrono::steady_clock::time_point start);
+    void captureTransport();
+    void captureTaps(jack_nframes_t nframes);
+    /** Takes adapterLatency from the adapters, with adaptersMutex held; true if it changed. */
+    bool updateAdapterLatency();
 
    protected:
-    virtual int onProcess(uint32_t sampleCount) = 0;
+    /**
+     * Per-cycle bookkeeping around a process callback: resolves the port
+     * buffers, applies queued commands, and afterwards feeds the meter taps,
+     * resets the arena and records the cycle timing.
+     * */
+    class CycleScope {
+       private:
+        JackClient& client;
+        JackRTCheck::Scope realtime;
+        std::chrono::steady_clock::time_point start;
+        jack_nframes_t nframes;
+        jack_nframes_t wakeup;
+        std::unique_lock<std::mutex> lock;
+
+       public:
+        CycleScope(JackClient& client, jack_nframes_t nframes);
+        ~CycleScope();
+        /**
+         * Counts the cycle as failed and silences every audio and MIDI
+         * output of the client, plus the extra handles. Ports registered
+         * through the client are skipped while their list is busy.
+         * */
+        void fail(jack_port_t* const* extra = nullptr, size_t extraCount = 0);
+    };
+
+    jack_client_t* getHandle() const { return client; };
+    const JackPortBuffers& getPortBuffers() const { return buffers; };
+    /** Connects to the server and installs the callbacks every client needs. */
+    void openConnection();
+    JackXRunReport captureXRunReport();
+    /** Re-reads input latencies for all JackLatencyCompensators of this client. */
+    void updateLatencyCompensation(JackLatencyMode mode);
+    /**
+     * Default latency handling: sets the latency of the ports on one side to
+     * the range over the ports on the other side plus the processing latency.
+     * */
+    void propagateLatency(JackLatencyMode mode);
+    /** The same, also covering ports registered outside JackClient, e.g. by JackStaticClient. */
+    void propagateLatency(JackLatencyMode mode, jack_port_t* const* extra, size_t extraCount);
+
+    /**
+     * The process callback every client implements; the buffers of the
+     * client's ports are resolved for the cycle.
+     * */
+    virtual int onProcess(const JackPortBuffers& buffers, uint32_t sampleCount) = 0;
+    /** Former callback, no longer called; an override of it alone leaves the class abstract. */
+    virtual int onProcess(uint32_t sampleCount) { return 0; };
     virtual void onShutdown(){};
     virtual void onXRun(){};
+    virtual void onXRun(const JackXRunReport& report) { this->onXRun(); };
     virtual int onTransportStart(Transport::JackPosition* pos) { return 1; };
     virtual int onTransportStop(Transport::JackPosition* pos) { return 1; };
     virtual int onTransportRoll(Transport::JackPosition* pos) { return 1; };
     virtual int onTransportSync(Transport::JackTransportState state, Transport::JackPosition* pos);
     virtual void onTimebase(Transport::JackTransportState state, uint32_t frame,
                             Transport::JackPosition* pos, bool newPos){};
+    virtual void onLatency(JackLatencyMode mode) { this->propagateLatency(mode); };
 
    public:
     JackState getState();
-    JackClient(const char* name);
-    ~JackClient();
+    JackClient(const char* name, size_t commandQueueSize = 1024);
+    virtual ~JackClient();
+    /**
+     * Connects to the server, or, inside jack_initialize of an internal
+     * client (see internalclient.h), takes over the handle JACK passed in.
+     * */
     void open();
     void close();
+    /** Client name, as changed by the server if the requested one was taken. */
+    const char* getName() const { return name; };
+    /** True if the client runs inside the server process. */
+    bool isInternal() const { return internal; };
     void activate();
     void startTransport();
     void stopTransport();
     void setTransportPosition(uint32_t position);
+    /** Queries JACK on every call; getTransportSnapshot() reads the per-cycle copy. */
     Transport::JackTransportState getTransportState();
+    /** Fills pos and returns the transport state; safe to call from the process thread. */
+    Transport::JackTransportState getTransportPosition(Transport::JackPosition& pos);
+    /** Transport as captured at the start of the current cycle; process thread only. */
+    const Transport::JackPosition& getCyclePosition() const { return cyclePosition; };
+    /** Transport as of the latest cycle start; lock-free and safe from any thread. */
+    Transport::JackTransportSnapshot getTransportSnapshot() const {
+        return transportSnapshot.load();
+    };
     void enableTimebaseMaster();
     void disableTimebaseMaster();
     void deactivate();
     void startFreewheel();
     void stopFreewheel();
     void setBufferSize(uint32_t bufSize);
+    uint32_t getBufferSize();
     uint32_t getSampleRate();
+    uint32_t getFrameTime();
+    /** Frame time at the start of the current cycle; process thread only. */
+    uint32_t getCycleStartTime();
+    uint64_t getCycleCount() const { return cycle; };
+    JackCycleStats& getCycleStats();
+    /** Per-cycle scratch memory for onProcess, emptied after every cycle. */
+    JackArena& getArena();
+    /** Sizes the arena to bytes + bytesPerFrame * buffer size, also on buffer size changes. */
+    void setArenaSize(size_t bytes, size_t bytesPerFrame = 0);
+    /**
+     * Cached port graph; rescanned on every call while the client is not
+     * active. The client's own port and connection changes show up at once.
+     * */
+    std::shared_ptr<const JackPortGraphSnapshot> getPortGraph();
+    /** Latency added between inputs and outputs, e.g. a limiter's look-ahead, in frames. */
+    void setProcessingLatency(uint32_t frames);
+    /** The larger of setProcessingLatency() and the latency of the reporting block adapters. */
+    uint32_t getProcessingLatency() const {
+        uint32_t set = processingLatency.load(std::memory_order_relaxed);
+        uint32_t adapters = adapterLatency.load(std::memory_order_relaxed);
+        return set > adapters ? set : adapters;
+    };
+    /** Asks JACK to recompute latencies after onLatency() would give a different result. */
+    void recomputeLatencies();
+
+    // Real-time safe commands from any thread, applied at the start of the cycle containing time,
+    // in time order.
+    bool sendMIDI(JackMIDIOutputPort& port, const unsigned char* data, size_t size);
+    bool sendMIDI(JackMIDIOutputPort& port, const unsigned char* data, size_t size,
+                  uint32_t time);
+    bool setParameter(JackParameter& parameter, float value);
+    bool setParameter(JackParameter& parameter, float value, uint32_t time);
+    bool post(void (*function)(void* arg), void* arg);
+    void setCommandBudget(uint32_t maxCommands, uint32_t maxMicroseconds);
+    /** Timed commands applied after their time had passed; untimed ones are never late. */
+    uint64_t getLateCommandCount();
+    /** Queued MIDI events the output port buffer had no room for. */
+    uint64_t getDroppedMIDICount();
+    /**
+     * Cycles in which onProcess threw std::bad_alloc, e.g. because the arena
+     * ran out. Their outputs were silenced and the client kept running.
+     * */
+    uint64_t getFailedCycleCount();
+    /** Process thread time spent feeding the JackMeterTaps of this client. */
+    JackTapCost getTapCost() const;
+
+    /** priorityOffset is added to the client's real-time priority, e.g. -1 for background work. */
+    jack_native_thread_t createRealtimeThread(void* (*routine)(void* arg), void* arg,
+                                              int priorityOffset = 0);
+    void stopThread(jack_native_thread_t thread);
 
     std::unique_ptr<JackAudioInputPort> createAudioInputPort(const char* name);
     std::unique_ptr<JackAudioOutputPort> createAudioOutputPort(const char* name);
     std::unique_ptr<JackMIDIInputPort> createMIDIInputPort(const char* name);
     std::unique_ptr<JackMIDIOutputPort> createMIDIOutputPort(const char* name);
+    /**
+     * Registers ports prefix_1 ... prefix_N as one multichannel group.
+     * maxFrames: largest period the interleaved view must hold, 0 for the
+     * current one; it also grows with the buffer size.
+     * */
+    std::unique_ptr<JackAudioInputGroup> createAudioInputGroup(const char* prefix,
+                                                               uint32_t channels,
+                                                               uint32_t maxFrames = 0);
+    std::unique_ptr<JackAudioOutputGroup> createAudioOutputGroup(const char* prefix,
+                                                                 uint32_t channels,
+                                                                 uint32_t maxFrames = 0);
 
     std::vector<std::unique_ptr<JackAudioInputPort>> getAudioInputPorts();
     std::vector<std::unique_ptr<JackAudioOutputPort>> getAudioOutputPorts();
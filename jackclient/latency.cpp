@@ -0,0 +1,98 @@
+#include "latency.h"
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+void JackLatencyCompensator::FreeDeleter::operator()(float* ptr) const { free(ptr); }
+
+static float* allocateAligned(size_t floats) {
+    void* ptr;
+    if (posix_memalign(&ptr, JackCacheAligned::CACHE_LINE_SIZE, floats * sizeof(float)))
+        throw std::bad_alloc();
+    std::memset(ptr, 0, floats * sizeof(float));
+    return static_cast<float*>(ptr);
+}
+
+JackLatencyCompensator::JackLatencyCompensator(JackClient* client,
+                                               std::vector<JackAudioInputPort*> ports,
+                                               uint32_t maxDelay, uint32_t maxFrames)
+    : client(client),
+      ports(ports),
+      maxDelay(maxDelay),
+      delays(new std::atomic<uint32_t>[ports.size()]),
+      planar(ports.size(), nullptr),
+      worstLatency(0),
+      clamped(0) {
+    if (ports.empty()) throw JackClientException("Latency compensation needs at least one port");
+    for (size_t i = 0; i < ports.size(); i++) this->delays[i].store(0, std::memory_order_relaxed);
+    this->reserve(maxFrames ? maxFrames : client->getBufferSize());
+    this->update();
+    std::lock_guard<std::mutex> lock(client->compensatorsMutex);
+    client->compensators.push_back(this);
+}
+
+JackLatencyCompensator::~JackLatencyCompensator() {
+    std::lock_guard<std::mutex> lock(this->client->compensatorsMutex);
+    std::vector<JackLatencyCompensator*>& list = this->client->compensators;
+    list.erase(std::remove(list.begin(), list.end(), this), list.end());
+}
+
+void JackLatencyCompensator::reserve(uint32_t maxFrames) {
+    if (maxFrames <= this->maxFrames) return;
+    size_t lineSize = 1;
+    while (lineSize < (size_t)this->maxDelay + maxFrames) lineSize <<= 1;
+    this->lines.reset(allocateAligned(lineSize * this->ports.size()));
+    this->scratch.reset(allocateAligned((size_t)maxFrames * this->ports.size()));
+    this->lineSize = lineSize;
+    this->maxFrames = maxFrames;
+    this->position = 0;
+}
+
+void JackLatencyCompensator::update() {
+    std::vector<uint32_t> latencies;
+    latencies.reserve(this->ports.size());
+    uint32_t worst = 0;
+    for (JackAudioInputPort* port : this->ports) {
+        latencies.push_back(port->getLatencyRange(JackLatencyMode::CAPTURE).max);
+        worst = std::max(worst, latencies.back());
+    }
+    for (size_t i = 0; i < latencies.size(); i++) {
+        uint32_t delay = worst - latencies[i];
+        if (delay > this->maxDelay) {
+            delay = this->maxDelay;
+            this->clamped.fetch_add(1, std::memory_order_relaxed);
+        }
+        this->delays[i].store(delay, std::memory_order_relaxed);
+    }
+    this->worstLatency.store(worst, std::memory_order_relaxed);
+}
+
+const float* const* JackLatencyCompensator::process(const JackPortBuffers& buffers) {
+    uint32_t nframes = buffers.getFrameCount();
+    size_t mask = this->lineSize - 1;
+    for (size_t c = 0; c < this->ports.size(); c++) {
+        const float* in = buffers.getBuffer(*this->ports[c]);
+        this->planar[c] = in;
+        if (nframes > this->maxFrames) continue;
+        // Every input goes through its line, so a later change of delay has history to read.
+        float* line = this->lines.get() + c * this->lineSize;
+        size_t start = this->position & mask;
+        size_t first = std::min((size_t)nframes, this->lineSize - start);
+        std::memcpy(line + start, in, first * sizeof(float));
+        std::memcpy(line, in + first, (nframes - first) * sizeof(float));
+
+        uint32_t delay = this->delays[c].load(std::memory_order_relaxed);
+        if (!delay) continue;
+        float* out = this->scratch.get() + c * this->maxFrames;
+        start = (this->position - delay) & mask;
+        first = std::min((size_t)nframes, this->lineSize - start);
+        std::memcpy(out, line + start, first * sizeof(float));
+        std::memcpy(out + first, line, (nframes - first) * sizeof(float));
+        this->planar[c] = out;
+    }
+    if (nframes <= this->maxFrames) this->position += nframes;
+    return this->planar.data();
+}
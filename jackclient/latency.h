@@ -0,0 +1,69 @@
+#ifndef _JACKCLIENT_LATENCY_H
+#define _JACKCLIENT_LATENCY_H
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "jackclient.h"
+
+/**
+ * Delays audio inputs so that all of them line up with the one that has
+ * the largest capture latency, e.g. a dry signal and the same signal coming
+ * back through a plugin chain. Each input is written into a delay line
+ * allocated up front for getMaxDelay() plus getMaxFrames() frames. The
+ * delays are recomputed from the ports' capture latency whenever JACK
+ * reports a latency change, which includes every change to the graph;
+ * a changed delay takes effect at the start of the next cycle. Differences
+ * larger than getMaxDelay() are clamped and counted. The client grows the
+ * delay lines when the buffer size grows past getMaxFrames().
+ * */
+class JackLatencyCompensator {
+    friend class JackClient;
+
+   private:
+    struct FreeDeleter {
+        void operator()(float* ptr) const;
+    };
+
+    JackClient* client;
+    std::vector<JackAudioInputPort*> ports;
+    uint32_t maxDelay;
+    uint32_t maxFrames = 0;
+    size_t lineSize = 0;
+    size_t position = 0;
+    std::unique_ptr<float, FreeDeleter> lines;
+    std::unique_ptr<float, FreeDeleter> scratch;
+    std::unique_ptr<std::atomic<uint32_t>[]> delays;
+    std::vector<const float*> planar;
+    std::atomic<uint32_t> worstLatency;
+    std::atomic<uint64_t> clamped;
+
+    /** Grows the delay lines for larger periods. Only while process() cannot run. */
+    void reserve(uint32_t maxFrames);
+
+   public:
+    /** maxFrames: largest period to compensate, 0 for the current one. */
+    JackLatencyCompensator(JackClient* client, std::vector<JackAudioInputPort*> ports,
+                           uint32_t maxDelay, uint32_t maxFrames = 0);
+    ~JackLatencyCompensator();
+    /** Re-reads the capture latencies; JackClient calls this from its latency callback. */
+    void update();
+    /**
+     * This cycle's aligned input, one buffer per port in constructor order.
+     * Ports without delay are passed through. If the period is longer than
+     * getMaxFrames() nothing is delayed.
+     * */
+    const float* const* process(const JackPortBuffers& buffers);
+
+    uint32_t getChannelCount() const { return (uint32_t)ports.size(); };
+    uint32_t getMaxDelay() const { return maxDelay; };
+    uint32_t getMaxFrames() const { return maxFrames; };
+    uint32_t getDelay(uint32_t channel) const {
+        return delays[channel].load(std::memory_order_relaxed);
+    };
+    /** Largest capture latency (range maximum) over all ports, which every input is aligned to. */
+    uint32_t getWorstLatency() const { return worstLatency.load(std::memory_order_relaxed); };
+    /** Ports that needed more than getMaxDelay() frames, counted on every update. */
+    uint64_t getClampedCount() const { return clamped.load(std::memory_order_relaxed); };
+};
+#endif
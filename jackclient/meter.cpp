@@ -0,0 +1,553 @@
+#include "meter.h"
+
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "audiokernels.h"
+
+namespace {
+// Samples the analyzer filters and oversamples at a time.
+const uint32_t CHUNK = 1024;
+// Loudness below which gating blocks are ignored, and the histogram resolution.
+const double ABSOLUTE_GATE = -70.0;
+const double BINS_PER_LU = 10.0;
+
+double loudness(double meanSquare) {
+    return meanSquare > 0.0 ? -0.691 + 10.0 * std::log10(meanSquare) : -INFINITY;
+}
+
+// Prototype of the 4x interpolator: a 48 tap Blackman-windowed sinc with its
+// cutoff at the original Nyquist frequency, each phase normalised to unity gain.
+std::vector<float> designInterpolator(uint32_t phases, uint32_t taps) {
+    uint32_t length = phases * taps;
+    std::vector<float> coefficients(length);
+    double centre = (length - 1) / 2.0;
+    for (uint32_t j = 0; j < length; j++) {
+        double x = (j - centre) / phases;
+        double sinc = x == 0.0 ? 1.0 : std::sin(M_PI * x) / (M_PI * x);
+        double w = 2.0 * M_PI * (j + 0.5) / length;
+        double blackman = 0.42 - 0.5 * std::cos(w) + 0.08 * std::cos(2.0 * w);
+        coefficients[j] = (float)(sinc * blackman);
+    }
+    for (uint32_t p = 0; p < phases; p++) {
+        double sum = 0.0;
+        for (uint32_t k = 0; k < taps; k++) sum += coefficients[k * phases + p];
+        for (uint32_t k = 0; k < taps; k++) coefficients[k * phases + p] /= (float)sum;
+    }
+    return coefficients;
+}
+}  // namespace
+
+const uint32_t JackMeterTap::TRUE_PEAK_TAPS;
+const uint32_t JackMeterTap::LOUDNESS_BINS;
+const uint32_t JackMeterTap::SHORT_TERM_BLOCKS;
+
+/** Tables for a radix-2 FFT of one size, shared by all taps using it. */
+struct JackFFTPlan {
+    uint32_t size;
+    std::vector<uint32_t> reversed;
+    std::vector<float> window;
+    // Twiddles of the stage with half-length h start at index h - 1.
+    std::vector<float> twiddleRe;
+    std::vector<float> twiddleIm;
+
+    explicit JackFFTPlan(uint32_t size)
+        : size(size), reversed(size), window(size), twiddleRe(size), twiddleIm(size) {
+        uint32_t bits = 0;
+        while ((1u << bits) < size) bits++;
+        for (uint32_t i = 0; i < size; i++) {
+            uint32_t r = 0;
+            for (uint32_t b = 0; b < bits; b++) r |= ((i >> b) & 1) << (bits - 1 - b);
+            this->reversed[i] = r;
+            this->window[i] = (float)(0.5 - 0.5 * std::cos(2.0 * M_PI * i / size));
+        }
+        for (uint32_t h = 1; h < size; h <<= 1) {
+            for (uint32_t k = 0; k < h; k++) {
+                this->twiddleRe[h - 1 + k] = (float)std::cos(-M_PI * k / h);
+                this->twiddleIm[h - 1 + k] = (float)std::sin(-M_PI * k / h);
+            }
+        }
+    };
+};
+
+/** Buffers of one analyzer thread, grown on first use. */
+struct JackAnalyzerScratch {
+    std::vector<float> input;
+    std::vector<float> oversampled;
+    std::vector<float> re;
+    std::vector<float> im;
+};
+
+JackMeterTap::JackMeterTap(JackClient* client, JackAudioInputPort& port, JackAnalyzer& analyzer,
+                           const JackMeterOptions& options)
+    : JackMeterTap(client, static_cast<const JackPort*>(&port), analyzer, options) {}
+
+JackMeterTap::JackMeterTap(JackClient* client, JackAudioOutputPort& port, JackAnalyzer& analyzer,
+                           const JackMeterOptions& options)
+    : JackMeterTap(client, static_cast<const JackPort*>(&port), analyzer, options) {}
+
+JackMeterTap::JackMeterTap(JackClient* client, const JackPort* port, JackAnalyzer& analyzer,
+                           const JackMeterOptions& options)
+    : client(client),
+      analyzer(analyzer),
+      port(port),
+      options(options),
+      sampleRate(client->getState() == JackState::CLOSED ? 0 : client->getSampleRate()),
+      streaming(options.loudness || options.truePeak),
+      blocks(new JackRingBuffer<Block>(
+          std::max<size_t>(256, (size_t)sampleRate * options.bufferMillis / 1000 / 32))),
+      skippedWindows(0),
+      resetRequested(false),
+      spectrumSequence(0) {
+    if (this->sampleRate == 0) throw JackClientException("Meter taps need an open client");
+    uint32_t fftSize = options.fftSize;
+    if (fftSize && (fftSize < 64 || fftSize > 32768 || (fftSize & (fftSize - 1))))
+        throw JackClientException("FFT size must be a power of two from 64 to 32768");
+    size_t frames = (size_t)this->sampleRate * options.bufferMillis / 1000;
+    if (this->streaming || fftSize)
+        this->samples.reset(new JackRingBuffer<float>(std::max<size_t>(frames, 2 * fftSize)));
+
+    // BS.1770 K-weighting for any sample rate: a high shelf and a high pass,
+    // from the analogue prototypes as {b0, b1, b2, a1, a2}.
+    double k = std::tan(M_PI * 1681.974450955533 / this->sampleRate);
+    double q = 0.7071752369554196;
+    double vh = std::pow(10.0, 3.999843853973347 / 20.0);
+    double vb = std::pow(vh, 0.4996667741545416);
+    double a0 = 1.0 + k / q + k * k;
+    this->shelf[0] = (vh + vb * k / q + k * k) / a0;
+    this->shelf[1] = 2.0 * (k * k - vh) / a0;
+    this->shelf[2] = (vh - vb * k / q + k * k) / a0;
+    this->shelf[3] = 2.0 * (k * k - 1.0) / a0;
+    this->shelf[4] = (1.0 - k / q + k * k) / a0;
+    k = std::tan(M_PI * 38.13547087602444 / this->sampleRate);
+    q = 0.5003270373238773;
+    a0 = 1.0 + k / q + k * k;
+    this->highpass[0] = 1.0;
+    this->highpass[1] = -2.0;
+    this->highpass[2] = 1.0;
+    this->highpass[3] = 2.0 * (k * k - 1.0) / a0;
+    this->highpass[4] = (1.0 - k / q + k * k) / a0;
+    this->subblockFrames = std::max(1u, this->sampleRate / 10);
+    if (options.loudness) {
+        this->gateCounts.assign(LOUDNESS_BINS, 0);
+        this->gateEnergy.assign(LOUDNESS_BINS, 0.0);
+    }
+
+    if (fftSize) {
+        // A spectrum without streaming receives whole windows back to back.
+        uint32_t interval =
+            std::max(1u, (uint32_t)(this->sampleRate / std::max(options.spectrumRate, 0.01f)));
+        this->windowGap = interval > fftSize ? interval - fftSize : 0;
+        this->spectrumInterval = this->streaming ? interval : fftSize;
+        this->spectrumCountdown = this->spectrumInterval;
+        this->window.assign(fftSize, 0.0f);
+        this->smoothed.assign(this->getSpectrumSize(), 0.0f);
+        this->spectrum.reset(new std::atomic<float>[this->getSpectrumSize()]);
+        for (uint32_t i = 0; i < this->getSpectrumSize(); i++)
+            this->spectrum[i].store(-INFINITY, std::memory_order_relaxed);
+    }
+
+    this->state.momentary = -INFINITY;
+    this->state.shortTerm = -INFINITY;
+    this->clear();
+    this->snapshot.store(this->state);
+    {
+        std::lock_guard<std::mutex> lock(client->tapsMutex);
+        client->taps.push_back(this);
+    }
+    analyzer.add(this);
+}
+
+JackMeterTap::~JackMeterTap() {
+    {
+        std::lock_guard<std::mutex> lock(this->client->tapsMutex);
+        std::vector<JackMeterTap*>& list = this->client->taps;
+        list.erase(std::remove(list.begin(), list.end(), this), list.end());
+    }
+    this->analyzer.remove(this);
+}
+
+void JackMeterTap::capture(uint32_t nframes) {
+    const float* buffer = (const float*)this->client->buffers.lookup(*this->port);
+    if (!buffer) return;
+    float rms = AudioKernels::rms(buffer, nframes);
+    Block block = {AudioKernels::peak(buffer, nframes), rms * rms, nframes};
+    this->blocks->write(&block, 1);
+    if (this->streaming)
+        this->samples->write(buffer, nframes);
+    else if (this->samples)
+        this->captureWindows(buffer, nframes);
+}
+
+void JackMeterTap::captureWindows(const float* buffer, uint32_t nframes) {
+    uint32_t fftSize = this->options.fftSize;
+    uint32_t offset = 0;
+    while (offset < nframes) {
+        if (this->windowRemaining == 0) {
+            uint32_t wait = std::min(this->windowCountdown, nframes - offset);
+            this->windowCountdown -= wait;
+            offset += wait;
+            if (this->windowCountdown > 0) break;
+            this->windowCountdown = this->windowGap;
+            // A window is only started with room for all of it, so the analyzer never
+            // sees a partial one.
+            if (this->samples->getWriteSpace() >= fftSize)
+                this->windowRemaining = fftSize;
+            else
+                this->skippedWindows.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        uint32_t count = std::min(this->windowRemaining, nframes - offset);
+        this->samples->write(buffer + offset, count);
+        this->windowRemaining -= count;
+        offset += count;
+    }
+}
+
+void JackMeterTap::clear() {
+    this->state.frames = 0;
+    this->state.maxPeak = 0.0f;
+    this->state.maxTruePeak = 0.0f;
+    this->state.integrated = -INFINITY;
+    std::fill(this->gateCounts.begin(), this->gateCounts.end(), 0);
+    std::fill(this->gateEnergy.begin(), this->gateEnergy.end(), 0.0);
+}
+
+void JackMeterTap::analyze(JackAnalyzerScratch& scratch) {
+    if (this->resetRequested.exchange(false, std::memory_order_relaxed)) this->clear();
+
+    JackRingBufferState::Vector vec = this->blocks->getReadVector();
+    for (JackRingBufferState::Segment segment : {vec.first, vec.second}) {
+        const Block* block = this->blocks->getData() + segment.offset;
+        for (size_t i = 0; i < segment.size; i++, block++) {
+            if (block->frames != this->rmsFrames) {
+                this->rmsFrames = block->frames;
+                double seconds = (double)block->frames / this->sampleRate;
+                this->rmsCoefficient = (float)(1.0 - std::exp(-seconds / this->options.rmsTime));
+                this->peakDecay =
+                    (float)std::pow(10.0, -this->options.peakRelease * seconds / 20.0);
+            }
+            this->state.frames += block->frames;
+            this->state.peak = std::max(block->peak, this->state.peak * this->peakDecay);
+            this->state.maxPeak = std::max(this->state.maxPeak, block->peak);
+            this->meanSquare += (block->meanSquare - this->meanSquare) * this->rmsCoefficient;
+        }
+    }
+    this->blocks->commitRead(vec.size());
+    this->state.rms = (float)std::sqrt(this->meanSquare);
+
+    if (this->samples) {
+        vec = this->samples->getReadVector();
+        for (JackRingBufferState::Segment segment : {vec.first, vec.second})
+            this->analyzeSamples(this->samples->getData() + segment.offset, segment.size, scratch);
+        this->samples->commitRead(vec.size());
+    }
+
+    this->state.overruns = this->blocks->getOverruns() +
+                           (this->samples ? this->samples->getOverruns() : 0) +
+                           this->skippedWindows.load(std::memory_order_relaxed);
+    if (this->options.loudness) this->state.integrated = this->integratedLoudness();
+    this->snapshot.store(this->state);
+}
+
+void JackMeterTap::analyzeSamples(const float* src, uint32_t count, JackAnalyzerScratch& scratch) {
+    static const std::vector<float> interpolator = designInterpolator(4, TRUE_PEAK_TAPS);
+    const uint32_t history = TRUE_PEAK_TAPS - 1;
+    while (count) {
+        uint32_t n = std::min(count, CHUNK);
+
+        if (this->options.loudness) {
+            const double* s = this->shelf;
+            const double* h = this->highpass;
+            double* z = this->filterState;
+            for (uint32_t i = 0; i < n; i++) {
+                double x = src[i];
+                double y = s[0] * x + z[0];
+                z[0] = s[1] * x - s[3] * y + z[1];
+                z[1] = s[2] * x - s[4] * y;
+                double w = h[0] * y + z[2];
+                z[2] = h[1] * y - h[3] * w + z[3];
+                z[3] = h[2] * y - h[4] * w;
+                this->subblockEnergy += w * w;
+                if (++this->subblockFill == this->subblockFrames) {
+                    this->addSubblock(this->subblockEnergy / this->subblockFrames);
+                    this->subblockEnergy = 0.0;
+                    this->subblockFill = 0;
+                }
+            }
+        }
+
+        if (this->options.truePeak) {
+            // Each phase of the polyphase interpolator is a sum of shifted, scaled copies
+            // of the input, which the SIMD kernels compute over the whole chunk.
+            if (scratch.input.size() < CHUNK + history) {
+                scratch.input.resize(CHUNK + history);
+                scratch.oversampled.resize(CHUNK);
+            }
+            float* input = scratch.input.data();
+            float* out = scratch.oversampled.data();
+            std::memcpy(input, this->history, sizeof(this->history));
+            AudioKernels::copy(input + history, src, n);
+            float level = AudioKernels::peak(src, n);
+            for (uint32_t p = 0; p < 4; p++) {
+                AudioKernels::clear(out, n);
+                for (uint32_t k = 0; k < TRUE_PEAK_TAPS; k++)
+                    AudioKernels::mixAdd(out, input + history - k, interpolator[4 * k + p], n);
+                level = std::max(level, AudioKernels::peak(out, n));
+            }
+            std::memcpy(this->history, input + n, sizeof(this->history));
+            float decay =
+                (float)std::pow(10.0, -this->options.peakRelease * n / this->sampleRate / 20.0);
+            this->state.truePeak = std::max(level, this->state.truePeak * decay);
+            this->state.maxTruePeak = std::max(this->state.maxTruePeak, level);
+        }
+
+        if (this->options.fftSize) {
+            uint32_t fftSize = this->options.fftSize;
+            const float* p = src;
+            uint32_t left = n;
+            while (left) {
+                uint32_t step = std::min(std::min(left, this->spectrumCountdown),
+                                         fftSize - this->windowPos);
+                std::memcpy(this->window.data() + this->windowPos, p, step * sizeof(float));
+                this->windowPos = (this->windowPos + step) & (fftSize - 1);
+                this->windowFill = std::min(fftSize, this->windowFill + step);
+                this->spectrumCountdown -= step;
+                p += step;
+                left -= step;
+                if (this->spectrumCountdown == 0) {
+                    this->spectrumCountdown = this->spectrumInterval;
+                    if (this->windowFill == fftSize) this->transform(scratch);
+                }
+            }
+        }
+
+        src += n;
+        count -= n;
+    }
+}
+
+void JackMeterTap::addSubblock(double energy) {
+    // 100 ms sub-blocks: momentary loudness and gating blocks span 4 of them, so
+    // gating blocks overlap by 75%; short-term loudness spans 30.
+    this->subblocks[this->subblockCount % SHORT_TERM_BLOCKS] = energy;
+    this->subblockCount++;
+    double sum = 0.0;
+    uint32_t available = std::min(this->subblockCount, SHORT_TERM_BLOCKS);
+    for (uint32_t i = 0; i < available; i++) sum += this->subblocks[i];
+    this->state.shortTerm = (float)loudness(sum / available);
+    double block = 0.0;
+    uint32_t recent = std::min(this->subblockCount, 4u);
+    for (uint32_t i = 1; i <= recent; i++)
+        block += this->subblocks[(this->subblockCount - i) % SHORT_TERM_BLOCKS];
+    block /= recent;
+    double level = loudness(block);
+    this->state.momentary = (float)level;
+    if (recent < 4 || !(level > ABSOLUTE_GATE)) return;
+    uint32_t bin =
+        std::min(LOUDNESS_BINS - 1, (uint32_t)((level - ABSOLUTE_GATE) * BINS_PER_LU));
+    this->gateCounts[bin]++;
+    this->gateEnergy[bin] += block;
+}
+
+float JackMeterTap::integratedLoudness() const {
+    // Gating blocks are binned by loudness, which places the relative gate to 0.1 LU.
+    uint64_t count = 0;
+    double energy = 0.0;
+    for (uint32_t i = 0; i < LOUDNESS_BINS; i++) {
+        count += this->gateCounts[i];
+        energy += this->gateEnergy[i];
+    }
+    if (count == 0) return -INFINITY;
+    double gate = loudness(energy / count) - 10.0;
+    double first = std::max(0.0, (gate - ABSOLUTE_GATE) * BINS_PER_LU);
+    count = 0;
+    energy = 0.0;
+    for (uint32_t i = (uint32_t)first; i < LOUDNESS_BINS; i++) {
+        count += this->gateCounts[i];
+        energy += this->gateEnergy[i];
+    }
+    return count ? (float)loudness(energy / count) : -INFINITY;
+}
+
+void JackMeterTap::transform(JackAnalyzerScratch& scratch) {
+    const JackFFTPlan& plan = *this->plan;
+    uint32_t n = plan.size;
+    if (scratch.re.size() < n) {
+        scratch.re.resize(n);
+        scratch.im.resize(n);
+    }
+    float* re = scratch.re.data();
+    float* im = scratch.im.data();
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t r = plan.reversed[i];
+        re[r] = this->window[(this->windowPos + i) & (n - 1)] * plan.window[i];
+        im[r] = 0.0f;
+    }
+    for (uint32_t i = 0; i < n; i += 2) {
+        float a = re[i], b = re[i + 1];
+        re[i] = a + b;
+        re[i + 1] = a - b;
+        a = im[i];
+        b = im[i + 1];
+        im[i] = a + b;
+        im[i + 1] = a - b;
+    }
+    for (uint32_t h = 2; h < n; h <<= 1) {
+        const float* wr = plan.twiddleRe.data() + h - 1;
+        const float* wi = plan.twiddleIm.data() + h - 1;
+        for (uint32_t g = 0; g < n; g += 2 * h)
+            AudioKernels::butterfly(re + g, im + g, re + g + h, im + g + h, wr, wi, h);
+    }
+    uint32_t bins = n / 2 + 1;
+    AudioKernels::power(re, re, im, bins);
+
+    // A Hann-windowed sine of amplitude A peaks at A * n / 4.
+    float offset = 20.0f * std::log10(4.0f / n);
+    float keep = std::min(std::max(this->options.spectrumSmoothing, 0.0f), 0.999f);
+    uint32_t sequence = this->spectrumSequence.load(std::memory_order_relaxed);
+    this->spectrumSequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (uint32_t i = 0; i < bins; i++) {
+        float power = this->smoothed[i] = this->smoothed[i] * keep + re[i] * (1.0f - keep);
+        this->spectrum[i].store(10.0f * std::log10(std::max(power, 1e-30f)) + offset,
+                                std::memory_order_relaxed);
+    }
+    this->spectrumSequence.store(sequence + 2, std::memory_order_release);
+}
+
+bool JackMeterTap::getSpectrum(std::vector<float>& magnitudes) const {
+    uint32_t bins = this->getSpectrumSize();
+    if (bins == 0) return false;
+    magnitudes.resize(bins);
+    for (;;) {
+        uint32_t sequence = this->spectrumSequence.load(std::memory_order_acquire);
+        if (sequence == 0) return false;
+        if (sequence & 1) continue;
+        for (uint32_t i = 0; i < bins; i++)
+            magnitudes[i] = this->spectrum[i].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (this->spectrumSequence.load(std::memory_order_relaxed) == sequence) return true;
+    }
+}
+
+JackAnalyzer::JackAnalyzer(uint32_t threadCount, uint32_t intervalMillis, int niceness)
+    : interval(std::max(1u, intervalMillis)),
+      niceness(niceness),
+      nextTap(0),
+      passes(0),
+      passNanos(0),
+      maxPassNanos(0) {
+    if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+    for (uint32_t i = 0; i < threadCount; i++)
+        this->scratch.emplace_back(new JackAnalyzerScratch());
+    this->threads.emplace_back(&JackAnalyzer::coordinate, this);
+    for (uint32_t i = 1; i < threadCount; i++)
+        this->threads.emplace_back(&JackAnalyzer::help, this, i);
+}
+
+JackAnalyzer::~JackAnalyzer() {
+    {
+        std::lock_guard<std::mutex> lock(this->passMutex);
+        this->running = false;
+    }
+    this->passStart.notify_all();
+    for (std::thread& thread : this->threads) thread.join();
+}
+
+void JackAnalyzer::lowerPriority() {
+    // On Linux the nice value is per thread; the process thread and JACK are unaffected.
+    setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), this->niceness);
+    pthread_setname_np(pthread_self(), "jackanalyzer");
+}
+
+void JackAnalyzer::coordinate() {
+    this->lowerPriority();
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(this->passMutex);
+    for (;;) {
+        next += this->interval;
+        this->passStart.wait_until(lock, next, [this] { return !this->running; });
+        if (!this->running) return;
+        // After a stall, carry on from now instead of running the missed passes back to back.
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (next + this->interval < now) next = now;
+        lock.unlock();
+
+        std::lock_guard<std::mutex> registry(this->tapsMutex);
+        if (!this->taps.empty()) {
+            {
+                std::lock_guard<std::mutex> pass(this->passMutex);
+                this->passTaps = this->taps.data();
+                this->passSize = this->taps.size();
+                this->nextTap.store(0, std::memory_order_relaxed);
+                this->pending = (uint32_t)this->threads.size() - 1;
+                this->pass++;
+            }
+            this->passStart.notify_all();
+            this->work(0);
+            {
+                std::unique_lock<std::mutex> pass(this->passMutex);
+                this->passEnd.wait(pass, [this] { return this->pending == 0; });
+            }
+            uint64_t nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                 std::chrono::steady_clock::now() - now)
+                                 .count();
+            this->passes.fetch_add(1, std::memory_order_relaxed);
+            this->passNanos.fetch_add(nanos, std::memory_order_relaxed);
+            if (nanos > this->maxPassNanos.load(std::memory_order_relaxed))
+                this->maxPassNanos.store(nanos, std::memory_order_relaxed);
+        }
+        lock.lock();
+    }
+}
+
+void JackAnalyzer::help(uint32_t worker) {
+    this->lowerPriority();
+    uint64_t seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(this->passMutex);
+            this->passStart.wait(lock,
+                                 [this, seen] { return !this->running || this->pass != seen; });
+            // A pass that started before the stop still needs this thread.
+            if (this->pass == seen) return;
+            seen = this->pass;
+        }
+        this->work(worker);
+        std::lock_guard<std::mutex> lock(this->passMutex);
+        if (--this->pending == 0) this->passEnd.notify_one();
+    }
+}
+
+void JackAnalyzer::work(uint32_t worker) {
+    JackAnalyzerScratch& scratch = *this->scratch[worker];
+    for (size_t i; (i = this->nextTap.fetch_add(1, std::memory_order_relaxed)) < this->passSize;)
+        this->passTaps[i]->analyze(scratch);
+}
+
+void JackAnalyzer::add(JackMeterTap* tap) {
+    std::lock_guard<std::mutex> lock(this->tapsMutex);
+    if (uint32_t fftSize = tap->options.fftSize) {
+        std::shared_ptr<const JackFFTPlan>& plan = this->plans[fftSize];
+        if (!plan) plan = std::make_shared<JackFFTPlan>(fftSize);
+        tap->plan = plan;
+    }
+    this->taps.push_back(tap);
+}
+
+void JackAnalyzer::remove(JackMeterTap* tap) {
+    std::lock_guard<std::mutex> lock(this->tapsMutex);
+    this->taps.erase(std::remove(this->taps.begin(), this->taps.end(), tap), this->taps.end());
+}
+
+float JackAnalyzer::getPassMicros() const {
+    uint64_t count = this->passes.load(std::memory_order_relaxed);
+    return count ? this->passNanos.load(std::memory_order_relaxed) / 1000.0f / count : 0.0f;
+}
@@ -0,0 +1,247 @@
+#ifndef _JACKCLIENT_METER_H
+#define _JACKCLIENT_METER_H
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "jackclient.h"
+#include "ringbuffer.h"
+#include "seqlock.h"
+
+/** Process thread time spent feeding a client's meter taps; see JackClient::getTapCost(). */
+struct JackTapCost {
+    /** Cycles in which at least one tap was fed. */
+    uint64_t cycles;
+    /** Captures over all taps and cycles. */
+    uint64_t captures;
+    /** Average per cycle for all taps together. */
+    float cycleMicros;
+    /** Average per capture, i.e. per tap and cycle. */
+    float tapMicros;
+    float maxCycleMicros;
+};
+
+struct JackMeterOptions {
+    /** BS.1770 momentary, short-term and integrated loudness. Streams every sample. */
+    bool loudness = true;
+    /** Peak of the signal oversampled 4 times. Streams every sample. */
+    bool truePeak = true;
+    /** Spectrum size, a power of two from 64 to 32768; 0 turns the spectrum off. */
+    uint32_t fftSize = 0;
+    /** Spectrum updates per second, at most. */
+    float spectrumRate = 30.0f;
+    /** Share of the previous spectrum kept in each update, from 0 up to below 1. */
+    float spectrumSmoothing = 0.5f;
+    /** Time constant of the RMS level in seconds. */
+    float rmsTime = 0.3f;
+    /** Fall-back of the peak levels in dB per second. */
+    float peakRelease = 20.0f;
+    /** Audio the tap buffers for the analyzer, with periods of 32 frames or more. */
+    uint32_t bufferMillis = 500;
+};
+
+/**
+ * Latest results of a tap. Levels are linear (1.0 is full scale), loudness
+ * is in LUFS and -infinity for silence. The max values and the integrated
+ * loudness cover everything since the tap was created or reset.
+ * */
+struct JackMeterSnapshot {
+    /** Frames analysed. */
+    uint64_t frames;
+    /** Blocks lost because the analyzer fell behind the process thread. */
+    uint64_t overruns;
+    float peak;
+    float maxPeak;
+    float rms;
+    float truePeak;
+    float maxTruePeak;
+    /** Loudness of the last 400 ms. */
+    float momentary;
+    /** Loudness of the last 3 s. */
+    float shortTerm;
+    /** Gated loudness, as for a whole programme. */
+    float integrated;
+};
+
+class JackAnalyzer;
+struct JackFFTPlan;
+struct JackAnalyzerScratch;
+
+/**
+ * Meters one audio port: peak and RMS, and optionally loudness, true peak
+ * and a spectrum. The process thread only captures, after onProcess, so
+ * output ports show what the client wrote: a block peak and mean square
+ * per cycle, plus the samples the enabled analyses need, pushed into
+ * wait-free ring buffers. Loudness and true peak need every sample, so
+ * they cost one copy of the period; a spectrum on its own only copies a
+ * window of fftSize frames spectrumRate times per second. A full buffer
+ * drops the block and counts an overrun, so the process thread never
+ * waits. The filtering, oversampling and FFTs run on a JackAnalyzer.
+ *
+ * Results are published after every analyzer pass and can be read from any
+ * thread without locks. The tap reads its port through the client, so it
+ * must be destroyed before the port and the client. The sample rate is
+ * taken when the tap is created.
+ * */
+class JackMeterTap {
+    friend class JackClient;
+    friend class JackAnalyzer;
+
+   private:
+    struct Block {
+        float peak;
+        float meanSquare;
+        uint32_t frames;
+    };
+    static const uint32_t TRUE_PEAK_TAPS = 12;
+    static const uint32_t LOUDNESS_BINS = 1000;
+    static const uint32_t SHORT_TERM_BLOCKS = 30;
+
+    JackClient* client;
+    JackAnalyzer& analyzer;
+    const JackPort* port;
+    JackMeterOptions options;
+    uint32_t sampleRate;
+    bool streaming;
+
+    // Process thread.
+    std::unique_ptr<JackRingBuffer<Block>> blocks;
+    std::unique_ptr<JackRingBuffer<float>> samples;
+    uint32_t windowGap = 0;
+    uint32_t windowCountdown = 0;
+    uint32_t windowRemaining = 0;
+    std::atomic<uint64_t> skippedWindows;
+
+    // Analyzer, one pass at a time.
+    std::atomic<bool> resetRequested;
+    JackMeterSnapshot state = {};
+    double meanSquare = 0.0;
+    float peakDecay = 1.0f;
+    uint32_t rmsFrames = 0;
+    float rmsCoefficient = 0.0f;
+    double shelf[5], highpass[5];
+    double filterState[4] = {};
+    uint32_t subblockFrames;
+    uint32_t subblockFill = 0;
+    double subblockEnergy = 0.0;
+    double subblocks[SHORT_TERM_BLOCKS] = {};
+    uint32_t subblockCount = 0;
+    std::vector<uint64_t> gateCounts;
+    std::vector<double> gateEnergy;
+    float history[TRUE_PEAK_TAPS - 1] = {};
+    std::shared_ptr<const JackFFTPlan> plan;
+    std::vector<float> window;
+    uint32_t windowPos = 0;
+    uint32_t windowFill = 0;
+    uint32_t spectrumInterval = 0;
+    uint32_t spectrumCountdown = 0;
+    std::vector<float> smoothed;
+
+    // Published.
+    JackSeqLock<JackMeterSnapshot> snapshot;
+    std::atomic<uint32_t> spectrumSequence;
+    std::unique_ptr<std::atomic<float>[]> spectrum;
+
+    JackMeterTap(JackClient* client, const JackPort* port, JackAnalyzer& analyzer,
+                 const JackMeterOptions& options);
+    void capture(uint32_t nframes);
+    void captureWindows(const float* buffer, uint32_t nframes);
+    void analyze(JackAnalyzerScratch& scratch);
+    void analyzeSamples(const float* src, uint32_t count, JackAnalyzerScratch& scratch);
+    void addSubblock(double energy);
+    float integratedLoudness() const;
+    void transform(JackAnalyzerScratch& scratch);
+    void clear();
+
+   public:
+    JackMeterTap(JackClient* client, JackAudioInputPort& port, JackAnalyzer& analyzer,
+                 const JackMeterOptions& options = JackMeterOptions());
+    JackMeterTap(JackClient* client, JackAudioOutputPort& port, JackAnalyzer& analyzer,
+                 const JackMeterOptions& options = JackMeterOptions());
+    ~JackMeterTap();
+    JackMeterTap(const JackMeterTap&) = delete;
+    JackMeterTap& operator=(const JackMeterTap&) = delete;
+
+    JackMeterSnapshot getSnapshot() const { return snapshot.load(); };
+    /** Number of analyzer passes that published results. */
+    uint32_t getVersion() const { return snapshot.getVersion(); };
+    /** Starts the max values, the integrated loudness and the frame count over. */
+    void reset() { resetRequested.store(true, std::memory_order_relaxed); };
+
+    /** fftSize / 2 + 1 bins from 0 Hz to half the sample rate; 0 without a spectrum. */
+    uint32_t getSpectrumSize() const { return options.fftSize ? options.fftSize / 2 + 1 : 0; };
+    float getBinFrequency(uint32_t bin) const {
+        return options.fftSize ? (float)bin * sampleRate / options.fftSize : 0.0f;
+    };
+    /**
+     * Copies the latest spectrum in dB, where a full-scale sine centred on a
+     * bin reads 0. False if there is none yet.
+     * */
+    bool getSpectrum(std::vector<float>& magnitudes) const;
+};
+
+/**
+ * Shared analysis threads for meter taps. Every interval, a pass hands all
+ * registered taps out to the threads, which take them one at a time, so
+ * hundreds of taps spread over all cores. The threads are ordinary threads
+ * with a raised nice value; they never run in JACK's real-time class, and
+ * a slow pass only delays the results while the taps' buffers last.
+ * Adding or removing a tap waits for the current pass to finish.
+ * */
+class JackAnalyzer {
+    friend class JackMeterTap;
+
+   private:
+    std::chrono::milliseconds interval;
+    int niceness;
+    std::vector<std::thread> threads;
+    std::vector<std::unique_ptr<JackAnalyzerScratch>> scratch;
+
+    std::mutex tapsMutex;
+    std::vector<JackMeterTap*> taps;
+    std::map<uint32_t, std::shared_ptr<const JackFFTPlan>> plans;
+
+    std::mutex passMutex;
+    std::condition_variable passStart;
+    std::condition_variable passEnd;
+    bool running = true;
+    uint64_t pass = 0;
+    uint32_t pending = 0;
+    JackMeterTap* const* passTaps = nullptr;
+    size_t passSize = 0;
+    std::atomic<size_t> nextTap;
+
+    std::atomic<uint64_t> passes;
+    std::atomic<uint64_t> passNanos;
+    std::atomic<uint64_t> maxPassNanos;
+
+    void coordinate();
+    void help(uint32_t worker);
+    void work(uint32_t worker);
+    void lowerPriority();
+    void add(JackMeterTap* tap);
+    void remove(JackMeterTap* tap);
+
+   public:
+    /** threads 0 uses one thread per core. */
+    explicit JackAnalyzer(uint32_t threads = 0, uint32_t intervalMillis = 20, int niceness = 10);
+    ~JackAnalyzer();
+    JackAnalyzer(const JackAnalyzer&) = delete;
+    JackAnalyzer& operator=(const JackAnalyzer&) = delete;
+
+    uint32_t getThreadCount() const { return (uint32_t)threads.size(); };
+    uint64_t getPassCount() const { return passes.load(std::memory_order_relaxed); };
+    /** Wall time of a pass over all taps, average and worst. */
+    float getPassMicros() const;
+    float getMaxPassMicros() const {
+        return maxPassNanos.load(std::memory_order_relaxed) / 1000.0f;
+    };
+};
+#endif
@@ -0,0 +1,220 @@
+#include "mididecoder.h"
+
+#include <cstring>
+
+namespace {
+const JackMIDIMessageType UNDEFINED = JackMIDIMessageType::COUNT;
+
+const JackMIDIMessageType SYSTEM_TYPES[16] = {
+    JackMIDIMessageType::SYSEX,          JackMIDIMessageType::TIME_CODE,
+    JackMIDIMessageType::SONG_POSITION,  JackMIDIMessageType::SONG_SELECT,
+    UNDEFINED,                           UNDEFINED,
+    JackMIDIMessageType::TUNE_REQUEST,   UNDEFINED,
+    JackMIDIMessageType::CLOCK,          UNDEFINED,
+    JackMIDIMessageType::START,          JackMIDIMessageType::CONTINUE,
+    JackMIDIMessageType::STOP,           UNDEFINED,
+    JackMIDIMessageType::ACTIVE_SENSING, JackMIDIMessageType::RESET};
+const uint8_t CHANNEL_LENGTHS[7] = {2, 2, 2, 2, 1, 1, 2};
+const uint8_t SYSTEM_LENGTHS[8] = {0, 1, 2, 1, 0, 0, 0, 0};
+
+inline JackMIDIMessageType typeOf(uint8_t status) {
+    if (status < 0xF0) return (JackMIDIMessageType)((status >> 4) - 8);
+    return SYSTEM_TYPES[status & 15];
+}
+
+inline uint32_t lengthOf(uint8_t status) {
+    if (status < 0xF0) return CHANNEL_LENGTHS[(status >> 4) - 8];
+    return SYSTEM_LENGTHS[status & 7];
+}
+}  // namespace
+
+JackMIDIDispatchTable::JackMIDIDispatchTable() {
+    for (Entry& entry : this->entries) entry = Entry{&JackMIDIDispatchTable::ignore, nullptr};
+}
+
+void JackMIDIDispatchTable::set(JackMIDIMessageType type, Handler handler, void* context) {
+    this->entries[(size_t)type] = Entry{handler, context};
+}
+
+JackMIDIDecoder::JackMIDIDecoder(size_t maxMessages, size_t maxSysExSize)
+    : messages(new JackMIDIMessage[maxMessages]),
+      maxMessages(maxMessages),
+      sysex(new unsigned char[maxSysExSize]),
+      maxSysExSize(maxSysExSize),
+      malformed(0),
+      sysexDropped(0),
+      overflows(0) {
+    this->reset();
+}
+
+void JackMIDIDecoder::reset() {
+    this->count = 0;
+    this->sysexUsed = 0;
+    this->sysexStart = SIZE_MAX;
+    this->sysexEnd = 0;
+    this->sysexOverflow = false;
+    this->runningStatus = 0;
+    for (JackMIDIChannelState& state : this->channels) {
+        std::memset(state.controllers, 0, sizeof(state.controllers));
+        state.program = 0;
+        state.pressure = 0;
+        state.pitchBend = 0;
+    }
+}
+
+void JackMIDIDecoder::beginCycle() {
+    this->count = 0;
+    // Completed SysEx views expire now; keep only the one still being reassembled.
+    if (this->sysexStart != SIZE_MAX && this->sysexStart) {
+        std::memmove(this->sysex.get(), this->sysex.get() + this->sysexStart,
+                     this->sysexEnd - this->sysexStart);
+        this->sysexEnd -= this->sysexStart;
+        this->sysexStart = 0;
+    }
+    this->sysexUsed = 0;
+}
+
+size_t JackMIDIDecoder::decode(const JackMIDIEventRange& events) {
+    this->beginCycle();
+    for (const JackMIDIEvent& event : events)
+        if (event.getMIDIData())
+            this->decodeEvent(event.getTime(), event.getMIDIData(), event.getSize());
+    return this->count;
+}
+
+void JackMIDIDecoder::emit(uint32_t time, uint8_t status, const unsigned char* data,
+                           uint32_t size) {
+    JackMIDIMessageType type = typeOf(status);
+    uint8_t channel = status & 15;
+    if (status < 0xF0) {
+        JackMIDIChannelState& state = this->channels[channel];
+        switch (type) {
+            case JackMIDIMessageType::NOTE_ON:
+                if (!data[1]) type = JackMIDIMessageType::NOTE_OFF;
+                break;
+            case JackMIDIMessageType::CONTROL_CHANGE:
+                state.controllers[data[0]] = data[1];
+                break;
+            case JackMIDIMessageType::PROGRAM_CHANGE:
+                state.program = data[0];
+                break;
+            case JackMIDIMessageType::CHANNEL_PRESSURE:
+                state.pressure = data[0];
+                break;
+            case JackMIDIMessageType::PITCH_BEND:
+                state.pitchBend = (int16_t)((data[1] << 7 | data[0]) - 8192);
+                break;
+            default:
+                break;
+        }
+    } else {
+        channel = 0;
+    }
+    if (this->count == this->maxMessages) {
+        this->overflows.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    this->messages[this->count++] = JackMIDIMessage{time, type, status, channel, size, data};
+}
+
+void JackMIDIDecoder::appendSysEx(const unsigned char* data, size_t size) {
+    if (this->sysexOverflow) return;
+    if (this->sysexEnd + size > this->maxSysExSize) {
+        this->sysexOverflow = true;
+        return;
+    }
+    std::memcpy(this->sysex.get() + this->sysexEnd, data, size);
+    this->sysexEnd += size;
+}
+
+void JackMIDIDecoder::finishSysEx(uint32_t time) {
+    if (this->sysexOverflow) {
+        this->sysexDropped.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        this->emit(time, 0xF0, this->sysex.get() + this->sysexStart,
+                   (uint32_t)(this->sysexEnd - this->sysexStart));
+        this->sysexUsed = this->sysexEnd;
+    }
+    this->sysexStart = SIZE_MAX;
+    this->sysexEnd = this->sysexUsed;
+    this->sysexOverflow = false;
+}
+
+void JackMIDIDecoder::decodeEvent(uint32_t time, const unsigned char* data, size_t size) {
+    size_t i = 0;
+    while (i < size) {
+        uint8_t byte = data[i];
+        if (byte >= 0xF8) {
+            // Real-time messages may appear anywhere, even inside SysEx.
+            if (typeOf(byte) == UNDEFINED)
+                this->malformed.fetch_add(1, std::memory_order_relaxed);
+            else
+                this->emit(time, byte, nullptr, 0);
+            i++;
+            continue;
+        }
+        if (this->sysexStart != SIZE_MAX) {
+            if (byte < 0x80) {
+                size_t j = i;
+                while (j < size && data[j] < 0x80) j++;
+                this->appendSysEx(data + i, j - i);
+                i = j;
+                continue;
+            }
+            if (byte == 0xF7) {
+                this->appendSysEx(data + i, 1);
+                this->finishSysEx(time);
+                i++;
+                continue;
+            }
+            // Any other status byte ends the SysEx without its F7.
+            this->sysexDropped.fetch_add(1, std::memory_order_relaxed);
+            this->sysexStart = SIZE_MAX;
+            this->sysexEnd = this->sysexUsed;
+            this->sysexOverflow = false;
+        }
+        if (byte == 0xF0) {
+            this->runningStatus = 0;
+            size_t j = i + 1;
+            while (j < size && data[j] < 0x80) j++;
+            if (j < size && data[j] == 0xF7) {
+                this->emit(time, 0xF0, data + i, (uint32_t)(j + 1 - i));
+                i = j + 1;
+            } else {
+                this->sysexStart = this->sysexUsed;
+                this->sysexEnd = this->sysexUsed;
+                this->appendSysEx(data + i, 1);
+                i++;
+            }
+            continue;
+        }
+        uint8_t status;
+        if (byte & 0x80) {
+            status = byte;
+            i++;
+            if (status == 0xF7 || typeOf(status) == UNDEFINED) {
+                this->runningStatus = 0;
+                this->malformed.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            this->runningStatus = status < 0xF0 ? status : 0;
+        } else if (this->runningStatus) {
+            status = this->runningStatus;
+        } else {
+            this->malformed.fetch_add(1, std::memory_order_relaxed);
+            i++;
+            continue;
+        }
+        uint32_t length = lengthOf(status);
+        uint32_t available = 0;
+        while (available < length && i + available < size && data[i + available] < 0x80)
+            available++;
+        if (available < length) {
+            this->malformed.fetch_add(1, std::memory_order_relaxed);
+            i += available;
+            continue;
+        }
+        this->emit(time, status, length ? data + i : nullptr, length);
+        i += length;
+    }
+}
@@ -0,0 +1,176 @@
+#ifndef _JACKCLIENT_MIDIDECODER_H
+#define _JACKCLIENT_MIDIDECODER_H
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+
+#include "jackclient.h"
+
+enum class JackMIDIMessageType : uint8_t {
+    NOTE_OFF,
+    NOTE_ON,
+    POLY_PRESSURE,
+    CONTROL_CHANGE,
+    PROGRAM_CHANGE,
+    CHANNEL_PRESSURE,
+    PITCH_BEND,
+    SYSEX,
+    TIME_CODE,
+    SONG_POSITION,
+    SONG_SELECT,
+    TUNE_REQUEST,
+    CLOCK,
+    START,
+    CONTINUE,
+    STOP,
+    ACTIVE_SENSING,
+    RESET,
+    COUNT
+};
+
+/**
+ * Typed view of one decoded message. data points at the data bytes, after
+ * the status byte, either inside the JACK buffer or, for SysEx reassembled
+ * across events, inside the decoder; SysEx views span F0 to F7. Views are
+ * valid until the next call to JackMIDIDecoder::decode().
+ * */
+struct JackMIDIMessage {
+    uint32_t time;
+    JackMIDIMessageType type;
+    uint8_t status;
+    uint8_t channel;
+    uint32_t size;
+    const unsigned char* data;
+
+    uint8_t getNote() const { return data[0]; };
+    /** 0 for note-ons sent with velocity 0, which are decoded as NOTE_OFF. */
+    uint8_t getVelocity() const { return data[1]; };
+    uint8_t getController() const { return data[0]; };
+    uint8_t getValue() const { return data[1]; };
+    uint8_t getProgram() const { return data[0]; };
+    uint8_t getPressure() const {
+        return type == JackMIDIMessageType::POLY_PRESSURE ? data[1] : data[0];
+    };
+    /** -8192 ... 8191. */
+    int16_t getPitchBend() const { return (int16_t)((data[1] << 7 | data[0]) - 8192); };
+    /** In MIDI beats (sixteenth notes). */
+    uint16_t getSongPosition() const { return (uint16_t)(data[1] << 7 | data[0]); };
+};
+
+/**
+ * Last values seen on one channel. With MPE every note has a channel of its
+ * own, so pitchBend, pressure and getTimbre() are the per-note dimensions.
+ * */
+struct JackMIDIChannelState {
+    uint8_t controllers[128];
+    uint8_t program;
+    uint8_t pressure;
+    int16_t pitchBend;
+
+    /** MPE timbre (slide), sent as CC 74. */
+    uint8_t getTimbre() const { return controllers[74]; };
+};
+
+/**
+ * Handlers per message type, called in order for a decoded batch. Slots
+ * without a handler point at a no-op, so dispatch is one indirect call per
+ * message and no branch or virtual call.
+ * */
+class JackMIDIDispatchTable {
+   public:
+    typedef void (*Handler)(void* context, const JackMIDIMessage& message);
+
+   private:
+    struct Entry {
+        Handler handler;
+        void* context;
+    };
+    Entry entries[(size_t)JackMIDIMessageType::COUNT];
+
+    static void ignore(void*, const JackMIDIMessage&){};
+    template <typename T, void (T::*Method)(const JackMIDIMessage&)>
+    static void call(void* context, const JackMIDIMessage& message) {
+        (static_cast<T*>(context)->*Method)(message);
+    };
+
+   public:
+    JackMIDIDispatchTable();
+    void set(JackMIDIMessageType type, Handler handler, void* context = nullptr);
+    /** Binds a member function, e.g. set<Synth, &Synth::noteOn>(NOTE_ON, synth). */
+    template <typename T, void (T::*Method)(const JackMIDIMessage&)>
+    void set(JackMIDIMessageType type, T& object) {
+        this->set(type, &JackMIDIDispatchTable::call<T, Method>, &object);
+    };
+    void clear(JackMIDIMessageType type) { this->set(type, &JackMIDIDispatchTable::ignore); };
+    void dispatch(const JackMIDIMessage* messages, size_t count) const {
+        for (size_t i = 0; i < count; i++) {
+            const Entry& entry = entries[(size_t)messages[i].type];
+            entry.handler(entry.context, messages[i]);
+        }
+    };
+};
+
+/**
+ * Decodes the events of a MIDI input buffer into typed message views
+ * without copying. Running status is tracked across events and cycles, and
+ * SysEx split across events or cycles is reassembled into a buffer
+ * allocated up front; a SysEx that arrives whole in one event is returned
+ * in place. Each event may hold several messages. Malformed bytes are
+ * skipped and counted. Process thread only, apart from the counters.
+ * */
+class JackMIDIDecoder {
+   private:
+    std::unique_ptr<JackMIDIMessage[]> messages;
+    size_t maxMessages;
+    size_t count = 0;
+    std::unique_ptr<unsigned char[]> sysex;
+    size_t maxSysExSize;
+    /** Bytes of SysEx completed in the current decode. */
+    size_t sysexUsed = 0;
+    /** Start of the SysEx being reassembled, or SIZE_MAX. */
+    size_t sysexStart = SIZE_MAX;
+    size_t sysexEnd = 0;
+    bool sysexOverflow = false;
+    uint8_t runningStatus = 0;
+    JackMIDIChannelState channels[16];
+    std::atomic<uint64_t> malformed;
+    std::atomic<uint64_t> sysexDropped;
+    std::atomic<uint64_t> overflows;
+
+    void emit(uint32_t time, uint8_t status, const unsigned char* data, uint32_t size);
+    void appendSysEx(const unsigned char* data, size_t size);
+    void finishSysEx(uint32_t time);
+
+   public:
+    explicit JackMIDIDecoder(size_t maxMessages = 1024, size_t maxSysExSize = 4096);
+
+    /** Decodes one cycle and returns the number of messages. */
+    size_t decode(const JackMIDIEventRange& events);
+    size_t decode(JackMIDIInputPort& port) { return this->decode(port.getEvents()); };
+    /** Decodes a single event on top of the current batch; for buffers not owned by JACK. */
+    void decodeEvent(uint32_t time, const unsigned char* data, size_t size);
+    /** Empties the batch without touching running status or pending SysEx. */
+    void beginCycle();
+    /** Forgets running status, pending SysEx and channel state. */
+    void reset();
+
+    const JackMIDIMessage* begin() const { return messages.get(); };
+    const JackMIDIMessage* end() const { return messages.get() + count; };
+    size_t size() const { return count; };
+    const JackMIDIMessage& operator[](size_t index) const { return messages[index]; };
+    void dispatch(const JackMIDIDispatchTable& table) const {
+        table.dispatch(messages.get(), count);
+    };
+    const JackMIDIChannelState& getChannelState(uint8_t channel) const {
+        return channels[channel & 15];
+    };
+
+    /** Stray data bytes, truncated messages and undefined status bytes. */
+    uint64_t getMalformedCount() const { return malformed.load(std::memory_order_relaxed); };
+    /** SysEx messages larger than the reassembly buffer or cut off by another status byte. */
+    uint64_t getSysExDroppedCount() const { return sysexDropped.load(std::memory_order_relaxed); };
+    /** Messages not returned because the batch was full. */
+    uint64_t getOverflowCount() const { return overflows.load(std::memory_order_relaxed); };
+};
+#endif
@@ -0,0 +1,100 @@
+#include "midischeduler.h"
+
+#include <algorithm>
+#include <cstring>
+
+JackMIDIScheduler::JackMIDIScheduler(JackClient& client, JackMIDIOutputPort& port,
+                                     size_t capacity)
+    : client(&client),
+      port(&port),
+      pool(capacity),
+      inbox(capacity),
+      late(0),
+      deferred(0),
+      dropped(0) {
+    this->heap.reserve(capacity);
+    this->freeSlots.reserve(capacity);
+    for (size_t i = capacity; i > 0; i--) this->freeSlots.push_back((uint32_t)(i - 1));
+}
+
+bool JackMIDIScheduler::schedule(uint32_t time, const unsigned char* data, size_t size) {
+    if (size > JackScheduledMIDIEvent::MAX_SIZE)
+        throw JackClientException("MIDI message too large for the scheduler");
+    JackScheduledMIDIEvent event;
+    event.time = time;
+    event.size = (uint32_t)size;
+    std::memcpy(event.data, data, size);
+    if (this->inbox.write(&event, 1)) return true;
+    this->dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+bool JackMIDIScheduler::insert(uint32_t time, const unsigned char* data, size_t size) {
+    if (size > JackScheduledMIDIEvent::MAX_SIZE || this->freeSlots.empty()) {
+        this->dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    uint32_t slot = this->freeSlots.back();
+    this->freeSlots.pop_back();
+    JackScheduledMIDIEvent& event = this->pool[slot];
+    event.time = time;
+    event.size = (uint32_t)size;
+    std::memcpy(event.data, data, size);
+    this->heap.push_back(Key{time, this->sequence++, slot});
+    std::push_heap(this->heap.begin(), this->heap.end(), Later());
+    return true;
+}
+
+void JackMIDIScheduler::drainInbox() {
+    JackRingBufferState::Vector vec = this->inbox.getReadVector();
+    const JackScheduledMIDIEvent* data = this->inbox.getData();
+    for (const JackRingBufferState::Segment& segment : {vec.first, vec.second}) {
+        for (size_t i = 0; i < segment.size; i++) {
+            const JackScheduledMIDIEvent& event = data[segment.offset + i];
+            this->insert(event.time, event.data, event.size);
+        }
+    }
+    this->inbox.commitRead(vec.size());
+}
+
+void JackMIDIScheduler::process(const JackPortBuffers& buffers, uint32_t nframes) {
+    this->drainInbox();
+    void* buffer = buffers.getBuffer(*this->port);
+    uint32_t cycleStart = this->client->getCycleStartTime();
+    while (!this->heap.empty()) {
+        const Key key = this->heap.front();
+        int32_t offset = (int32_t)(key.time - cycleStart);
+        if (offset >= (int32_t)nframes) break;
+        bool late = offset < 0;
+        if (late) offset = 0;
+        const JackScheduledMIDIEvent& event = this->pool[key.slot];
+        jack_midi_data_t* dst = jack_midi_event_reserve(buffer, offset, event.size);
+        if (!dst && jack_midi_get_event_count(buffer)) {
+            // The buffer is full for this cycle; the rest goes out first thing next cycle.
+            this->deferred.fetch_add(1, std::memory_order_relaxed);
+            break;
+        }
+        if (dst) {
+            std::memcpy(dst, event.data, event.size);
+            // Counted once it is written, not again for every cycle it is deferred.
+            if (late) this->late.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            this->dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+        std::pop_heap(this->heap.begin(), this->heap.end(), Later());
+        this->heap.pop_back();
+        this->freeSlots.push_back(key.slot);
+    }
+}
+
+void JackMIDIScheduler::clear() {
+    this->drainInbox();
+    for (const Key& key : this->heap) this->freeSlots.push_back(key.slot);
+    this->heap.clear();
+}
+
+void JackMIDIScheduler::resetCounters() {
+    this->late.store(0, std::memory_order_relaxed);
+    this->deferred.store(0, std::memory_order_relaxed);
+    this->dropped.store(0, std::memory_order_relaxed);
+}
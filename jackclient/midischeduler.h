@@ -0,0 +1,99 @@
+#ifndef _JACKCLIENT_MIDISCHEDULER_H
+#define _JACKCLIENT_MIDISCHEDULER_H
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "jackclient.h"
+#include "ringbuffer.h"
+
+/** A MIDI message waiting for its cycle; time is an absolute frame time. */
+struct JackScheduledMIDIEvent {
+    static const size_t MAX_SIZE = 24;
+
+    uint32_t time;
+    uint32_t size;
+    unsigned char data[MAX_SIZE];
+};
+
+/**
+ * Sample-accurate output of MIDI events scheduled any number of cycles
+ * ahead. Event times are absolute frame times (see
+ * JackClient::getFrameTime() and getCycleStartTime()). Pending events are
+ * kept in a binary heap of small keys ordered by time and then by order of
+ * scheduling, with the messages themselves in a pool; both are allocated
+ * up front. Call process() once per cycle from onProcess: it writes the
+ * events due in the current period in place with jack_midi_event_reserve.
+ *
+ * Events that cannot be written are counted, never dropped silently:
+ * events due before the current cycle are written at offset 0 and counted
+ * as late, events that do not fit in a full port buffer are deferred to
+ * the next cycle, and events that do not fit in the scheduler, or in an
+ * empty port buffer, are dropped and counted.
+ *
+ * The port should not receive other events in the same cycle, since JACK
+ * requires events in a buffer to be written in time order.
+ * */
+class JackMIDIScheduler {
+   private:
+    struct Key {
+        uint32_t time;
+        uint32_t sequence;
+        uint32_t slot;
+    };
+    struct Later {
+        bool operator()(const Key& a, const Key& b) const {
+            int32_t diff = (int32_t)(a.time - b.time);
+            if (diff) return diff > 0;
+            return (int32_t)(a.sequence - b.sequence) > 0;
+        };
+    };
+
+    JackClient* client;
+    JackMIDIOutputPort* port;
+    std::vector<Key> heap;
+    std::vector<JackScheduledMIDIEvent> pool;
+    std::vector<uint32_t> freeSlots;
+    uint32_t sequence = 0;
+    JackRingBuffer<JackScheduledMIDIEvent> inbox;
+    std::atomic<uint64_t> late;
+    std::atomic<uint64_t> deferred;
+    std::atomic<uint64_t> dropped;
+
+    void drainInbox();
+
+   public:
+    JackMIDIScheduler(JackClient& client, JackMIDIOutputPort& port, size_t capacity = 4096);
+
+    /**
+     * Schedules an event from one producer thread other than the process
+     * thread. Real-time safe; false if the event was dropped because the
+     * queue to the process thread is full.
+     * */
+    bool schedule(uint32_t time, const unsigned char* data, size_t size);
+    /**
+     * Schedules an event from the process thread. Never throws; false if the
+     * scheduler is full or the event is larger than
+     * JackScheduledMIDIEvent::MAX_SIZE, and the event is counted as dropped.
+     * */
+    bool insert(uint32_t time, const unsigned char* data, size_t size);
+    /** Writes the events due in the current cycle; call once per cycle. */
+    void process(const JackPortBuffers& buffers, uint32_t nframes);
+    /** Discards all pending events; process thread only. */
+    void clear();
+
+    /** Events waiting in the heap; process thread only. */
+    size_t getPendingCount() const { return heap.size(); };
+    size_t getCapacity() const { return pool.size(); };
+    /** Events written at offset 0 because their time had already passed. */
+    uint64_t getLateCount() const { return late.load(std::memory_order_relaxed); };
+    /** Cycles that left due events for the next cycle because the port buffer was full. */
+    uint64_t getDeferredCount() const { return deferred.load(std::memory_order_relaxed); };
+    /**
+     * Events lost because the scheduler was full, insert() got one that was
+     * too large, or they exceed an empty port buffer.
+     * */
+    uint64_t getDroppedCount() const { return dropped.load(std::memory_order_relaxed); };
+    void resetCounters();
+};
+#endif
@@ -0,0 +1,174 @@
+#include "offlinerender.h"
+
+#include <chrono>
+#include <exception>
+#include <thread>
+
+#include "portgraph.h"
+
+JackOfflineRenderer::JackOfflineRenderer(const char* name, double bufferSeconds,
+                                         uint32_t batchFrames)
+    : JackClient(name),
+      bufferSeconds(bufferSeconds),
+      batchFrames(batchFrames ? batchFrames : 1),
+      capturing(false),
+      finished(false),
+      captured(0),
+      written(0),
+      dropped(0) {
+    this->open();
+    if (this->getState() == JackState::CLOSED)
+        throw JackClientException("Could not open render client");
+}
+
+JackOfflineRenderer::~JackOfflineRenderer() { this->close(); }
+
+void JackOfflineRenderer::addSource(const std::string& portName) {
+    std::string name = "in_" + std::to_string(this->inputs.size() + 1);
+    this->inputs.push_back(this->createAudioInputPort(name.c_str()));
+    this->sources.push_back(portName);
+}
+
+void JackOfflineRenderer::addSource(JackAudioOutputPort& port) { this->addSource(port.getName()); }
+
+void JackOfflineRenderer::connectSources() {
+    std::shared_ptr<const JackPortGraphSnapshot> graph = this->getPortGraph();
+    for (size_t i = 0; i < this->sources.size(); i++) {
+        const JackPortGraphSnapshot::Port* port = graph->find(this->sources[i]);
+        if (!port || port->type != JackPortType::AUDIO || !(port->flags & JackPortIsOutput))
+            throw JackClientException("No audio output port named " + this->sources[i]);
+        JackAudioOutputPort source(this, port->handle);
+        this->inputs[i]->connectTo(source);
+    }
+}
+
+int JackOfflineRenderer::onProcess(const JackPortBuffers& buffers, uint32_t nframes) {
+    if (!this->capturing.load(std::memory_order_acquire)) return 0;
+    Transport::JackPosition pos;
+    if (this->getTransportPosition(pos) != Transport::JackTransportState::ROLLING) return 0;
+    uint64_t from = pos.frame;
+    uint64_t to = from + nframes;
+    if (to <= this->startFrame) return 0;
+    if (from >= this->endFrame) {
+        this->finished.store(true, std::memory_order_release);
+        return 0;
+    }
+    uint32_t offset = from < this->startFrame ? (uint32_t)(this->startFrame - from) : 0;
+    uint32_t count = (uint32_t)((to < this->endFrame ? to : this->endFrame) - from) - offset;
+    for (size_t c = 0; c < this->inputs.size(); c++)
+        this->block[c] = buffers.getBuffer(*this->inputs[c]) + offset;
+    if (this->ring->write(this->block.data(), count))
+        this->captured.fetch_add(count, std::memory_order_relaxed);
+    else
+        this->dropped.fetch_add(count, std::memory_order_relaxed);
+    if (to >= this->endFrame) this->finished.store(true, std::memory_order_release);
+    return 0;
+}
+
+JackRenderResult JackOfflineRenderer::render(const std::string& path, uint32_t start, uint32_t end,
+                                             JackSampleFormat format) {
+    if (this->inputs.empty()) throw JackClientException("Nothing to render: no sources added");
+    if (end <= start) throw JackClientException("Render end frame must be after the start frame");
+    uint32_t channels = (uint32_t)this->inputs.size();
+    uint32_t sampleRate = this->getSampleRate();
+    this->ring.reset(new JackAudioRingBuffer(channels, (size_t)(this->bufferSeconds * sampleRate)));
+    this->block.assign(channels, nullptr);
+    this->startFrame = start;
+    this->endFrame = end;
+    this->finished.store(false, std::memory_order_relaxed);
+    this->captured.store(0, std::memory_order_relaxed);
+    this->written.store(0, std::memory_order_relaxed);
+    this->dropped.store(0, std::memory_order_relaxed);
+
+    JackWavWriter writer(path, channels, sampleRate, format);
+    this->activate();
+    this->connectSources();
+    this->stopTransport();
+    this->setTransportPosition(start);
+
+    std::atomic<bool> writing(true);
+    std::atomic<bool> failed(false);
+    std::exception_ptr error;
+    std::thread writerThread([this, &writer, &writing, &failed, &error, channels]() {
+        std::vector<float> scratch((size_t)channels * this->batchFrames);
+        std::vector<float*> planes(channels);
+        for (uint32_t c = 0; c < channels; c++) planes[c] = scratch.data() + c * this->batchFrames;
+        try {
+            for (;;) {
+                bool more = writing.load(std::memory_order_acquire);
+                size_t available = this->ring->getReadSpace();
+                if (!available) {
+                    if (!more) break;
+                    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                    continue;
+                }
+                uint32_t count =
+                    available < this->batchFrames ? (uint32_t)available : this->batchFrames;
+                this->ring->read(planes.data(), count);
+                writer.write(planes.data(), count);
+                this->written.fetch_add(count, std::memory_order_relaxed);
+            }
+        } catch (...) {
+            error = std::current_exception();
+            failed.store(true, std::memory_order_release);
+        }
+    });
+
+    JackRenderResult result = {};
+    size_t capacity = this->ring->getCapacity();
+    bool freewheeling = false;
+    auto wallStart = std::chrono::steady_clock::now();
+    std::exception_ptr controlError;
+    try {
+        this->capturing.store(true, std::memory_order_release);
+        this->startFreewheel();
+        freewheeling = true;
+        wallStart = std::chrono::steady_clock::now();
+        this->startTransport();
+        while (!this->finished.load(std::memory_order_acquire)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            if (this->getState() == JackState::CLOSED || failed.load(std::memory_order_acquire))
+                break;
+            if (this->captured.load(std::memory_order_relaxed) &&
+                this->getTransportState() == Transport::JackTransportState::STOPPED)
+                break;
+            // Throttle instead of blocking the process thread: realtime cycles give the
+            // writer time to drain the ring before freewheeling resumes.
+            size_t fill = this->captured.load(std::memory_order_relaxed) -
+                          this->written.load(std::memory_order_relaxed);
+            if (freewheeling && fill > capacity * 3 / 4) {
+                this->stopFreewheel();
+                freewheeling = false;
+                result.throttles++;
+            } else if (!freewheeling && fill < capacity / 4) {
+                this->startFreewheel();
+                freewheeling = true;
+            }
+        }
+    } catch (...) {
+        controlError = std::current_exception();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - wallStart;
+    result.complete = this->finished.load(std::memory_order_acquire);
+    this->capturing.store(false, std::memory_order_release);
+    if (this->getState() != JackState::CLOSED) {
+        this->stopTransport();
+        try {
+            if (freewheeling) this->stopFreewheel();
+        } catch (JackClientException&) {
+        }
+        for (auto& input : this->inputs) input->disconnectAll();
+    }
+    writing.store(false, std::memory_order_release);
+    writerThread.join();
+    if (error) std::rethrow_exception(error);
+    if (controlError) std::rethrow_exception(controlError);
+    writer.close();
+
+    result.frames = writer.getFrameCount();
+    result.droppedFrames = this->dropped.load(std::memory_order_relaxed);
+    result.seconds = elapsed.count();
+    result.realtimeFactor =
+        result.seconds > 0.0 ? (double)result.frames / sampleRate / result.seconds : 0.0;
+    return result;
+}
@@ -0,0 +1,74 @@
+#ifndef _JACKCLIENT_OFFLINERENDER_H
+#define _JACKCLIENT_OFFLINERENDER_H
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "jackclient.h"
+#include "ringbuffer.h"
+#include "wavfile.h"
+
+struct JackRenderResult {
+    /** Frames written to the file. */
+    uint64_t frames;
+    /** Frames lost because the writer fell behind; non-zero means the file has gaps. */
+    uint64_t droppedFrames;
+    /** False if the transport stopped or the server went away before the end frame. */
+    bool complete;
+    /** Wall clock time from starting the transport to reaching the end frame. */
+    double seconds;
+    /** Rendered audio duration divided by seconds. */
+    double realtimeFactor;
+    /** Number of times freewheeling was paused to let the writer catch up. */
+    uint32_t throttles;
+};
+
+/**
+ * Client that bounces other clients' output ports to a WAV/RF64 file at
+ * freewheel speed. It rolls the transport from a start frame, copies each
+ * cycle's input into a lock-free ring buffer and lets a background thread
+ * write the file in large blocks. The process thread never waits on the
+ * writer: when the ring fills up past a high watermark freewheeling is
+ * switched off until the writer has caught up.
+ * */
+class JackOfflineRenderer : public JackClient {
+   private:
+    std::vector<std::unique_ptr<JackAudioInputPort>> inputs;
+    std::vector<std::string> sources;
+    std::vector<const float*> block;
+    std::unique_ptr<JackAudioRingBuffer> ring;
+    double bufferSeconds;
+    uint32_t batchFrames;
+    uint32_t startFrame = 0;
+    uint32_t endFrame = 0;
+    std::atomic<bool> capturing;
+    std::atomic<bool> finished;
+    std::atomic<uint64_t> captured;
+    std::atomic<uint64_t> written;
+    std::atomic<uint64_t> dropped;
+
+    void connectSources();
+
+   protected:
+    int onProcess(const JackPortBuffers& buffers, uint32_t nframes);
+
+   public:
+    /** bufferSeconds: ring buffer length, batchFrames: frames handed to the file per write. */
+    JackOfflineRenderer(const char* name = "offline_render", double bufferSeconds = 8.0,
+                        uint32_t batchFrames = 65536);
+    ~JackOfflineRenderer();
+    /** Adds a channel recording the given output port, e.g. "mixer:out_L". */
+    void addSource(const std::string& portName);
+    void addSource(JackAudioOutputPort& port);
+    size_t getChannelCount() const { return inputs.size(); };
+    /**
+     * Renders transport frames [start, end) of all sources to path and
+     * blocks until done. The transport is left stopped and freewheeling off.
+     * */
+    JackRenderResult render(const std::string& path, uint32_t start, uint32_t end,
+                            JackSampleFormat format = JackSampleFormat::FLOAT32);
+    /** Frames captured so far by a running render; readable from any thread. */
+    uint64_t getCapturedFrames() const { return captured.load(std::memory_order_relaxed); };
+};
+#endif
@@ -0,0 +1,324 @@
+#include "portgraph.h"
+
+#include <algorithm>
+#include <cstring>
+
+constexpr int JackPortGraphSnapshot::SELECT_FLAGS;
+
+const JackPortGraphSnapshot::Port* JackPortGraphSnapshot::find(const std::string& name) const {
+    auto it = this->byName.find(name);
+    return it == this->byName.end() ? nullptr : &this->ports[it->second];
+}
+
+const JackPortGraphSnapshot::Port* JackPortGraphSnapshot::find(jack_port_t* handle) const {
+    auto it = this->byHandle.find(handle);
+    return it == this->byHandle.end() ? nullptr : &this->ports[it->second];
+}
+
+const std::vector<uint32_t>& JackPortGraphSnapshot::select(JackPortType type, int flags) const {
+    return this->selections[type == JackPortType::MIDI][flags & SELECT_FLAGS];
+}
+
+JackPortGraph::JackPortGraph(jack_client_t* client)
+    : client(client), snapshot(std::make_shared<JackPortGraphSnapshot>()) {
+    jack_set_port_registration_callback(client, &JackPortGraph::port_registration_callback, this);
+    jack_set_port_connect_callback(client, &JackPortGraph::port_connect_callback, this);
+    jack_set_port_rename_callback(client, &JackPortGraph::port_rename_callback, this);
+    jack_set_client_registration_callback(client, &JackPortGraph::client_registration_callback,
+                                          this);
+    this->refresh();
+    this->updater = std::thread(&JackPortGraph::run, this);
+}
+
+JackPortGraph::~JackPortGraph() { this->stop(); }
+
+void JackPortGraph::stop() {
+    {
+        std::lock_guard<std::mutex> lock(this->eventsMutex);
+        this->running = false;
+    }
+    this->eventsWakeup.notify_all();
+    if (this->updater.joinable()) this->updater.join();
+}
+
+std::shared_ptr<const JackPortGraphSnapshot> JackPortGraph::getSnapshot() const {
+    return std::atomic_load(&this->snapshot);
+}
+
+void JackPortGraph::port_registration_callback(jack_port_id_t id, int reg, void* arg) {
+    JackPortGraph* graph = static_cast<JackPortGraph*>(arg);
+    jack_port_t* handle = jack_port_by_id(graph->client, id);
+    if (!handle) return;
+    graph->push({reg ? EventType::PORT_REGISTERED : EventType::PORT_UNREGISTERED, handle, nullptr,
+                 std::string()});
+}
+
+void JackPortGraph::port_connect_callback(jack_port_id_t a, jack_port_id_t b, int connect,
+                                          void* arg) {
+    JackPortGraph* graph = static_cast<JackPortGraph*>(arg);
+    jack_port_t* portA = jack_port_by_id(graph->client, a);
+    jack_port_t* portB = jack_port_by_id(graph->client, b);
+    if (!portA || !portB) return;
+    graph->push({connect ? EventType::CONNECTED : EventType::DISCONNECTED, portA, portB,
+                 std::string()});
+}
+
+int JackPortGraph::port_rename_callback(jack_port_id_t id, const char* oldName,
+                                        const char* newName, void* arg) {
+    JackPortGraph* graph = static_cast<JackPortGraph*>(arg);
+    jack_port_t* handle = jack_port_by_id(graph->client, id);
+    if (handle) graph->push({EventType::RENAMED, handle, nullptr, std::string(newName)});
+    return 0;
+}
+
+void JackPortGraph::client_registration_callback(const char* name, int reg, void* arg) {
+    static_cast<JackPortGraph*>(arg)->push(
+        {reg ? EventType::CLIENT_REGISTERED : EventType::CLIENT_UNREGISTERED, nullptr, nullptr,
+         std::string(name)});
+}
+
+void JackPortGraph::push(Event event) {
+    {
+        std::lock_guard<std::mutex> lock(this->eventsMutex);
+        if (!this->running) return;
+        this->events.push_back(std::move(event));
+    }
+    this->eventsWakeup.notify_one();
+}
+
+void JackPortGraph::run() {
+    std::vector<Event> batch;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(this->eventsMutex);
+            this->eventsWakeup.wait(lock,
+                                    [this]() { return !this->running || !this->events.empty(); });
+            if (!this->running) return;
+            batch.swap(this->events);
+        }
+        bool recompute = false;
+        {
+            std::lock_guard<std::mutex> lock(this->modelMutex);
+            for (const Event& event : batch) {
+                if (event.type == EventType::RECOMPUTE_LATENCIES)
+                    recompute = true;
+                else
+                    this->apply(event);
+            }
+            this->publish();
+        }
+        batch.clear();
+        if (recompute) jack_recompute_total_latencies(this->client);
+    }
+}
+
+void JackPortGraph::requestLatencyRecompute() {
+    this->push({EventType::RECOMPUTE_LATENCIES, nullptr, nullptr, std::string()});
+}
+
+bool JackPortGraph::addPort(jack_port_t* handle) {
+    // Own ports are added before their registration callback arrives.
+    if (this->model.count(handle)) return true;
+    const char* type = jack_port_type(handle);
+    PortRecord record;
+    if (!type) return false;
+    if (!std::strcmp(type, JACK_DEFAULT_AUDIO_TYPE))
+        record.type = JackPortType::AUDIO;
+    else if (!std::strcmp(type, JACK_DEFAULT_MIDI_TYPE))
+        record.type = JackPortType::MIDI;
+    else
+        return false;
+    record.order = this->nextOrder++;
+    record.name = jack_port_name(handle);
+    record.flags = jack_port_flags(handle);
+    this->model[handle] = std::move(record);
+    return true;
+}
+
+bool JackPortGraph::link(jack_port_t* a, jack_port_t* b, bool connect) {
+    auto portA = this->model.find(a);
+    auto portB = this->model.find(b);
+    if (portA == this->model.end() || portB == this->model.end()) return false;
+    if (connect) {
+        portA->second.connections.insert(b);
+        portB->second.connections.insert(a);
+    } else {
+        portA->second.connections.erase(b);
+        portB->second.connections.erase(a);
+    }
+    return true;
+}
+
+static std::pair<jack_port_t*, jack_port_t*> edgeKey(jack_port_t* a, jack_port_t* b) {
+    return a < b ? std::make_pair(a, b) : std::make_pair(b, a);
+}
+
+void JackPortGraph::expectEcho(jack_port_t* a, jack_port_t* b) { this->echoes[edgeKey(a, b)]++; }
+
+void JackPortGraph::applyOwn(const char* source, const char* destination, bool connect) {
+    // The snapshot is published under the same lock, so it matches the model.
+    const JackPortGraphSnapshot::Port* a = this->snapshot->find(source);
+    const JackPortGraphSnapshot::Port* b = this->snapshot->find(destination);
+    if (!a || !b || !this->link(a->handle, b->handle, connect)) return;
+    this->expectEcho(a->handle, b->handle);
+    this->publish();
+}
+
+int JackPortGraph::connect(const char* source, const char* destination) {
+    std::lock_guard<std::mutex> lock(this->modelMutex);
+    int error = jack_connect(this->client, source, destination);
+    if (!error) this->applyOwn(source, destination, true);
+    return error;
+}
+
+int JackPortGraph::disconnect(const char* source, const char* destination) {
+    std::lock_guard<std::mutex> lock(this->modelMutex);
+    int error = jack_disconnect(this->client, source, destination);
+    if (!error) this->applyOwn(source, destination, false);
+    return error;
+}
+
+int JackPortGraph::disconnectAll(jack_port_t* handle) {
+    std::lock_guard<std::mutex> lock(this->modelMutex);
+    int error = jack_port_disconnect(this->client, handle);
+    auto it = this->model.find(handle);
+    if (error || it == this->model.end() || it->second.connections.empty()) return error;
+    std::set<jack_port_t*> peers;
+    peers.swap(it->second.connections);
+    for (jack_port_t* other : peers) {
+        this->link(handle, other, false);
+        this->expectEcho(handle, other);
+    }
+    this->publish();
+    return 0;
+}
+
+void JackPortGraph::addOwnPort(jack_port_t* handle) {
+    std::lock_guard<std::mutex> lock(this->modelMutex);
+    if (!this->model.count(handle) && this->addPort(handle)) this->publish();
+}
+
+void JackPortGraph::apply(const Event& event) {
+    switch (event.type) {
+        case EventType::PORT_REGISTERED:
+            this->addPort(event.a);
+            break;
+        case EventType::PORT_UNREGISTERED: {
+            auto it = this->model.find(event.a);
+            if (it == this->model.end()) break;
+            for (jack_port_t* other : it->second.connections) {
+                auto peer = this->model.find(other);
+                if (peer != this->model.end()) peer->second.connections.erase(event.a);
+            }
+            this->model.erase(it);
+            for (auto echo = this->echoes.begin(); echo != this->echoes.end();)
+                echo = echo->first.first == event.a || echo->first.second == event.a
+                           ? this->echoes.erase(echo)
+                           : std::next(echo);
+            break;
+        }
+        case EventType::CONNECTED:
+        case EventType::DISCONNECTED: {
+            auto echo = this->echoes.find(edgeKey(event.a, event.b));
+            if (echo != this->echoes.end()) {
+                // Already applied when the client made the change.
+                if (--echo->second == 0) this->echoes.erase(echo);
+                break;
+            }
+            this->link(event.a, event.b, event.type == EventType::CONNECTED);
+            break;
+        }
+        case EventType::RENAMED: {
+            auto it = this->model.find(event.a);
+            if (it != this->model.end()) it->second.name = event.name;
+            break;
+        }
+        case EventType::CLIENT_REGISTERED:
+            this->clients.insert(event.name);
+            break;
+        case EventType::CLIENT_UNREGISTERED: {
+            // A client that went away may not report its ports individually.
+            this->clients.erase(event.name);
+            std::string prefix = event.name + ":";
+            std::vector<jack_port_t*> gone;
+            for (auto& entry : this->model)
+                if (!entry.second.name.compare(0, prefix.size(), prefix))
+                    gone.push_back(entry.first);
+            for (jack_port_t* handle : gone) this->apply({EventType::PORT_UNREGISTERED, handle});
+            break;
+        }
+        case EventType::RECOMPUTE_LATENCIES:
+            // Handled by run(), outside the model lock.
+            break;
+    }
+}
+
+void JackPortGraph::refresh() {
+    std::lock_guard<std::mutex> lock(this->modelMutex);
+    this->model.clear();
+    this->clients.clear();
+    this->echoes.clear();
+    const char** names = jack_get_ports(this->client, NULL, NULL, 0);
+    if (names) {
+        for (size_t i = 0; names[i]; i++) {
+            jack_port_t* handle = jack_port_by_name(this->client, names[i]);
+            if (handle) this->addPort(handle);
+        }
+        jack_free(names);
+    }
+    for (auto& entry : this->model) {
+        const char** connections = jack_port_get_all_connections(this->client, entry.first);
+        if (!connections) continue;
+        for (size_t i = 0; connections[i]; i++) {
+            jack_port_t* other = jack_port_by_name(this->client, connections[i]);
+            if (this->model.count(other)) entry.second.connections.insert(other);
+        }
+        jack_free(connections);
+    }
+    for (auto& entry : this->model) {
+        const std::string& name = entry.second.name;
+        this->clients.insert(name.substr(0, name.find(':')));
+    }
+    this->publish();
+}
+
+void JackPortGraph::publish() {
+    std::shared_ptr<JackPortGraphSnapshot> next = std::make_shared<JackPortGraphSnapshot>();
+    next->version = ++this->version;
+    next->ports.reserve(this->model.size());
+    std::vector<const Model::value_type*> ordered;
+    ordered.reserve(this->model.size());
+    for (auto& entry : this->model) ordered.push_back(&entry);
+    std::sort(ordered.begin(), ordered.end(),
+              [](const Model::value_type* a, const Model::value_type* b) {
+                  return a->second.order < b->second.order;
+              });
+    for (const Model::value_type* item : ordered) {
+        const Model::value_type& entry = *item;
+        uint32_t index = (uint32_t)next->ports.size();
+        JackPortGraphSnapshot::Port port;
+        port.handle = entry.first;
+        port.name = entry.second.name;
+        port.clientName = port.name.substr(0, port.name.find(':'));
+        port.type = entry.second.type;
+        port.flags = entry.second.flags;
+        next->ports.push_back(std::move(port));
+        next->byName[entry.second.name] = index;
+        next->byHandle[entry.first] = index;
+        int flags = entry.second.flags & JackPortGraphSnapshot::SELECT_FLAGS;
+        // Every subset of the port's flags selects it.
+        for (int subset = flags;; subset = (subset - 1) & flags) {
+            next->selections[entry.second.type == JackPortType::MIDI][subset].push_back(index);
+            if (!subset) break;
+        }
+    }
+    for (auto& entry : this->model) {
+        JackPortGraphSnapshot::Port& port = next->ports[next->byHandle[entry.first]];
+        for (jack_port_t* other : entry.second.connections)
+            port.connections.push_back(next->byHandle[other]);
+        std::sort(port.connections.begin(), port.connections.end());
+    }
+    next->clients.assign(this->clients.begin(), this->clients.end());
+    std::atomic_store(&this->snapshot,
+                      std::shared_ptr<const JackPortGraphSnapshot>(std::move(next)));
+}
@@ -0,0 +1,155 @@
+#ifndef _JACKCLIENT_PORTGRAPH_H
+#define _JACKCLIENT_PORTGRAPH_H
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "jackclient.h"
+
+/**
+ * Immutable view of all audio and MIDI ports of the server and their
+ * connections. Name, handle and flag lookups are constant time.
+ * */
+class JackPortGraphSnapshot {
+    friend class JackPortGraph;
+
+   public:
+    struct Port {
+        jack_port_t* handle;
+        std::string name;
+        std::string clientName;
+        JackPortType type;
+        int flags;
+        /** Indices of the connected ports. */
+        std::vector<uint32_t> connections;
+    };
+    /** Flags that select() can filter on. */
+    static constexpr int SELECT_FLAGS =
+        JackPortIsInput | JackPortIsOutput | JackPortIsPhysical | JackPortIsTerminal;
+
+   private:
+    uint64_t version = 0;
+    std::vector<Port> ports;
+    std::vector<std::string> clients;
+    std::unordered_map<std::string, uint32_t> byName;
+    std::unordered_map<jack_port_t*, uint32_t> byHandle;
+    // One list per port type and subset of SELECT_FLAGS.
+    std::vector<uint32_t> selections[2][SELECT_FLAGS + 1];
+
+   public:
+    uint64_t getVersion() const { return version; };
+    size_t size() const { return ports.size(); };
+    const Port& operator[](uint32_t index) const { return ports[index]; };
+    std::vector<Port>::const_iterator begin() const { return ports.begin(); };
+    std::vector<Port>::const_iterator end() const { return ports.end(); };
+    const std::vector<std::string>& getClients() const { return clients; };
+    const Port* find(const std::string& name) const;
+    const Port* find(jack_port_t* handle) const;
+    /** Indices of the ports of a type having all of flags, looking only at SELECT_FLAGS. */
+    const std::vector<uint32_t>& select(JackPortType type, int flags) const;
+};
+
+/**
+ * Mirror of the server's port graph, kept current by the port registration,
+ * port connect, port rename and client registration callbacks. Callbacks
+ * only queue events; a background thread applies them in batches and
+ * publishes a new snapshot, so readers never wait for an update. Changes
+ * become visible shortly after the server reports them, the client's own
+ * ports and connections as soon as the request returns. Ports are listed
+ * in the order jack_get_ports gave them, ports registered later last.
+ * */
+class JackPortGraph {
+   private:
+    enum class EventType {
+        PORT_REGISTERED,
+        PORT_UNREGISTERED,
+        CONNECTED,
+        DISCONNECTED,
+        RENAMED,
+        CLIENT_UNREGISTERED,
+        CLIENT_REGISTERED,
+        RECOMPUTE_LATENCIES
+    };
+    struct Event {
+        EventType type;
+        jack_port_t* a;
+        jack_port_t* b;
+        std::string name;
+    };
+    struct PortRecord {
+        uint64_t order;
+        std::string name;
+        JackPortType type;
+        int flags;
+        std::set<jack_port_t*> connections;
+    };
+    typedef std::map<jack_port_t*, PortRecord> Model;
+
+    jack_client_t* client;
+    std::shared_ptr<const JackPortGraphSnapshot> snapshot;
+    // Owned by whoever holds modelMutex.
+    Model model;
+    std::set<std::string> clients;
+    uint64_t nextOrder = 0;
+    // Callbacks still to come for connections the client changed itself.
+    std::map<std::pair<jack_port_t*, jack_port_t*>, uint32_t> echoes;
+    uint64_t version = 0;
+    std::mutex modelMutex;
+
+    std::mutex eventsMutex;
+    std::condition_variable eventsWakeup;
+    std::vector<Event> events;
+    bool running = true;
+    std::thread updater;
+
+    static void port_registration_callback(jack_port_id_t id, int reg, void* arg);
+    static void port_connect_callback(jack_port_id_t a, jack_port_id_t b, int connect, void* arg);
+    static int port_rename_callback(jack_port_id_t id, const char* oldName, const char* newName,
+                                    void* arg);
+    static void client_registration_callback(const char* name, int reg, void* arg);
+    void push(Event event);
+    void run();
+    void apply(const Event& event);
+    bool addPort(jack_port_t* handle);
+    bool link(jack_port_t* a, jack_port_t* b, bool connect);
+    void expectEcho(jack_port_t* a, jack_port_t* b);
+    void applyOwn(const char* source, const char* destination, bool connect);
+    void publish();
+
+   public:
+    /** Installs the callbacks, so it must be created before the client is activated. */
+    explicit JackPortGraph(jack_client_t* client);
+    ~JackPortGraph();
+    /** The current graph. Never blocks on updates in progress. */
+    std::shared_ptr<const JackPortGraphSnapshot> getSnapshot() const;
+    /** Rebuilds the model from the server, e.g. while callbacks are not delivered. */
+    void refresh();
+    /**
+     * The client's own changes. Each request runs with the model locked and,
+     * if the server accepts it, is applied and published right away; the
+     * callbacks it causes are skipped when they arrive. The requests return
+     * the error of the JACK call.
+     * */
+    int connect(const char* source, const char* destination);
+    int disconnect(const char* source, const char* destination);
+    int disconnectAll(jack_port_t* handle);
+    void addOwnPort(jack_port_t* handle);
+    /**
+     * Asks the server to recompute latencies from the updater thread, for
+     * callbacks that must not make server requests themselves.
+     * */
+    void requestLatencyRecompute();
+    /**
+     * Joins the updater, which calls into the client's port handles, so it
+     * must run before the client is closed. The callbacks may still arrive
+     * until then and are ignored.
+     * */
+    void stop();
+};
+#endif
@@ -0,0 +1,85 @@
+#include "portgroup.h"
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <new>
+
+#include "audiokernels.h"
+
+void JackAudioPortGroup::FreeDeleter::operator()(float* ptr) const { free(ptr); }
+
+JackAudioPortGroup::JackAudioPortGroup(JackClient* client, uint32_t channels, uint32_t maxFrames)
+    : client(client), channels(channels) {
+    if (channels == 0) throw JackClientException("Port group needs at least one channel");
+    this->reserve(maxFrames ? maxFrames : client->getBufferSize());
+    std::lock_guard<std::mutex> lock(client->groupsMutex);
+    client->groups.push_back(this);
+}
+
+JackAudioPortGroup::~JackAudioPortGroup() {
+    std::lock_guard<std::mutex> lock(this->client->groupsMutex);
+    std::vector<JackAudioPortGroup*>& list = this->client->groups;
+    list.erase(std::remove(list.begin(), list.end(), this), list.end());
+}
+
+std::string JackAudioPortGroup::channelName(const std::string& prefix, uint32_t channel) {
+    return prefix + "_" + std::to_string(channel + 1);
+}
+
+void JackAudioPortGroup::reserve(uint32_t maxFrames) {
+    if (maxFrames <= this->maxFrames) return;
+    void* ptr;
+    if (posix_memalign(&ptr, JackCacheAligned::CACHE_LINE_SIZE,
+                       (size_t)maxFrames * this->channels * sizeof(float)))
+        throw std::bad_alloc();
+    this->scratch.reset(static_cast<float*>(ptr));
+    this->maxFrames = maxFrames;
+}
+
+JackAudioInputGroup::JackAudioInputGroup(JackClient* client, const std::string& prefix,
+                                         uint32_t channels, uint32_t maxFrames)
+    : JackAudioPortGroup(client, channels, maxFrames), planar(channels, nullptr) {
+    this->ports.reserve(channels);
+    for (uint32_t c = 0; c < channels; c++)
+        this->ports.push_back(client->createAudioInputPort(channelName(prefix, c).c_str()));
+}
+
+const float* const* JackAudioInputGroup::getChannels(const JackPortBuffers& buffers) {
+    for (uint32_t c = 0; c < this->channels; c++)
+        this->planar[c] = buffers.getBuffer(*this->ports[c]);
+    return this->planar.data();
+}
+
+const float* JackAudioInputGroup::getInterleaved(const JackPortBuffers& buffers) {
+    uint32_t nframes = buffers.getFrameCount();
+    if (nframes > this->maxFrames) return nullptr;
+    AudioKernels::interleave(this->scratch.get(), this->getChannels(buffers), this->channels,
+                             nframes);
+    return this->scratch.get();
+}
+
+JackAudioOutputGroup::JackAudioOutputGroup(JackClient* client, const std::string& prefix,
+                                           uint32_t channels, uint32_t maxFrames)
+    : JackAudioPortGroup(client, channels, maxFrames), planar(channels, nullptr) {
+    this->ports.reserve(channels);
+    for (uint32_t c = 0; c < channels; c++)
+        this->ports.push_back(client->createAudioOutputPort(channelName(prefix, c).c_str()));
+}
+
+float* const* JackAudioOutputGroup::getChannels(const JackPortBuffers& buffers) {
+    for (uint32_t c = 0; c < this->channels; c++)
+        this->planar[c] = buffers.getBuffer(*this->ports[c]);
+    return this->planar.data();
+}
+
+float* JackAudioOutputGroup::getInterleaved(const JackPortBuffers& buffers) {
+    return buffers.getFrameCount() > this->maxFrames ? nullptr : this->scratch.get();
+}
+
+void JackAudioOutputGroup::commitInterleaved(const JackPortBuffers& buffers) {
+    uint32_t nframes = buffers.getFrameCount();
+    if (nframes > this->maxFrames) return;
+    AudioKernels::deinterleave(this->getChannels(buffers), this->scratch.get(), this->channels,
+                               nframes);
+}
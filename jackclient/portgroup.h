@@ -0,0 +1,81 @@
+#ifndef _JACKCLIENT_PORTGROUP_H
+#define _JACKCLIENT_PORTGROUP_H
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "jackclient.h"
+
+/**
+ * Channels registered together as ports named prefix_1 ... prefix_N. Each
+ * cycle the group resolves all channel buffers into one planar pointer
+ * array. The interleaved views use scratch memory aligned to a cache line
+ * that is allocated up front for getMaxFrames() frames, so nothing is
+ * allocated on the process thread. The client grows it when the buffer
+ * size grows past getMaxFrames().
+ * */
+class JackAudioPortGroup {
+    friend class JackClient;
+
+   private:
+    struct FreeDeleter {
+        void operator()(float* ptr) const;
+    };
+
+    JackClient* client;
+
+    /** Grows the scratch memory for larger periods. Only while the process thread cannot run. */
+    void reserve(uint32_t maxFrames);
+
+   protected:
+    uint32_t channels;
+    uint32_t maxFrames = 0;
+    std::unique_ptr<float, FreeDeleter> scratch;
+
+    JackAudioPortGroup(JackClient* client, uint32_t channels, uint32_t maxFrames);
+    static std::string channelName(const std::string& prefix, uint32_t channel);
+
+   public:
+    ~JackAudioPortGroup();
+    uint32_t getChannelCount() const { return channels; };
+    uint32_t getMaxFrames() const { return maxFrames; };
+};
+
+class JackAudioInputGroup : public JackAudioPortGroup {
+   private:
+    std::vector<std::unique_ptr<JackAudioInputPort>> ports;
+    std::vector<const float*> planar;
+
+   public:
+    /** maxFrames: largest period the interleaved view must hold, 0 for the current one. */
+    JackAudioInputGroup(JackClient* client, const std::string& prefix, uint32_t channels,
+                        uint32_t maxFrames = 0);
+    JackAudioInputPort& operator[](uint32_t channel) { return *ports[channel]; };
+    /** This cycle's buffers, one per channel. */
+    const float* const* getChannels(const JackPortBuffers& buffers);
+    /**
+     * This cycle's input interleaved into the scratch memory, or nullptr if
+     * the period is longer than getMaxFrames().
+     * */
+    const float* getInterleaved(const JackPortBuffers& buffers);
+};
+
+class JackAudioOutputGroup : public JackAudioPortGroup {
+   private:
+    std::vector<std::unique_ptr<JackAudioOutputPort>> ports;
+    std::vector<float*> planar;
+
+   public:
+    JackAudioOutputGroup(JackClient* client, const std::string& prefix, uint32_t channels,
+                         uint32_t maxFrames = 0);
+    JackAudioOutputPort& operator[](uint32_t channel) { return *ports[channel]; };
+    float* const* getChannels(const JackPortBuffers& buffers);
+    /**
+     * Scratch memory to render interleaved output into, or nullptr if the
+     * period is longer than getMaxFrames(). Write it to the ports with
+     * commitInterleaved().
+     * */
+    float* getInterleaved(const JackPortBuffers& buffers);
+    void commitInterleaved(const JackPortBuffers& buffers);
+};
+#endif
@@ -0,0 +1,282 @@
+#include "processgraph.h"
+
+#include <chrono>
+#include <thread>
+
+#include "rtcheck.h"
+
+// Eases a spin-wait on the core and on its sibling hyperthread.
+static inline void cpuPause() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+JackWorkDeque::JackWorkDeque() : top(0), bottom(0), mask(0) {}
+
+void JackWorkDeque::reserve(size_t capacity) {
+    size_t size = 1;
+    while (size < capacity) size <<= 1;
+    this->items.reset(new std::atomic<uint32_t>[size]);
+    this->mask = (int64_t)size - 1;
+}
+
+void JackWorkDeque::reset() {
+    this->top.store(0, std::memory_order_relaxed);
+    this->bottom.store(0, std::memory_order_relaxed);
+}
+
+void JackWorkDeque::push(uint32_t item) {
+    int64_t b = this->bottom.load(std::memory_order_relaxed);
+    this->items[b & this->mask].store(item, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    this->bottom.store(b + 1, std::memory_order_relaxed);
+}
+
+uint32_t JackWorkDeque::pop() {
+    int64_t b = this->bottom.load(std::memory_order_relaxed) - 1;
+    this->bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = this->top.load(std::memory_order_relaxed);
+    if (t > b) {
+        this->bottom.store(b + 1, std::memory_order_relaxed);
+        return EMPTY;
+    }
+    uint32_t item = this->items[b & this->mask].load(std::memory_order_relaxed);
+    if (t == b) {
+        // Last item: race against thieves for it.
+        if (!this->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                               std::memory_order_relaxed))
+            item = EMPTY;
+        this->bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return item;
+}
+
+uint32_t JackWorkDeque::steal() {
+    int64_t t = this->top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = this->bottom.load(std::memory_order_acquire);
+    if (t >= b) return EMPTY;
+    uint32_t item = this->items[t & this->mask].load(std::memory_order_relaxed);
+    if (!this->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                           std::memory_order_relaxed))
+        return EMPTY;
+    return item;
+}
+
+JackProcessGraph::JackProcessGraph(JackClient* client, uint32_t workers, size_t serialThreshold)
+    : client(client), serialThreshold(serialThreshold), running(false), remaining(0),
+      busyWorkers(0), pass(0) {
+    if (workers == 0) {
+        unsigned int cores = std::thread::hardware_concurrency();
+        workers = cores > 1 ? cores - 1 : 0;
+    }
+    this->workerCount = workers;
+}
+
+JackProcessGraph::~JackProcessGraph() {
+    this->running.store(false);
+    for (auto& worker : this->workers) sem_post(&worker->wakeup);
+    for (auto& worker : this->workers) {
+        worker->thread.reset();
+        sem_destroy(&worker->wakeup);
+    }
+}
+
+size_t JackProcessGraph::addNode(NodeFunction function, std::vector<JackAudioInputPort*> inputs,
+                                 std::vector<JackAudioOutputPort*> outputs) {
+    if (this->started) throw JackClientException("Cannot add nodes to a started process graph");
+    std::unique_ptr<Node> node(new Node());
+    node->function = function;
+    node->inputs.resize(inputs.size());
+    node->outputs.resize(outputs.size());
+    node->inputPorts = std::move(inputs);
+    node->outputPorts = std::move(outputs);
+    this->nodes.push_back(std::move(node));
+    this->resetNodeTimes();
+    return this->nodes.size() - 1;
+}
+
+void JackProcessGraph::addEdge(size_t from, size_t to) {
+    if (this->started) throw JackClientException("Cannot add edges to a started process graph");
+    if (from >= this->nodes.size() || to >= this->nodes.size() || from == to)
+        throw JackClientException("Invalid process graph edge");
+    this->nodes[from]->successors.push_back((uint32_t)to);
+    this->nodes[to]->predecessors++;
+}
+
+void JackProcessGraph::start() {
+    if (this->started) return;
+    size_t count = this->nodes.size();
+
+    // Kahn's algorithm: the resulting order drives serial execution and detects cycles.
+    std::vector<uint32_t> indegree(count);
+    for (size_t i = 0; i < count; i++) indegree[i] = this->nodes[i]->predecessors;
+    for (size_t i = 0; i < count; i++)
+        if (indegree[i] == 0) this->order.push_back((uint32_t)i);
+    for (size_t i = 0; i < this->order.size(); i++)
+        for (uint32_t next : this->nodes[this->order[i]]->successors)
+            if (--indegree[next] == 0) this->order.push_back(next);
+    if (this->order.size() != count) {
+        this->order.clear();
+        throw JackClientException("Process graph contains a cycle");
+    }
+
+    this->pending.reset(new Counter[count ? count : 1]);
+    this->started = true;
+    if (!this->isParallel()) return;
+
+    this->deques.reset(new JackWorkDeque[this->workerCount + 1]);
+    for (uint32_t i = 0; i <= this->workerCount; i++) this->deques[i].reserve(count);
+    this->running.store(true);
+    for (uint32_t i = 1; i <= this->workerCount; i++) {
+        std::unique_ptr<Worker> worker(new Worker());
+        worker->graph = this;
+        worker->index = i;
+        sem_init(&worker->wakeup, 0, 0);
+        JackThreadOptions options = this->workerOptions;
+        if (!options.cpus.empty()) options.cpus = {options.cpus[(i - 1) % options.cpus.size()]};
+        // Listed before its thread exists, so the destructor cleans up if creation throws.
+        Worker* created = worker.get();
+        this->workers.push_back(std::move(worker));
+        created->thread.reset(
+            new JackRealtimeThread(this->client, &JackProcessGraph::workerMain, created, options));
+    }
+}
+
+void JackProcessGraph::setWorkerOptions(const JackThreadOptions& options) {
+    if (this->started) throw JackClientException("Cannot change a started process graph");
+    this->workerOptions = options;
+}
+
+JackThreadStats JackProcessGraph::getWorkerStats(uint32_t worker) const {
+    return this->workers.at(worker - 1)->thread->getStats();
+}
+
+void* JackProcessGraph::workerMain(void* arg) {
+    Worker* worker = static_cast<Worker*>(arg);
+    JackProcessGraph* graph = worker->graph;
+    for (;;) {
+        while (sem_wait(&worker->wakeup) != 0) {
+        }
+        if (!graph->running.load(std::memory_order_acquire)) break;
+        // A wakeup taken after its pass was closed is only acknowledged, so it can neither
+        // touch the next pass's state nor leave a post queued for it.
+        uint64_t open = 2 * ++worker->passes - 1;
+        graph->busyWorkers.fetch_add(1, std::memory_order_seq_cst);
+        if (graph->pass.load(std::memory_order_seq_cst) == open) {
+            JackRTCheck::Scope realtime;
+            graph->participate(worker->index);
+        }
+        graph->busyWorkers.fetch_sub(1, std::memory_order_release);
+    }
+    return nullptr;
+}
+
+void JackProcessGraph::runNode(uint32_t index, uint32_t worker) {
+    Node& node = *this->nodes[index];
+    auto start = std::chrono::steady_clock::now();
+    node.function(node.inputs.data(), node.outputs.data(), this->nframes);
+    uint64_t nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    node.lastNanos.store(nanos, std::memory_order_relaxed);
+    if (nanos > node.maxNanos.load(std::memory_order_relaxed))
+        node.maxNanos.store(nanos, std::memory_order_relaxed);
+    node.totalNanos.store(node.totalNanos.load(std::memory_order_relaxed) + nanos,
+                          std::memory_order_relaxed);
+    node.runs.store(node.runs.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    if (this->deques) {
+        for (uint32_t next : node.successors)
+            if (this->pending[next].value.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                this->deques[worker].push(next);
+    }
+}
+
+void JackProcessGraph::participate(uint32_t worker) {
+    uint32_t participants = this->workerCount + 1;
+    while (this->remaining.load(std::memory_order_acquire) != 0) {
+        uint32_t index = this->deques[worker].pop();
+        for (uint32_t i = 1; index == JackWorkDeque::EMPTY && i < participants; i++)
+            index = this->deques[(worker + i) % participants].steal();
+        if (index == JackWorkDeque::EMPTY) {
+            cpuPause();
+            continue;
+        }
+        this->runNode(index, worker);
+        this->remaining.fetch_sub(1, std::memory_order_acq_rel);
+    }
+}
+
+void JackProcessGraph::processSerial() {
+    for (uint32_t index : this->order) this->runNode(index, 0);
+}
+
+bool JackProcessGraph::process(uint32_t nframes) {
+    if (!this->started) return false;
+    this->nframes = nframes;
+    for (auto& node : this->nodes) {
+        for (size_t i = 0; i < node->inputPorts.size(); i++)
+            node->inputs[i] = node->inputPorts[i]->getBuffer();
+        for (size_t i = 0; i < node->outputPorts.size(); i++)
+            node->outputs[i] = node->outputPorts[i]->getBuffer();
+    }
+    if (!this->isParallel()) {
+        this->processSerial();
+        return true;
+    }
+
+    uint32_t participants = this->workerCount + 1;
+    for (uint32_t i = 0; i < participants; i++) this->deques[i].reset();
+    uint32_t root = 0;
+    for (size_t i = 0; i < this->nodes.size(); i++) {
+        uint32_t predecessors = this->nodes[i]->predecessors;
+        this->pending[i].value.store(predecessors, std::memory_order_relaxed);
+        if (predecessors == 0) this->deques[root++ % participants].push((uint32_t)i);
+    }
+    // Publishing the node count releases the reset above to the workers.
+    this->remaining.store((uint32_t)this->nodes.size(), std::memory_order_release);
+    uint64_t open = this->pass.load(std::memory_order_relaxed) + 1;
+    this->pass.store(open, std::memory_order_seq_cst);
+    for (auto& worker : this->workers) sem_post(&worker->wakeup);
+
+    this->participate(0);
+    // Workers may still be looking for work; they must be out before the next reset. Once the
+    // pass is closed, workers that wake up late leave it alone.
+    this->pass.store(open + 1, std::memory_order_seq_cst);
+    for (uint32_t spins = 0; this->busyWorkers.load(std::memory_order_seq_cst) != 0; spins++) {
+        // Past a short spin, give the core to a worker that may have been preempted on it.
+        if (spins < 1024)
+            cpuPause();
+        else
+            std::this_thread::yield();
+    }
+    return true;
+}
+
+uint64_t JackProcessGraph::getNodeLastTime(size_t node) const {
+    return this->nodes[node]->lastNanos.load(std::memory_order_relaxed);
+}
+
+uint64_t JackProcessGraph::getNodeMaxTime(size_t node) const {
+    return this->nodes[node]->maxNanos.load(std::memory_order_relaxed);
+}
+
+double JackProcessGraph::getNodeAverageTime(size_t node) const {
+    uint64_t runs = this->nodes[node]->runs.load(std::memory_order_relaxed);
+    if (runs == 0) return 0.0;
+    return (double)this->nodes[node]->totalNanos.load(std::memory_order_relaxed) / runs;
+}
+
+void JackProcessGraph::resetNodeTimes() {
+    for (auto& node : this->nodes) {
+        node->lastNanos.store(0, std::memory_order_relaxed);
+        node->maxNanos.store(0, std::memory_order_relaxed);
+        node->totalNanos.store(0, std::memory_order_relaxed);
+        node->runs.store(0, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,124 @@
+#ifndef _JACKCLIENT_PROCESSGRAPH_H
+#define _JACKCLIENT_PROCESSGRAPH_H
+#include <semaphore.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "jackclient.h"
+#include "rtthread.h"
+
+/**
+ * Fixed-capacity Chase-Lev work-stealing deque of node indices. The owner
+ * pushes and pops at the bottom, other workers steal from the top.
+ * */
+class JackWorkDeque : public JackCacheAligned {
+   private:
+    alignas(CACHE_LINE_SIZE) std::atomic<int64_t> top;
+    alignas(CACHE_LINE_SIZE) std::atomic<int64_t> bottom;
+    std::unique_ptr<std::atomic<uint32_t>[]> items;
+    int64_t mask;
+
+   public:
+    static const uint32_t EMPTY = ~0u;
+    JackWorkDeque();
+    void reserve(size_t capacity);
+    void reset();
+    void push(uint32_t item);
+    uint32_t pop();
+    uint32_t steal();
+};
+
+/**
+ * A graph of DSP nodes executed once per process cycle. Nodes run as soon
+ * as all of their predecessors have finished, spread over a pool of JACK
+ * real-time worker threads with work stealing; the calling process thread
+ * takes part and process() returns only once every node has run. Small
+ * graphs, or a pool without workers, run serially in topological order.
+ * */
+class JackProcessGraph {
+   public:
+    typedef std::function<void(const float* const* inputs, float* const* outputs,
+                               uint32_t nframes)>
+        NodeFunction;
+
+   private:
+    struct Node {
+        NodeFunction function;
+        std::vector<JackAudioInputPort*> inputPorts;
+        std::vector<JackAudioOutputPort*> outputPorts;
+        std::vector<const float*> inputs;
+        std::vector<float*> outputs;
+        std::vector<uint32_t> successors;
+        uint32_t predecessors = 0;
+        std::atomic<uint64_t> lastNanos;
+        std::atomic<uint64_t> maxNanos;
+        std::atomic<uint64_t> totalNanos;
+        std::atomic<uint64_t> runs;
+    };
+    struct Counter : public JackCacheAligned {
+        alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> value;
+    };
+    struct Worker {
+        JackProcessGraph* graph;
+        uint32_t index;
+        std::unique_ptr<JackRealtimeThread> thread;
+        sem_t wakeup;
+        // Wakeups taken so far; the n-th one is for pass n.
+        uint64_t passes = 0;
+    };
+
+    JackClient* client;
+    std::vector<std::unique_ptr<Node>> nodes;
+    std::vector<uint32_t> order;
+    std::unique_ptr<Counter[]> pending;
+    std::unique_ptr<JackWorkDeque[]> deques;
+    std::vector<std::unique_ptr<Worker>> workers;
+    uint32_t workerCount;
+    size_t serialThreshold;
+    JackThreadOptions workerOptions;
+    uint32_t nframes = 0;
+    bool started = false;
+    std::atomic<bool> running;
+    alignas(JackCacheAligned::CACHE_LINE_SIZE) std::atomic<uint32_t> remaining;
+    alignas(JackCacheAligned::CACHE_LINE_SIZE) std::atomic<uint32_t> busyWorkers;
+    // 2n - 1 while pass n runs, 2n once process() has closed it.
+    alignas(JackCacheAligned::CACHE_LINE_SIZE) std::atomic<uint64_t> pass;
+
+    static void* workerMain(void* arg);
+    void runNode(uint32_t index, uint32_t worker);
+    void participate(uint32_t worker);
+    void processSerial();
+
+   public:
+    /** workers: number of helper threads, 0 picks one less than the number of cores. */
+    JackProcessGraph(JackClient* client, uint32_t workers = 0, size_t serialThreshold = 4);
+    ~JackProcessGraph();
+    size_t addNode(NodeFunction function, std::vector<JackAudioInputPort*> inputs = {},
+                   std::vector<JackAudioOutputPort*> outputs = {});
+    void addEdge(size_t from, size_t to);
+    /**
+     * Thread options for the workers, before start(). Each worker is pinned
+     * to a single CPU of options.cpus, round robin, so workers do not
+     * migrate between cores.
+     * */
+    void setWorkerOptions(const JackThreadOptions& options);
+    /** Checks the graph for cycles and starts the worker threads; no changes afterwards. */
+    void start();
+    /** Runs every node for this cycle. Call from onProcess. False if the graph was not started. */
+    bool process(uint32_t nframes);
+
+    size_t getNodeCount() const { return nodes.size(); };
+    uint32_t getWorkerCount() const { return workerCount; };
+    bool isParallel() const { return workerCount > 0 && nodes.size() >= serialThreshold; };
+    /** Node timing in nanoseconds, readable from any thread. */
+    uint64_t getNodeLastTime(size_t node) const;
+    uint64_t getNodeMaxTime(size_t node) const;
+    double getNodeAverageTime(size_t node) const;
+    void resetNodeTimes();
+    /** Scheduling statistics of worker 1..getWorkerCount(); not real-time safe. */
+    JackThreadStats getWorkerStats(uint32_t worker) const;
+};
+#endif
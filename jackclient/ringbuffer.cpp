@@ -0,0 +1,85 @@
+#include "ringbuffer.h"
+
+static size_t nextPowerOfTwo(size_t value) {
+    size_t result = 1;
+    while (result < value) result <<= 1;
+    return result;
+}
+
+JackRingBufferState::JackRingBufferState(size_t minCapacity)
+    : capacity(nextPowerOfTwo(minCapacity ? minCapacity : 1)),
+      mask(capacity - 1),
+      writeIndex(0),
+      readIndex(0),
+      overruns(0),
+      underruns(0) {}
+
+JackRingBufferState::Vector JackRingBufferState::makeVector(size_t start, size_t count) const {
+    Vector vec;
+    size_t offset = start & this->mask;
+    size_t tail = this->capacity - offset;
+    vec.first.offset = offset;
+    vec.first.size = count < tail ? count : tail;
+    vec.second.offset = 0;
+    vec.second.size = count - vec.first.size;
+    return vec;
+}
+
+JackAudioRingBuffer::JackAudioRingBuffer(uint32_t channels, size_t minFrames)
+    : JackRingBufferState(minFrames), channels(channels), data(channels * capacity, 0.0f) {}
+
+bool JackAudioRingBuffer::write(const float* const* src, uint32_t frames) {
+    if (!this->canWrite(frames)) {
+        this->overruns.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    Vector vec = this->makeVector(this->writeIndex.load(std::memory_order_relaxed), frames);
+    for (uint32_t c = 0; c < this->channels; c++) {
+        float* channel = this->getChannelData(c);
+        std::memcpy(channel + vec.first.offset, src[c], vec.first.size * sizeof(float));
+        std::memcpy(channel, src[c] + vec.first.size, vec.second.size * sizeof(float));
+    }
+    this->commitWrite(frames);
+    return true;
+}
+
+bool JackAudioRingBuffer::read(float* const* dst, uint32_t frames) {
+    if (!this->canRead(frames)) {
+        this->underruns.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    Vector vec = this->makeVector(this->readIndex.load(std::memory_order_relaxed), frames);
+    for (uint32_t c = 0; c < this->channels; c++) {
+        const float* channel = this->getChannelData(c);
+        std::memcpy(dst[c], channel + vec.first.offset, vec.first.size * sizeof(float));
+        std::memcpy(dst[c] + vec.first.size, channel, vec.second.size * sizeof(float));
+    }
+    this->commitRead(frames);
+    return true;
+}
+
+bool JackAudioRingBuffer::tee(JackAudioInputPort* const* ports, uint32_t nframes) {
+    if (!this->canWrite(nframes)) {
+        this->overruns.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    Vector vec = this->makeVector(this->writeIndex.load(std::memory_order_relaxed), nframes);
+    for (uint32_t c = 0; c < this->channels; c++) {
+        const float* src = ports[c]->getBuffer();
+        float* channel = this->getChannelData(c);
+        std::memcpy(channel + vec.first.offset, src, vec.first.size * sizeof(float));
+        std::memcpy(channel, src + vec.first.size, vec.second.size * sizeof(float));
+    }
+    this->commitWrite(nframes);
+    return true;
+}
+
+bool JackAudioRingBuffer::tee(JackAudioInputPort& port, uint32_t nframes) {
+    // Runs on the process thread, so a channel mismatch is dropped like a full buffer.
+    if (this->channels != 1) {
+        this->overruns.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    JackAudioInputPort* ports[] = {&port};
+    return this->tee(ports, nframes);
+}
@@ -0,0 +1,167 @@
+#ifndef _JACKCLIENT_RINGBUFFER_H
+#define _JACKCLIENT_RINGBUFFER_H
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "jackclient.h"
+
+/**
+ * Index bookkeeping shared by the single-producer/single-consumer ring
+ * buffers. Indices grow monotonically and are masked on access, so the full
+ * capacity is usable. Producer and consumer state live on separate cache
+ * lines and each side caches the other side's index to avoid needless
+ * coherence traffic.
+ * */
+class JackRingBufferState : public JackCacheAligned {
+   public:
+    /** A contiguous part of the buffer, starting at index offset. */
+    struct Segment {
+        size_t offset;
+        size_t size;
+    };
+    /** Readable or writable space as at most two segments (the second one wraps around). */
+    struct Vector {
+        Segment first;
+        Segment second;
+        size_t size() const { return first.size + second.size; };
+    };
+
+   protected:
+    size_t capacity;
+    size_t mask;
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> writeIndex;
+    size_t cachedReadIndex = 0;
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> readIndex;
+    size_t cachedWriteIndex = 0;
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> overruns;
+    std::atomic<uint64_t> underruns;
+
+    explicit JackRingBufferState(size_t minCapacity);
+    Vector makeVector(size_t start, size_t count) const;
+
+   public:
+    size_t getCapacity() const { return capacity; };
+    /** Producer side: number of elements that can be written without overrunning. */
+    size_t getWriteSpace() {
+        size_t w = writeIndex.load(std::memory_order_relaxed);
+        cachedReadIndex = readIndex.load(std::memory_order_acquire);
+        return capacity - (w - cachedReadIndex);
+    };
+    /** Consumer side: number of elements available for reading. */
+    size_t getReadSpace() {
+        size_t r = readIndex.load(std::memory_order_relaxed);
+        cachedWriteIndex = writeIndex.load(std::memory_order_acquire);
+        return cachedWriteIndex - r;
+    };
+    Vector getWriteVector() {
+        return makeVector(writeIndex.load(std::memory_order_relaxed), getWriteSpace());
+    };
+    Vector getReadVector() {
+        return makeVector(readIndex.load(std::memory_order_relaxed), getReadSpace());
+    };
+    void commitWrite(size_t count) {
+        writeIndex.store(writeIndex.load(std::memory_order_relaxed) + count,
+                         std::memory_order_release);
+    };
+    void commitRead(size_t count) {
+        readIndex.store(readIndex.load(std::memory_order_relaxed) + count,
+                        std::memory_order_release);
+    };
+    /** Number of writes rejected because the buffer was full. */
+    uint64_t getOverruns() const { return overruns.load(std::memory_order_relaxed); };
+    /** Number of reads rejected because not enough data was available. */
+    uint64_t getUnderruns() const { return underruns.load(std::memory_order_relaxed); };
+    void resetCounters() {
+        overruns.store(0, std::memory_order_relaxed);
+        underruns.store(0, std::memory_order_relaxed);
+    };
+
+   protected:
+    /** Producer side: true if count elements fit, re-reading the consumer index only when needed. */
+    bool canWrite(size_t count) {
+        size_t w = writeIndex.load(std::memory_order_relaxed);
+        if (capacity - (w - cachedReadIndex) >= count) return true;
+        cachedReadIndex = readIndex.load(std::memory_order_acquire);
+        return capacity - (w - cachedReadIndex) >= count;
+    };
+    /** Consumer side: true if count elements are available. */
+    bool canRead(size_t count) {
+        size_t r = readIndex.load(std::memory_order_relaxed);
+        if (cachedWriteIndex - r >= count) return true;
+        cachedWriteIndex = writeIndex.load(std::memory_order_acquire);
+        return cachedWriteIndex - r >= count;
+    };
+};
+
+/**
+ * Wait-free single-producer/single-consumer ring buffer of trivially
+ * copyable elements. Whole blocks are pushed and popped: a write or read
+ * either transfers all requested elements or none and bumps the
+ * overrun/underrun counter.
+ * */
+template <typename T>
+class JackRingBuffer : public JackRingBufferState {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "JackRingBuffer requires a trivially copyable element type");
+
+   private:
+    std::unique_ptr<T[]> data;
+
+   public:
+    explicit JackRingBuffer(size_t minCapacity)
+        : JackRingBufferState(minCapacity), data(new T[capacity]()){};
+
+    bool write(const T* src, size_t count) {
+        if (!canWrite(count)) {
+            overruns.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        Vector vec = makeVector(writeIndex.load(std::memory_order_relaxed), count);
+        std::memcpy(data.get() + vec.first.offset, src, vec.first.size * sizeof(T));
+        std::memcpy(data.get(), src + vec.first.size, vec.second.size * sizeof(T));
+        commitWrite(count);
+        return true;
+    };
+    bool read(T* dst, size_t count) {
+        if (!canRead(count)) {
+            underruns.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        Vector vec = makeVector(readIndex.load(std::memory_order_relaxed), count);
+        std::memcpy(dst, data.get() + vec.first.offset, vec.first.size * sizeof(T));
+        std::memcpy(dst + vec.first.size, data.get(), vec.second.size * sizeof(T));
+        commitRead(count);
+        return true;
+    };
+    /** Base address for the offsets of the segments returned by get*Vector(). */
+    T* getData() { return data.get(); };
+};
+
+/**
+ * Single-producer/single-consumer ring buffer of multichannel audio frames.
+ * Samples are stored planar (one contiguous region per channel) so blocks
+ * move with one memcpy per channel and segment, and a frame is always
+ * written or read for all channels at once.
+ * */
+class JackAudioRingBuffer : public JackRingBufferState {
+   private:
+    uint32_t channels;
+    std::vector<float> data;
+
+   public:
+    JackAudioRingBuffer(uint32_t channels, size_t minFrames);
+    uint32_t getChannelCount() const { return channels; };
+    /** Base address of a channel for the offsets of the segments returned by get*Vector(). */
+    float* getChannelData(uint32_t channel) { return data.data() + channel * capacity; };
+
+    bool write(const float* const* src, uint32_t frames);
+    bool read(float* const* dst, uint32_t frames);
+    /** Pushes the current cycle's buffer of one port per channel. */
+    bool tee(JackAudioInputPort* const* ports, uint32_t nframes);
+    /** Mono buffers only; any other buffer writes nothing and counts an overrun. */
+    bool tee(JackAudioInputPort& port, uint32_t nframes);
+};
+#endif
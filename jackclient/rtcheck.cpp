@@ -0,0 +1,163 @@
+#include "rtcheck.h"
+
+#include <errno.h>
+#include <execinfo.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <mutex>
+
+#include "ringbuffer.h"
+
+#ifdef JACKCLIENT_RT_CHECKS
+#include <dlfcn.h>
+#endif
+
+namespace {
+// Plain TLS: the interposers run before and during static initialisation.
+__thread int realtimeDepth = 0;
+#ifdef JACKCLIENT_RT_CHECKS
+__thread bool reporting = false;
+#endif
+std::atomic<bool> enabled(true);
+std::atomic<uint64_t> violations(0);
+std::atomic<uint64_t> dropped(0);
+std::atomic_flag writing = ATOMIC_FLAG_INIT;
+JackRingBuffer<JackRTViolation> reports(256);
+std::mutex pollMutex;
+
+#ifdef JACKCLIENT_RT_CHECKS
+void report(JackRTViolationType type, size_t size) {
+    if (!realtimeDepth || reporting || !enabled.load(std::memory_order_relaxed)) return;
+    reporting = true;
+    violations.fetch_add(1, std::memory_order_relaxed);
+    JackRTViolation violation;
+    violation.type = type;
+    violation.size = size;
+    violation.depth = backtrace(violation.frames, JackRTViolation::MAX_FRAMES);
+    // Several real-time threads may report at once; whoever loses the flag drops its report.
+    if (!writing.test_and_set(std::memory_order_acquire)) {
+        if (!reports.write(&violation, 1)) dropped.fetch_add(1, std::memory_order_relaxed);
+        writing.clear(std::memory_order_release);
+    } else {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    reporting = false;
+}
+#endif
+}  // namespace
+
+#ifdef JACKCLIENT_RT_CHECKS
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* ptr);
+
+typedef int (*MutexLockFunction)(pthread_mutex_t* mutex);
+static MutexLockFunction realMutexLock = nullptr;
+
+static MutexLockFunction resolveMutexLock() {
+    if (!realMutexLock)
+        realMutexLock = (MutexLockFunction)dlsym(RTLD_NEXT, "pthread_mutex_lock");
+    return realMutexLock;
+}
+
+// Resolve and load everything the reporting path needs before any real-time thread exists.
+__attribute__((unused)) static int primed = []() {
+    void* frame;
+    backtrace(&frame, 1);
+    resolveMutexLock();
+    return 0;
+}();
+
+void* malloc(size_t size) {
+    report(JackRTViolationType::MALLOC, size);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    report(JackRTViolationType::MALLOC, count * size);
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    report(JackRTViolationType::MALLOC, size);
+    return __libc_realloc(ptr, size);
+}
+
+void* memalign(size_t alignment, size_t size) {
+    report(JackRTViolationType::MALLOC, size);
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) { return memalign(alignment, size); }
+
+int posix_memalign(void** ptr, size_t alignment, size_t size) {
+    if (alignment < sizeof(void*) || (alignment & (alignment - 1))) return EINVAL;
+    void* result = memalign(alignment, size);
+    if (!result) return ENOMEM;
+    *ptr = result;
+    return 0;
+}
+
+void free(void* ptr) {
+    if (ptr) report(JackRTViolationType::FREE, 0);
+    __libc_free(ptr);
+}
+
+int pthread_mutex_lock(pthread_mutex_t* mutex) {
+    report(JackRTViolationType::LOCK, 0);
+    return resolveMutexLock()(mutex);
+}
+}
+#endif
+
+JackRTCheck::Scope::Scope() { realtimeDepth++; }
+JackRTCheck::Scope::~Scope() { realtimeDepth--; }
+
+bool JackRTCheck::isAvailable() {
+#ifdef JACKCLIENT_RT_CHECKS
+    return true;
+#else
+    return false;
+#endif
+}
+
+void JackRTCheck::setEnabled(bool value) { enabled.store(value, std::memory_order_relaxed); }
+bool JackRTCheck::isEnabled() { return isAvailable() && enabled.load(std::memory_order_relaxed); }
+bool JackRTCheck::isRealtimeThread() { return realtimeDepth > 0; }
+
+size_t JackRTCheck::poll(std::vector<JackRTViolation>& out) {
+    std::lock_guard<std::mutex> lock(pollMutex);
+    size_t count = 0;
+    JackRTViolation violation;
+    while (reports.getReadSpace() && reports.read(&violation, 1)) {
+        out.push_back(violation);
+        count++;
+    }
+    return count;
+}
+
+uint64_t JackRTCheck::getViolationCount() { return violations.load(std::memory_order_relaxed); }
+uint64_t JackRTCheck::getDroppedCount() { return dropped.load(std::memory_order_relaxed); }
+
+void JackRTCheck::dump(std::ostream& out) {
+    static const char* names[] = {"malloc", "free", "mutex lock"};
+    std::vector<JackRTViolation> pending;
+    poll(pending);
+    for (const JackRTViolation& violation : pending) {
+        out << "real-time violation: " << names[(int)violation.type];
+        if (violation.type == JackRTViolationType::MALLOC)
+            out << " of " << violation.size << " bytes";
+        out << std::endl;
+        char** symbols = backtrace_symbols(violation.frames, violation.depth);
+        // Skip the frames of the reporting code itself.
+        for (int i = 2; i < violation.depth; i++)
+            out << "    " << (symbols ? symbols[i] : "?") << std::endl;
+        free(symbols);
+    }
+    if (getDroppedCount()) out << getDroppedCount() << " reports dropped" << std::endl;
+}
@@ -0,0 +1,52 @@
+#ifndef _JACKCLIENT_RTCHECK_H
+#define _JACKCLIENT_RTCHECK_H
+#include <stddef.h>
+#include <stdint.h>
+
+#include <ostream>
+#include <vector>
+
+enum class JackRTViolationType { MALLOC, FREE, LOCK };
+
+/** A heap call or blocking lock made inside a real-time scope. */
+struct JackRTViolation {
+    static const int MAX_FRAMES = 24;
+
+    JackRTViolationType type;
+    size_t size;
+    int depth;
+    void* frames[MAX_FRAMES];
+};
+
+/**
+ * Debug detector for heap use and blocking locks on real-time threads.
+ * Building with -DJACKCLIENT_RT_CHECKS interposes malloc, calloc, realloc,
+ * the aligned allocators and free, which operator new and delete go through,
+ * as well as pthread_mutex_lock. Any such call made while a Scope is open
+ * on the calling thread is recorded with a stack trace and handed to
+ * non-real-time threads through a lock-free ring; when the ring is busy or
+ * full the report is dropped and counted. JackClient opens a scope around
+ * every process callback. Without the flag scopes only set a thread local.
+ * */
+namespace JackRTCheck {
+/** Marks the current thread as real-time for its lifetime. Scopes nest. */
+class Scope {
+   public:
+    Scope();
+    ~Scope();
+};
+
+/** True if the interposers are compiled in. */
+bool isAvailable();
+/** Checking starts enabled when available. */
+void setEnabled(bool enabled);
+bool isEnabled();
+bool isRealtimeThread();
+/** Moves pending reports into out and returns how many were added. */
+size_t poll(std::vector<JackRTViolation>& out);
+uint64_t getViolationCount();
+uint64_t getDroppedCount();
+/** Writes pending reports with symbolized stack traces; not real-time safe. */
+void dump(std::ostream& out);
+}  // namespace JackRTCheck
+#endif
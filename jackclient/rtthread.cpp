@@ -0,0 +1,139 @@
+#include "rtthread.h"
+
+#include <alloca.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+
+static JackThreadStats readStats(pid_t tid, clockid_t clock, pthread_t handle) {
+    JackThreadStats stats = {};
+    char path[64];
+    char line[512];
+    snprintf(path, sizeof(path), "/proc/self/task/%d/stat", (int)tid);
+    if (FILE* file = fopen(path, "r")) {
+        if (fgets(line, sizeof(line), file)) {
+            // The command name may contain spaces; the fields start after its closing parenthesis.
+            const char* fields = strrchr(line, ')');
+            unsigned long minflt = 0, majflt = 0;
+            int cpu = -1;
+            if (fields &&
+                sscanf(fields + 2,
+                       "%*c %*d %*d %*d %*d %*d %*u %lu %*u %lu %*u %*u %*u %*d %*d %*d %*d "
+                       "%*d %*d %*u %*u %*d %*u %*u %*u %*u %*u %*u %*u %*u %*u %*u %*u %*u "
+                       "%*u %*d %d",
+                       &minflt, &majflt, &cpu) == 3) {
+                stats.minorFaults = minflt;
+                stats.majorFaults = majflt;
+                stats.cpu = cpu;
+            }
+        }
+        fclose(file);
+    }
+    snprintf(path, sizeof(path), "/proc/self/task/%d/status", (int)tid);
+    if (FILE* file = fopen(path, "r")) {
+        unsigned long long value;
+        while (fgets(line, sizeof(line), file)) {
+            if (sscanf(line, "voluntary_ctxt_switches: %llu", &value) == 1)
+                stats.voluntarySwitches = value;
+            else if (sscanf(line, "nonvoluntary_ctxt_switches: %llu", &value) == 1)
+                stats.involuntarySwitches = value;
+        }
+        fclose(file);
+    }
+    struct timespec ts;
+    if (clock_gettime(clock, &ts) == 0)
+        stats.cpuNanos = (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+    struct sched_param param;
+    if (pthread_getschedparam(handle, &stats.policy, &param) == 0)
+        stats.priority = param.sched_priority;
+    return stats;
+}
+
+JackRealtimeThread::JackRealtimeThread(JackClient* client, void* (*routine)(void* arg), void* arg,
+                                       const JackThreadOptions& options)
+    : client(client), routine(routine), arg(arg), options(options) {
+    if (options.lockMemory) lockMemory();
+    sem_init(&this->ready, 0, 0);
+    try {
+        this->thread = client->createRealtimeThread(&JackRealtimeThread::threadMain, this,
+                                                    options.priorityOffset);
+    } catch (...) {
+        sem_destroy(&this->ready);
+        throw;
+    }
+    while (sem_wait(&this->ready) != 0) {
+    }
+    if (this->failed) {
+        client->stopThread(this->thread);
+        sem_destroy(&this->ready);
+        throw JackClientException("Could not set thread affinity");
+    }
+}
+
+JackRealtimeThread::~JackRealtimeThread() {
+    this->client->stopThread(this->thread);
+    sem_destroy(&this->ready);
+}
+
+void* JackRealtimeThread::threadMain(void* arg) {
+    JackRealtimeThread* self = static_cast<JackRealtimeThread*>(arg);
+    self->setup();
+    bool failed = self->failed;
+    sem_post(&self->ready);
+    if (failed) return nullptr;
+    return self->routine(self->arg);
+}
+
+void JackRealtimeThread::setup() {
+    this->tid = (pid_t)syscall(SYS_gettid);
+    if (pthread_getcpuclockid(pthread_self(), &this->clock)) this->clock = CLOCK_THREAD_CPUTIME_ID;
+    if (this->options.name) pthread_setname_np(pthread_self(), this->options.name);
+    if (!this->options.cpus.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : this->options.cpus)
+            if (cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set)) this->failed = true;
+    }
+    if (this->options.prefaultStackBytes) prefaultStack(this->options.prefaultStackBytes);
+}
+
+JackThreadStats JackRealtimeThread::getStats() const {
+    return readStats(this->tid, this->clock, this->thread);
+}
+
+void JackRealtimeThread::lockMemory() {
+    if (mlockall(MCL_CURRENT | MCL_FUTURE))
+        throw JackClientException("Could not lock memory, check the memlock limit");
+}
+
+void JackRealtimeThread::prefaultStack(size_t bytes) {
+    pthread_attr_t attr;
+    void* base;
+    size_t size;
+    if (pthread_getattr_np(pthread_self(), &attr)) return;
+    int result = pthread_attr_getstack(&attr, &base, &size);
+    pthread_attr_destroy(&attr);
+    if (result) return;
+    // Leave a margin below the current frame for the calls still to come.
+    const size_t margin = 16384;
+    unsigned char* here = (unsigned char*)&attr;
+    size_t left = (size_t)(here - (unsigned char*)base);
+    if (left <= margin) return;
+    if (bytes > left - margin) bytes = left - margin;
+    volatile unsigned char* stack = (volatile unsigned char*)alloca(bytes);
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    for (size_t i = 0; i < bytes; i += page) stack[i] = 0;
+}
+
+JackThreadStats JackRealtimeThread::getCurrentStats() {
+    clockid_t clock;
+    if (pthread_getcpuclockid(pthread_self(), &clock)) clock = CLOCK_THREAD_CPUTIME_ID;
+    return readStats((pid_t)syscall(SYS_gettid), clock, pthread_self());
+}
@@ -0,0 +1,79 @@
+#ifndef _JACKCLIENT_RTTHREAD_H
+#define _JACKCLIENT_RTTHREAD_H
+#include <semaphore.h>
+#include <sys/types.h>
+
+#include <atomic>
+#include <vector>
+
+#include "jackclient.h"
+
+struct JackThreadOptions {
+    /** Added to the client's real-time priority, e.g. -1 for background work. */
+    int priorityOffset = 0;
+    /** CPUs the thread may run on; empty leaves the affinity alone. */
+    std::vector<int> cpus;
+    /** Stack touched before the routine starts, so it never page faults; capped to the stack. */
+    size_t prefaultStackBytes = 0;
+    /** Lock all current and future pages of the process (mlockall) before starting. */
+    bool lockMemory = false;
+    /** Thread name as shown by top -H, at most 15 characters. */
+    const char* name = nullptr;
+};
+
+/** Scheduling statistics of one thread, read from the kernel. */
+struct JackThreadStats {
+    int cpu;
+    int policy;
+    int priority;
+    uint64_t cpuNanos;
+    uint64_t voluntarySwitches;
+    uint64_t involuntarySwitches;
+    uint64_t minorFaults;
+    uint64_t majorFaults;
+};
+
+/**
+ * A helper thread in JACK's real-time scheduling class, created through
+ * jack_client_create_thread at a priority relative to the process thread.
+ * The thread is set up before the routine runs: it is pinned to the given
+ * CPUs, its stack is pre-faulted and it is named. The constructor waits
+ * for the setup and throws if the affinity could not be applied; the
+ * routine then never runs. The destructor waits for the routine to return,
+ * so the owner must make it stop first.
+ * */
+class JackRealtimeThread {
+   private:
+    JackClient* client;
+    void* (*routine)(void* arg);
+    void* arg;
+    JackThreadOptions options;
+    jack_native_thread_t thread;
+    pid_t tid = 0;
+    clockid_t clock;
+    bool failed = false;
+    sem_t ready;
+
+    static void* threadMain(void* arg);
+    void setup();
+
+   public:
+    JackRealtimeThread(JackClient* client, void* (*routine)(void* arg), void* arg,
+                       const JackThreadOptions& options = JackThreadOptions());
+    ~JackRealtimeThread();
+    JackRealtimeThread(const JackRealtimeThread&) = delete;
+    JackRealtimeThread& operator=(const JackRealtimeThread&) = delete;
+
+    jack_native_thread_t getHandle() const { return thread; };
+    pid_t getThreadId() const { return tid; };
+    /** Reads /proc; not real-time safe. */
+    JackThreadStats getStats() const;
+
+    /** mlockall(MCL_CURRENT | MCL_FUTURE) for the whole process; throws on failure. */
+    static void lockMemory();
+    /** Touches bytes of the calling thread's stack, capped to what is left of it. */
+    static void prefaultStack(size_t bytes);
+    /** Statistics of the calling thread. */
+    static JackThreadStats getCurrentStats();
+};
+#endif
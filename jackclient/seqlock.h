@@ -0,0 +1,58 @@
+#ifndef _JACKCLIENT_SEQLOCK_H
+#define _JACKCLIENT_SEQLOCK_H
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+
+/**
+ * Single-writer sequence lock for small trivially copyable values. The
+ * writer never waits; readers retry while a write is in progress. The value
+ * is kept in atomic words so concurrent reads are well defined.
+ * */
+template <typename T>
+class JackSeqLock {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "JackSeqLock requires a trivially copyable type");
+    static const size_t WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+   private:
+    std::atomic<uint32_t> sequence;
+    std::atomic<uint64_t> words[WORDS];
+
+   public:
+    JackSeqLock() : sequence(0) {
+        for (size_t i = 0; i < WORDS; i++) words[i].store(0, std::memory_order_relaxed);
+    };
+    explicit JackSeqLock(const T& value) : JackSeqLock() { store(value); };
+
+    /** Writer only. */
+    void store(const T& value) {
+        uint64_t buffer[WORDS] = {};
+        std::memcpy(buffer, &value, sizeof(T));
+        uint32_t seq = sequence.load(std::memory_order_relaxed);
+        sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < WORDS; i++) words[i].store(buffer[i], std::memory_order_relaxed);
+        sequence.store(seq + 2, std::memory_order_release);
+    };
+    /** Single attempt; false if a write was in progress. */
+    bool tryLoad(T& value) const {
+        uint64_t buffer[WORDS];
+        uint32_t seq = sequence.load(std::memory_order_acquire);
+        if (seq & 1) return false;
+        for (size_t i = 0; i < WORDS; i++) buffer[i] = words[i].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence.load(std::memory_order_relaxed) != seq) return false;
+        std::memcpy(&value, buffer, sizeof(T));
+        return true;
+    };
+    T load() const {
+        T value;
+        while (!tryLoad(value)) {
+        }
+        return value;
+    };
+    /** Number of completed writes. */
+    uint32_t getVersion() const { return sequence.load(std::memory_order_acquire) / 2; };
+};
+#endif
@@ -0,0 +1,1277 @@
+#include "simserver.h"
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <jack/intclient.h>
+#include <jack/jack.h>
+#include <jack/midiport.h>
+#include <jack/thread.h>
+#include <jack/transport.h>
+#include <pthread.h>
+#include <regex.h>
+#include <stdarg.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "jackclient.h"
+#include "seqlock.h"
+
+namespace {
+template <typename F>
+struct Callback {
+    F fn = nullptr;
+    void* arg = nullptr;
+};
+
+/** What jack_port_get_buffer returns for MIDI ports. Fixed capacity, so writing never allocates. */
+struct MIDIBuffer {
+    jack_nframes_t nframes = 0;
+    uint32_t lost = 0;
+    size_t used = 0;
+    std::vector<jack_midi_event_t> events;
+    std::vector<jack_midi_data_t> data;
+
+    void allocate(size_t bytes) {
+        this->data.resize(bytes);
+        this->events.reserve(bytes / 8 + 1);
+    };
+    void clear() {
+        this->events.clear();
+        this->used = 0;
+        this->lost = 0;
+    };
+    jack_midi_data_t* reserve(jack_nframes_t time, size_t size) {
+        if (time >= this->nframes || (!this->events.empty() && time < this->events.back().time))
+            return nullptr;
+        if (size == 0 || size > this->data.size() - this->used ||
+            this->events.size() == this->events.capacity()) {
+            this->lost++;
+            return nullptr;
+        }
+        jack_midi_event_t event;
+        event.time = time;
+        event.size = size;
+        event.buffer = this->data.data() + this->used;
+        this->used += size;
+        this->events.push_back(event);
+        return event.buffer;
+    };
+};
+
+struct FreeDeleter {
+    void operator()(float* p) const { free(p); };
+};
+}  // namespace
+
+struct _jack_port {
+    jack_port_id_t id;
+    jack_client_t* owner;
+    std::string name;
+    std::string shortName;
+    std::string type;
+    unsigned long flags;
+    bool midi;
+    bool alive = true;
+    std::unique_ptr<float[], FreeDeleter> audio;
+    MIDIBuffer midiBuffer;
+    /** Peers in both directions: sources of an input, destinations of an output. */
+    std::vector<jack_port_t*> connections;
+    /** Per-source read positions while merging MIDI, sized with connections. */
+    std::vector<uint32_t> cursors;
+    jack_latency_range_t latency[2] = {{0, 0}, {0, 0}};
+    /** Cycle the mix below was made for. */
+    uint64_t mixed = 0;
+    /** Events queued with JackSim::sendMIDI for system MIDI capture ports. */
+    std::vector<JackSimMIDIEvent> pending;
+};
+
+struct _jack_client {
+    std::string name;
+    bool active = false;
+    bool zombie = false;
+    std::vector<jack_port_t*> ports;
+    Callback<JackProcessCallback> process;
+    Callback<JackShutdownCallback> shutdown;
+    Callback<JackXRunCallback> xrun;
+    Callback<JackSyncCallback> sync;
+    Callback<JackTimebaseCallback> timebase;
+    Callback<JackLatencyCallback> latency;
+    Callback<JackBufferSizeCallback> bufferSize;
+    Callback<JackSampleRateCallback> sampleRate;
+    Callback<JackPortRegistrationCallback> portRegistration;
+    Callback<JackPortConnectCallback> portConnect;
+    Callback<JackPortRenameCallback> portRename;
+    Callback<JackClientRegistrationCallback> clientRegistration;
+};
+
+namespace {
+struct InternalClient {
+    jack_intclient_t id;
+    jack_client_t* client;
+    void* library;
+    void (*finish)(void* arg);
+};
+
+struct TransportSnapshot {
+    jack_transport_state_t state;
+    jack_position_t position;
+};
+
+enum TransportRequest { NONE, START, STOP };
+
+struct Server {
+    /** Guards the graph and is held for every cycle; calls made from process() do not take it. */
+    std::recursive_mutex mutex;
+    /** Held while a notification is delivered, so clients cannot close under it. */
+    std::recursive_mutex notifyMutex;
+    JackSimConfig config;
+    std::atomic<uint32_t> bufferSize{256};
+    std::atomic<uint32_t> sampleRate{48000};
+    bool down = false;
+    bool freewheel = false;
+    jack_client_t* system = nullptr;
+    std::vector<jack_client_t*> clients;
+    std::vector<std::unique_ptr<_jack_port>> ports;
+    std::vector<jack_client_t*> order;
+    bool orderDirty = true;
+    std::vector<InternalClient> internals;
+    jack_intclient_t nextInternal = 1;
+
+    std::atomic<uint64_t> cycle{0};
+    std::atomic<uint64_t> frameTime{0};
+    std::atomic<uint64_t> xruns{0};
+    std::atomic<float> load{0.0f};
+    std::function<void(uint32_t)> before;
+    std::function<void(uint32_t)> after;
+
+    jack_client_t* timebaseMaster = nullptr;
+    jack_transport_state_t transportState = JackTransportStopped;
+    jack_position_t position;
+    bool newPosition = false;
+    std::atomic<int> transportRequest{NONE};
+    std::atomic<int64_t> locateRequest{-1};
+    JackSeqLock<TransportSnapshot> transport;
+
+    std::thread driver;
+    std::atomic<bool> running{false};
+
+    std::mutex queueMutex;
+    std::condition_variable queueChanged;
+    std::deque<std::function<void()>> queue;
+    bool delivering = false;
+    bool notifying = false;
+    std::atomic<bool> latencyQueued{false};
+
+    Server() {
+        memset(&this->position, 0, sizeof(this->position));
+        this->publishTransport();
+    };
+    void publishTransport() {
+        TransportSnapshot snapshot;
+        snapshot.state = this->transportState;
+        snapshot.position = this->position;
+        this->transport.store(snapshot);
+    };
+};
+
+// Never destroyed: clients may still close from static destructors.
+Server& server() {
+    static Server* instance = new Server();
+    return *instance;
+}
+
+typedef std::lock_guard<std::recursive_mutex> Lock;
+
+void deliverNotifications(Server& s) {
+    std::unique_lock<std::mutex> lock(s.queueMutex);
+    for (;;) {
+        s.queueChanged.wait(lock, [&s] { return !s.queue.empty(); });
+        std::function<void()> notification = std::move(s.queue.front());
+        s.queue.pop_front();
+        s.delivering = true;
+        lock.unlock();
+        {
+            Lock notifying(s.notifyMutex);
+            notification();
+        }
+        lock.lock();
+        s.delivering = false;
+        s.queueChanged.notify_all();
+    }
+}
+
+void post(Server& s, std::function<void()> notification) {
+    std::lock_guard<std::mutex> lock(s.queueMutex);
+    if (!s.notifying) {
+        std::thread(deliverNotifications, std::ref(s)).detach();
+        s.notifying = true;
+    }
+    s.queue.push_back(std::move(notification));
+    s.queueChanged.notify_all();
+}
+
+bool isOpen(Server& s, jack_client_t* client) {
+    return std::find(s.clients.begin(), s.clients.end(), client) != s.clients.end();
+}
+
+/** Callbacks of the open clients, collected under the lock and called without it. */
+template <typename F>
+std::vector<Callback<F>> collect(Server& s, Callback<F> _jack_client::*member,
+                                 jack_client_t* except = nullptr, bool activeOnly = false) {
+    Lock lock(s.mutex);
+    std::vector<Callback<F>> callbacks;
+    for (jack_client_t* client : s.clients) {
+        if (client == except || client->zombie || (activeOnly && !client->active)) continue;
+        if ((client->*member).fn) callbacks.push_back(client->*member);
+    }
+    return callbacks;
+}
+
+void notifyPortRegistration(Server& s, jack_port_id_t id, int registered) {
+    post(s, [&s, id, registered] {
+        for (auto& callback : collect(s, &_jack_client::portRegistration))
+            callback.fn(id, registered, callback.arg);
+    });
+}
+
+void notifyConnection(Server& s, jack_port_id_t a, jack_port_id_t b, int connected) {
+    post(s, [&s, a, b, connected] {
+        for (auto& callback : collect(s, &_jack_client::portConnect))
+            callback.fn(a, b, connected, callback.arg);
+    });
+}
+
+void notifyClientRegistration(Server& s, jack_client_t* client, int registered) {
+    std::string name = client->name;
+    post(s, [&s, client, name, registered] {
+        for (auto& callback : collect(s, &_jack_client::clientRegistration, client))
+            callback.fn(name.c_str(), registered, callback.arg);
+    });
+}
+
+jack_latency_range_t peerLatency(jack_port_t* port, jack_latency_callback_mode_t mode) {
+    jack_latency_range_t range = {UINT32_MAX, 0};
+    for (jack_port_t* peer : port->connections) {
+        range.min = std::min(range.min, peer->latency[mode].min);
+        range.max = std::max(range.max, peer->latency[mode].max);
+    }
+    if (range.min > range.max) range.min = 0;
+    return range;
+}
+
+/**
+ * Capture latency flows from sources into inputs, playback latency from
+ * destinations into outputs. Without a latency callback a client passes
+ * the widest range straight through, as libjack does.
+ * */
+void receiveLatency(jack_client_t* client, jack_latency_callback_mode_t mode, bool passThrough) {
+    unsigned long into = mode == JackCaptureLatency ? JackPortIsInput : JackPortIsOutput;
+    jack_latency_range_t range = {UINT32_MAX, 0};
+    for (jack_port_t* port : client->ports) {
+        if (!(port->flags & into)) continue;
+        port->latency[mode] = peerLatency(port, mode);
+        range.min = std::min(range.min, port->latency[mode].min);
+        range.max = std::max(range.max, port->latency[mode].max);
+    }
+    if (!passThrough) return;
+    if (range.min > range.max) range.min = 0;
+    for (jack_port_t* port : client->ports)
+        if (!(port->flags & into)) port->latency[mode] = range;
+}
+
+void computeOrder(Server& s);
+
+void recomputeLatencies(Server& s) {
+    s.latencyQueued.store(false);
+    std::vector<jack_client_t*> order;
+    {
+        Lock lock(s.mutex);
+        if (s.orderDirty) computeOrder(s);
+        order = s.order;
+        jack_nframes_t period = s.bufferSize.load();
+        for (jack_port_t* port : s.system->ports) {
+            if (port->flags & JackPortIsOutput)
+                port->latency[JackCaptureLatency] = {period, period};
+            else
+                port->latency[JackPlaybackLatency] = {period, period};
+        }
+    }
+    for (jack_latency_callback_mode_t mode : {JackCaptureLatency, JackPlaybackLatency}) {
+        if (mode == JackPlaybackLatency) std::reverse(order.begin(), order.end());
+        for (jack_client_t* client : order) {
+            Callback<JackLatencyCallback> callback;
+            {
+                Lock lock(s.mutex);
+                if (!isOpen(s, client) || client->zombie) continue;
+                callback = client->latency;
+                receiveLatency(client, mode, callback.fn == nullptr);
+            }
+            if (callback.fn) callback.fn(mode, callback.arg);
+        }
+        Lock lock(s.mutex);
+        receiveLatency(s.system, mode, false);
+    }
+}
+
+void queueLatency(Server& s) {
+    if (s.latencyQueued.exchange(true)) return;
+    post(s, [&s] { recomputeLatencies(s); });
+}
+
+bool feeds(jack_client_t* from, jack_client_t* to) {
+    for (jack_port_t* port : to->ports) {
+        if (!(port->flags & JackPortIsInput)) continue;
+        for (jack_port_t* source : port->connections)
+            if (source->owner == from) return true;
+    }
+    return false;
+}
+
+/** Active clients with every client feeding them first; the rest of a feedback loop in order. */
+void computeOrder(Server& s) {
+    std::vector<jack_client_t*> pending;
+    for (jack_client_t* client : s.clients)
+        if (client != s.system && client->active && !client->zombie) pending.push_back(client);
+    s.order.clear();
+    while (!pending.empty()) {
+        bool progress = false;
+        for (auto it = pending.begin(); it != pending.end();) {
+            bool waiting = false;
+            for (jack_client_t* other : pending)
+                if (other != *it && feeds(other, *it)) waiting = true;
+            if (waiting) {
+                ++it;
+                continue;
+            }
+            s.order.push_back(*it);
+            it = pending.erase(it);
+            progress = true;
+        }
+        if (!progress) {
+            s.order.insert(s.order.end(), pending.begin(), pending.end());
+            break;
+        }
+    }
+    s.orderDirty = false;
+}
+
+void allocateBuffers(jack_port_t* port, jack_nframes_t nframes) {
+    if (port->midi) {
+        port->midiBuffer.nframes = nframes;
+        port->midiBuffer.clear();
+        return;
+    }
+    void* memory = nullptr;
+    if (posix_memalign(&memory, 64, sizeof(float) * nframes)) memory = nullptr;
+    port->audio.reset(static_cast<float*>(memory));
+    if (memory) memset(memory, 0, sizeof(float) * nframes);
+}
+
+jack_port_t* findPort(Server& s, const char* name) {
+    if (!name) return nullptr;
+    for (auto& port : s.ports)
+        if (port->alive && port->name == name) return port.get();
+    return nullptr;
+}
+
+jack_port_t* addPort(Server& s, jack_client_t* client, const std::string& shortName,
+                     const char* type, unsigned long flags) {
+    std::string name = client->name + ":" + shortName;
+    if (findPort(s, name.c_str())) return nullptr;
+    bool midi = strcmp(type, JACK_DEFAULT_MIDI_TYPE) == 0;
+    if (!midi && strcmp(type, JACK_DEFAULT_AUDIO_TYPE) != 0) return nullptr;
+    std::unique_ptr<_jack_port> port(new _jack_port());
+    port->id = (jack_port_id_t)s.ports.size();
+    port->owner = client;
+    port->name = name;
+    port->shortName = shortName;
+    port->type = type;
+    port->flags = flags;
+    port->midi = midi;
+    if (midi) port->midiBuffer.allocate(s.config.midiBufferBytes);
+    allocateBuffers(port.get(), s.bufferSize.load());
+    jack_port_t* handle = port.get();
+    s.ports.push_back(std::move(port));
+    client->ports.push_back(handle);
+    return handle;
+}
+
+void addSystemPorts(Server& s, const char* prefix, uint32_t count, const char* type,
+                    unsigned long flags) {
+    char name[64];
+    for (uint32_t i = 1; i <= count; i++) {
+        snprintf(name, sizeof(name), "%s_%u", prefix, i);
+        addPort(s, s.system, name, type, flags | JackPortIsPhysical | JackPortIsTerminal);
+    }
+}
+
+/** Creates the system client on first use, with the configuration or the defaults. */
+void boot(Server& s) {
+    if (s.system) return;
+    s.bufferSize.store(s.config.bufferSize);
+    s.sampleRate.store(s.config.sampleRate);
+    s.position.frame_rate = s.config.sampleRate;
+    s.publishTransport();
+    s.system = new _jack_client();
+    s.system->name = "system";
+    s.system->active = true;
+    s.clients.push_back(s.system);
+    const JackSimConfig& c = s.config;
+    addSystemPorts(s, "capture", c.audioInputs, JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput);
+    addSystemPorts(s, "playback", c.audioOutputs, JACK_DEFAULT_AUDIO_TYPE, JackPortIsInput);
+    addSystemPorts(s, "midi_capture", c.midiInputs, JACK_DEFAULT_MIDI_TYPE, JackPortIsOutput);
+    addSystemPorts(s, "midi_playback", c.midiOutputs, JACK_DEFAULT_MIDI_TYPE, JackPortIsInput);
+}
+
+void disconnectPort(Server& s, jack_port_t* port) {
+    for (jack_port_t* peer : port->connections) {
+        auto it = std::find(peer->connections.begin(), peer->connections.end(), port);
+        if (it != peer->connections.end()) peer->connections.erase(it);
+        peer->cursors.resize(peer->connections.size());
+        bool output = (port->flags & JackPortIsOutput) != 0;
+        notifyConnection(s, output ? port->id : peer->id, output ? peer->id : port->id, 0);
+    }
+    port->connections.clear();
+    port->cursors.clear();
+    s.orderDirty = true;
+}
+
+std::string uniqueName(Server& s, const char* requested, jack_options_t options,
+                       jack_status_t* status) {
+    auto taken = [&s](const std::string& name) {
+        for (jack_client_t* client : s.clients)
+            if (client->name == name) return true;
+        return false;
+    };
+    std::string name = requested ? requested : "";
+    if (!taken(name)) return name;
+    if (options & JackUseExactName) {
+        *status = (jack_status_t)(*status | JackFailure | JackNameNotUnique);
+        return std::string();
+    }
+    char suffix[8];
+    for (int i = 1; i < 100; i++) {
+        snprintf(suffix, sizeof(suffix), "-%02d", i);
+        if (!taken(name + suffix)) {
+            *status = (jack_status_t)(*status | JackNameNotUnique);
+            return name + suffix;
+        }
+    }
+    *status = (jack_status_t)(*status | JackFailure | JackNameNotUnique);
+    return std::string();
+}
+
+const char** makeList(const std::vector<const std::string*>& names) {
+    if (names.empty()) return nullptr;
+    // One block, freed by jack_free: the pointers, a terminating NULL, then the strings.
+    size_t bytes = (names.size() + 1) * sizeof(char*);
+    for (const std::string* name : names) bytes += name->size() + 1;
+    char** list = static_cast<char**>(malloc(bytes));
+    if (!list) return nullptr;
+    char* text = reinterpret_cast<char*>(list + names.size() + 1);
+    for (size_t i = 0; i < names.size(); i++) {
+        list[i] = text;
+        memcpy(text, names[i]->c_str(), names[i]->size() + 1);
+        text += names[i]->size() + 1;
+    }
+    list[names.size()] = nullptr;
+    return const_cast<const char**>(list);
+}
+
+void mixAudio(jack_port_t* port, jack_nframes_t nframes) {
+    float* out = port->audio.get();
+    memset(out, 0, sizeof(float) * nframes);
+    for (jack_port_t* source : port->connections) {
+        const float* in = source->audio.get();
+        for (jack_nframes_t i = 0; i < nframes; i++) out[i] += in[i];
+    }
+}
+
+void mergeMIDI(jack_port_t* port) {
+    MIDIBuffer& out = port->midiBuffer;
+    out.clear();
+    std::fill(port->cursors.begin(), port->cursors.end(), 0);
+    for (;;) {
+        // Earliest next event over all sources; ties keep connection order.
+        size_t best = SIZE_MAX;
+        for (size_t i = 0; i < port->connections.size(); i++) {
+            const MIDIBuffer& in = port->connections[i]->midiBuffer;
+            if (port->cursors[i] >= in.events.size()) continue;
+            if (best == SIZE_MAX || in.events[port->cursors[i]].time <
+                                        port->connections[best]->midiBuffer
+                                            .events[port->cursors[best]]
+                                            .time)
+                best = i;
+        }
+        if (best == SIZE_MAX) break;
+        const jack_midi_event_t& event =
+            port->connections[best]->midiBuffer.events[port->cursors[best]++];
+        if (jack_midi_data_t* data = out.reserve(event.time, event.size))
+            memcpy(data, event.buffer, event.size);
+    }
+    for (jack_port_t* source : port->connections) out.lost += source->midiBuffer.lost;
+}
+
+void prepareCapture(Server& s, jack_nframes_t nframes) {
+    for (jack_port_t* port : s.system->ports) {
+        if (!(port->flags & JackPortIsOutput)) continue;
+        if (port->midi)
+            port->midiBuffer.clear();
+        else
+            memset(port->audio.get(), 0, sizeof(float) * nframes);
+    }
+}
+
+void deliverMIDI(Server& s, jack_nframes_t nframes) {
+    for (jack_port_t* port : s.system->ports) {
+        if (!port->midi || port->pending.empty()) continue;
+        std::stable_sort(port->pending.begin(), port->pending.end(),
+                         [](const JackSimMIDIEvent& a, const JackSimMIDIEvent& b) {
+                             return a.time < b.time;
+                         });
+        for (const JackSimMIDIEvent& event : port->pending) {
+            jack_nframes_t time = std::min<jack_nframes_t>(event.time, nframes - 1);
+            if (jack_midi_data_t* data = port->midiBuffer.reserve(time, event.data.size()))
+                memcpy(data, event.data.data(), event.data.size());
+        }
+        port->pending.clear();
+    }
+}
+
+/**
+ * Applies the transport requests made since the last cycle. Slow-sync
+ * clients are polled while starting and once after a relocation while
+ * stopped; the timebase master then fills in the position the cycle runs
+ * at, which every client reads through jack_transport_query.
+ * */
+void updateTransport(Server& s, jack_nframes_t nframes) {
+    int request = s.transportRequest.exchange(NONE);
+    int64_t locate = s.locateRequest.exchange(-1);
+    if (locate >= 0) {
+        s.position.frame = (jack_nframes_t)locate;
+        s.newPosition = true;
+        if (s.transportState == JackTransportRolling) s.transportState = JackTransportStarting;
+    }
+    if (request == START && s.transportState == JackTransportStopped)
+        s.transportState = JackTransportStarting;
+    else if (request == STOP)
+        s.transportState = JackTransportStopped;
+    s.position.frame_rate = s.sampleRate.load();
+    s.position.usecs =
+        (jack_time_t)(s.frameTime.load() * 1000000.0 / (double)s.position.frame_rate);
+    if (s.transportState == JackTransportStarting ||
+        (s.newPosition && s.transportState == JackTransportStopped)) {
+        bool ready = true;
+        for (jack_client_t* client : s.order) {
+            if (!client->sync.fn) continue;
+            jack_position_t requested = s.position;
+            if (!client->sync.fn(s.transportState, &requested, client->sync.arg)) ready = false;
+        }
+        if (ready && s.transportState == JackTransportStarting)
+            s.transportState = JackTransportRolling;
+    }
+    jack_client_t* master = s.timebaseMaster;
+    if (master && master->active && master->timebase.fn &&
+        (s.transportState == JackTransportRolling || s.newPosition)) {
+        master->timebase.fn(s.transportState, nframes, &s.position, s.newPosition ? 1 : 0,
+                            master->timebase.arg);
+    } else if (!master) {
+        s.position.valid = (jack_position_bits_t)0;
+    }
+    s.newPosition = false;
+    s.position.unique_1++;
+    s.position.unique_2 = s.position.unique_1;
+    s.publishTransport();
+}
+
+bool runCycle(Server& s) {
+    Lock lock(s.mutex);
+    boot(s);
+    if (s.down) return false;
+    if (s.orderDirty) computeOrder(s);
+    jack_nframes_t nframes = s.bufferSize.load();
+    s.cycle.fetch_add(1);
+    prepareCapture(s, nframes);
+    updateTransport(s, nframes);
+    if (s.before) s.before(nframes);
+    deliverMIDI(s, nframes);
+    auto start = std::chrono::steady_clock::now();
+    for (jack_client_t* client : s.order) {
+        if (!client->active || !client->process.fn) continue;
+        // A failing client leaves the graph, as with the real server.
+        if (client->process.fn(nframes, client->process.arg)) {
+            client->active = false;
+            s.orderDirty = true;
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    float load = (float)(100.0 * elapsed.count() * s.sampleRate.load() / nframes);
+    s.load.store(s.load.load() + (load - s.load.load()) * 0.125f);
+    if (s.after) s.after(nframes);
+    if (s.transportState == JackTransportRolling) s.position.frame += nframes;
+    s.frameTime.fetch_add(nframes);
+    return true;
+}
+
+void notifyXRun(Server& s) {
+    s.xruns.fetch_add(1);
+    post(s, [&s] {
+        for (auto& callback : collect(s, &_jack_client::xrun, nullptr, true))
+            callback.fn(callback.arg);
+    });
+}
+
+void drive(Server& s, bool paced) {
+    auto next = std::chrono::steady_clock::now();
+    while (s.running.load()) {
+        auto start = std::chrono::steady_clock::now();
+        if (!runCycle(s)) break;
+        if (!paced) continue;
+        std::chrono::duration<double> period(s.bufferSize.load() / (double)s.sampleRate.load());
+        next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(period);
+        auto end = std::chrono::steady_clock::now();
+        if (end > next) {
+            // The cycle did not finish within its period: the hardware would have glitched.
+            if (end - start > period) notifyXRun(s);
+            next = end;
+        } else {
+            std::this_thread::sleep_until(next);
+        }
+    }
+    s.running.store(false);
+}
+
+jack_port_t* findPortLocked(const std::string& name) {
+    Server& s = server();
+    Lock lock(s.mutex);
+    boot(s);
+    return findPort(s, name.c_str());
+}
+}  // namespace
+
+namespace JackSim {
+void configure(const JackSimConfig& config) {
+    Server& s = server();
+    Lock lock(s.mutex);
+    if (s.clients.size() > 1)
+        throw JackClientException("cannot configure the simulated server while clients are open");
+    if (s.system) {
+        s.clients.clear();
+        s.ports.clear();
+        s.order.clear();
+        delete s.system;
+        s.system = nullptr;
+    }
+    s.config = config;
+    s.down = false;
+    s.freewheel = false;
+    s.orderDirty = true;
+    s.cycle.store(0);
+    s.frameTime.store(0);
+    s.xruns.store(0);
+    s.load.store(0.0f);
+    s.timebaseMaster = nullptr;
+    s.transportState = JackTransportStopped;
+    memset(&s.position, 0, sizeof(s.position));
+    boot(s);
+}
+
+JackSimConfig getConfig() {
+    Server& s = server();
+    Lock lock(s.mutex);
+    JackSimConfig config = s.config;
+    config.bufferSize = s.bufferSize.load();
+    config.sampleRate = s.sampleRate.load();
+    return config;
+}
+
+uint64_t run(uint64_t cycles) {
+    Server& s = server();
+    uint64_t done = 0;
+    while (done < cycles && runCycle(s)) done++;
+    return done;
+}
+
+void start(bool paced) {
+    Server& s = server();
+    if (s.running.exchange(true)) return;
+    if (s.driver.joinable()) s.driver.join();
+    s.driver = std::thread(drive, std::ref(s), paced);
+}
+
+void stop() {
+    Server& s = server();
+    s.running.store(false);
+    if (s.driver.joinable()) s.driver.join();
+}
+
+bool isRunning() { return server().running.load(); }
+
+void flush() {
+    Server& s = server();
+    std::unique_lock<std::mutex> lock(s.queueMutex);
+    s.queueChanged.wait(lock, [&s] { return s.queue.empty() && !s.delivering; });
+}
+
+void setCycleHooks(std::function<void(uint32_t)> before, std::function<void(uint32_t)> after) {
+    Server& s = server();
+    Lock lock(s.mutex);
+    s.before = std::move(before);
+    s.after = std::move(after);
+}
+
+void setBufferSize(uint32_t nframes) {
+    Server& s = server();
+    if (nframes == 0) return;
+    {
+        // Holding the lock keeps cycles out while the clients adapt, like the real server.
+        Lock lock(s.mutex);
+        boot(s);
+        s.bufferSize.store(nframes);
+        for (auto& port : s.ports)
+            if (port->alive) allocateBuffers(port.get(), nframes);
+        for (auto& callback : collect(s, &_jack_client::bufferSize))
+            callback.fn(nframes, callback.arg);
+    }
+    queueLatency(s);
+}
+
+void setSampleRate(uint32_t rate) {
+    Server& s = server();
+    if (rate == 0) return;
+    Lock lock(s.mutex);
+    boot(s);
+    s.sampleRate.store(rate);
+    for (auto& callback : collect(s, &_jack_client::sampleRate)) callback.fn(rate, callback.arg);
+}
+
+void triggerXRun() { notifyXRun(server()); }
+
+void triggerShutdown() {
+    Server& s = server();
+    {
+        Lock lock(s.mutex);
+        s.down = true;
+    }
+    post(s, [&s] {
+        for (auto& callback : collect(s, &_jack_client::shutdown)) callback.fn(callback.arg);
+        Lock lock(s.mutex);
+        for (jack_client_t* client : s.clients)
+            if (client != s.system) client->zombie = true;
+    });
+}
+
+void startTransport() { server().transportRequest.store(START); }
+
+void stopTransport() { server().transportRequest.store(STOP); }
+
+void locateTransport(uint32_t frame) { server().locateRequest.store(frame); }
+
+float* getAudioBuffer(const std::string& name) {
+    Server& s = server();
+    Lock lock(s.mutex);
+    jack_port_t* port = findPortLocked(name);
+    if (!port || port->midi) return nullptr;
+    return static_cast<float*>(jack_port_get_buffer(port, s.bufferSize.load()));
+}
+
+bool sendMIDI(const std::string& name, uint32_t time, const unsigned char* data, size_t size) {
+    Server& s = server();
+    Lock lock(s.mutex);
+    jack_port_t* port = findPortLocked(name);
+    if (!port || !port->midi || port->owner != s.system || !(port->flags & JackPortIsOutput))
+        return false;
+    port->pending.push_back({time, std::vector<unsigned char>(data, data + size)});
+    return true;
+}
+
+std::vector<JackSimMIDIEvent> getMIDIEvents(const std::string& name) {
+    Server& s = server();
+    Lock lock(s.mutex);
+    std::vector<JackSimMIDIEvent> events;
+    jack_port_t* port = findPortLocked(name);
+    if (!port || !port->midi) return events;
+    const MIDIBuffer* buffer =
+        static_cast<const MIDIBuffer*>(jack_port_get_buffer(port, s.bufferSize.load()));
+    for (const jack_midi_event_t& event : buffer->events)
+        events.push_back({event.time, std::vector<unsigned char>(event.buffer,
+                                                                 event.buffer + event.size)});
+    return events;
+}
+
+uint64_t getCycleCount() { return server().cycle.load(); }
+
+uint64_t getXRunCount() { return server().xruns.load(); }
+
+uint64_t getFrameTime() { return server().frameTime.load(); }
+
+float getLoad() { return server().load.load(); }
+}  // namespace JackSim
+
+extern "C" {
+jack_client_t* jack_client_open(const char* client_name, jack_options_t options,
+                                jack_status_t* status, ...) {
+    jack_status_t ignored;
+    if (!status) status = &ignored;
+    *status = (jack_status_t)0;
+    Server& s = server();
+    Lock lock(s.mutex);
+    boot(s);
+    if (s.down) {
+        *status = (jack_status_t)(JackFailure | JackServerFailed);
+        return nullptr;
+    }
+    std::string name = uniqueName(s, client_name, options, status);
+    if (name.empty()) return nullptr;
+    jack_client_t* client = new _jack_client();
+    client->name = name;
+    s.clients.push_back(client);
+    notifyClientRegistration(s, client, 1);
+    return client;
+}
+
+int jack_client_close(jack_client_t* client) {
+    Server& s = server();
+    // Wait for a notification in flight to this client before freeing it.
+    Lock notifying(s.notifyMutex);
+    Lock lock(s.mutex);
+    if (!client || client == s.system || !isOpen(s, client)) return -1;
+    for (jack_port_t* port : client->ports) {
+        disconnectPort(s, port);
+        port->alive = false;
+        port->owner = nullptr;
+        notifyPortRegistration(s, port->id, 0);
+    }
+    if (s.timebaseMaster == client) s.timebaseMaster = nullptr;
+    s.clients.erase(std::find(s.clients.begin(), s.clients.end(), client));
+    s.orderDirty = true;
+    notifyClientRegistration(s, client, 0);
+    delete client;
+    queueLatency(s);
+    return 0;
+}
+
+char* jack_get_client_name(jack_client_t* client) { return &client->name[0]; }
+
+int jack_activate(jack_client_t* client) {
+    Server& s = server();
+    {
+        Lock lock(s.mutex);
+        if (s.down || client->zombie) return -1;
+        client->active = true;
+        s.orderDirty = true;
+    }
+    queueLatency(s);
+    return 0;
+}
+
+int jack_deactivate(jack_client_t* client) {
+    Server& s = server();
+    Lock lock(s.mutex);
+    if (!client->active) return 0;
+    client->active = false;
+    for (jack_port_t* port : client->ports) disconnectPort(s, port);
+    s.orderDirty = true;
+    queueLatency(s);
+    return 0;
+}
+
+#define JACKSIM_SETTER(function, member, type)                                   \
+    int function(jack_client_t* client, type callback, void* arg) {             \
+        Lock lock(server().mutex);                                               \
+        client->member.fn = callback;                                            \
+        client->member.arg = arg;                                                \
+        return 0;                                                                \
+    }
+JACKSIM_SETTER(jack_set_process_callback, process, JackProcessCallback)
+JACKSIM_SETTER(jack_set_xrun_callback, xrun, JackXRunCallback)
+JACKSIM_SETTER(jack_set_sync_callback, sync, JackSyncCallback)
+JACKSIM_SETTER(jack_set_latency_callback, latency, JackLatencyCallback)
+JACKSIM_SETTER(jack_set_buffer_size_callback, bufferSize, JackBufferSizeCallback)
+JACKSIM_SETTER(jack_set_sample_rate_callback, sampleRate, JackSampleRateCallback)
+JACKSIM_SETTER(jack_set_port_registration_callback, portRegistration,
+               JackPortRegistrationCallback)
+JACKSIM_SETTER(jack_set_port_connect_callback, portConnect, JackPortConnectCallback)
+JACKSIM_SETTER(jack_set_port_rename_callback, portRename, JackPortRenameCallback)
+JACKSIM_SETTER(jack_set_client_registration_callback, clientRegistration,
+               JackClientRegistrationCallback)
+#undef JACKSIM_SETTER
+
+void jack_on_shutdown(jack_client_t* client, JackShutdownCallback callback, void* arg) {
+    Lock lock(server().mutex);
+    client->shutdown.fn = callback;
+    client->shutdown.arg = arg;
+}
+
+int jack_set_freewheel(jack_client_t* client, int onoff) {
+    Server& s = server();
+    Lock lock(s.mutex);
+    // Cycles already run as fast as the clients allow; the flag is only recorded.
+    s.freewheel = onoff != 0;
+    return 0;
+}
+
+int jack_set_buffer_size(jack_client_t* client, jack_nframes_t nframes) {
+    if (nframes == 0) return EINVAL;
+    JackSim::setBufferSize(nframes);
+    return 0;
+}
+
+jack_nframes_t jack_get_sample_rate(jack_client_t* client) { return server().sampleRate.load(); }
+
+jack_nframes_t jack_get_buffer_size(jack_client_t* client) { return server().bufferSize.load(); }
+
+float jack_cpu_load(jack_client_t* client) { return server().load.load(); }
+
+int jack_is_realtime(jack_client_t* client) { return 0; }
+
+jack_port_t* jack_port_register(jack_client_t* client, const char* port_name,
+                                const char* port_type, unsigned long flags,
+                                unsigned long buffer_size) {
+    Server& s = server();
+    Lock lock(s.mutex);
+    if (!port_name || !port_type || client->zombie) return nullptr;
+    jack_port_t* port = addPort(s, client, port_name, port_type, flags);
+    if (port) notifyPortRegistration(s, port->id, 1);
+    return port;
+}
+
+int jack_port_unregister(jack_client_t* client, jack_port_t* port) {
+    Server& s = server();
+    Lock lock(s.mutex);
+    if (port->owner != client || !port->alive) return -1;
+    disconnectPort(s, port);
+    port->alive = false;
+    client->ports.erase(std::find(client->ports.begin(), client->ports.end(), port));
+    notifyPortRegistration(s, port->id, 0);
+    return 0;
+}
+
+void* jack_port_get_buffer(jack_port_t* port, jack_nframes_t nframes) {
+    // Called from process(): reads the graph the cycle holds the lock for.
+    if (port->flags & JackPortIsOutput)
+        return port->midi ? static_cast<void*>(&port->midiBuffer) : port->audio.get();
+    if (port->connections.size() == 1) {
+        jack_port_t* source = port->connections[0];
+        return port->midi ? static_cast<void*>(&source->midiBuffer) : source->audio.get();
+    }
+    uint64_t cycle = server().cycle.load(std::memory_order_relaxed);
+    if (port->mixed != cycle) {
+        port->mixed = cycle;
+        if (port->midi)
+            mergeMIDI(port);
+        else
+            mixAudio(port, server().bufferSize.load(std::memory_order_relaxed));
+    }
+    return port->midi ? static_cast<void*>(&port->midiBuffer) : port->audio.get();
+}
+
+const char* jack_port_name(const jack_port_t* port) { return port->name.c_str(); }
+
+const char* jack_port_short_name(const jack_port_t* port) { return port->shortName.c_str(); }
+
+int jack_port_flags(const jack_port_t* port) { return (int)port->flags; }
+
+const char* jack_port_type(const jack_port_t* port) { return port->type.c_str(); }
+
+int jack_port_is_mine(const jack_client_t* client, const jack_port_t* port) {
+    return port->owner == client ? 1 : 0;
+}
+
+const char** jack_port_get_all_connections(const jack_client_t* client,
+                                           const jack_port_t* port) {
+    Lock lock(server().mutex);
+    std::vector<const std::string*> names;
+    for (jack_port_t* peer : port->connections) names.push_back(&peer->name);
+    return makeList(names);
+}
+
+int jack_connect(jack_client_t* client, const char* source_port, const char* destination_port) {
+    Server& s = server();
+    {
+        Lock lock(s.mutex);
+        jack_port_t* source = findPort(s, source_port);
+        jack_port_t* destination = findPort(s, destination_port);
+        if (!source || !destination || !(source->flags & JackPortIsOutput) ||
+            !(destination->flags & JackPortIsInput) || source->midi != destination->midi)
+            return -1;
+        if (std::find(source->connections.begin(), source->connections.end(), destination) !=
+            source->connections.end())
+            return EEXIST;
+        source->connections.push_back(destination);
+        destination->connections.push_back(source);
+        destination->cursors.resize(destination->connections.size());
+        s.orderDirty = true;
+        notifyConnection(s, source->id, destination->id, 1);
+    }
+    queueLatency(s);
+    return 0;
+}
+
+int jack_disconnect(jack_client_t* client, const char* source_port,
+                    const char* destination_port) {
+    Server& s = server();
+    {
+        Lock lock(s.mutex);
+        jack_port_t* source = findPort(s, source_port);
+        jack_port_t* destination = findPort(s, destination_port);
+        if (!source || !destination) return -1;
+        auto it = std::find(source->connections.begin(), source->connections.end(), destination);
+        if (it == source->connections.end()) return -1;
+        source->connections.erase(it);
+        destination->connections.erase(std::find(destination->connections.begin(),
+                                                 destination->connections.end(), source));
+        destination->cursors.resize(destination->connections.size());
+        s.orderDirty = true;
+        notifyConnection(s, source->id, destination->id, 0);
+    }
+    queueLatency(s);
+    return 0;
+}
+
+int jack_port_disconnect(jack_client_t* client, jack_port_t* port) {
+    Server& s = server();
+    {
+        Lock lock(s.mutex);
+        disconnectPort(s, port);
+    }
+    queueLatency(s);
+    return 0;
+}
+
+void jack_port_get_latency_range(jack_port_t* port, jack_latency_callback_mode_t mode,
+                                 jack_latency_range_t* range) {
+    Lock lock(server().mutex);
+    *range = port->latency[mode];
+}
+
+void jack_port_set_latency_range(jack_port_t* port, jack_latency_callback_mode_t mode,
+                                 jack_latency_range_t* range) {
+    Lock lock(server().mutex);
+    port->latency[mode] = *range;
+}
+
+int jack_recompute_total_latencies(jack_client_t* client) {
+    queueLatency(server());
+    return 0;
+}
+
+const char** jack_get_ports(jack_client_t* client, const char* port_name_pattern,
+                            const char* type_name_pattern, unsigned long flags) {
+    regex_t namePattern, typePattern;
+    bool byName = port_name_pattern && *port_name_pattern;
+    bool byType = type_name_pattern && *type_name_pattern;
+    if (byName && regcomp(&namePattern, port_name_pattern, REG_EXTENDED | REG_NOSUB))
+        return nullptr;
+    if (byType && regcomp(&typePattern, type_name_pattern, REG_EXTENDED | REG_NOSUB)) {
+        if (byName) regfree(&namePattern);
+        return nullptr;
+    }
+    Server& s = server();
+    std::vector<const std::string*> names;
+    {
+        Lock lock(s.mutex);
+        boot(s);
+        for (auto& port : s.ports) {
+            if (!port->alive || (port->flags & flags) != flags) continue;
+            if (byName && regexec(&namePattern, port->name.c_str(), 0, nullptr, 0)) continue;
+            if (byType && regexec(&typePattern, port->type.c_str(), 0, nullptr, 0)) continue;
+            names.push_back(&port->name);
+        }
+    }
+    if (byName) regfree(&namePattern);
+    if (byType) regfree(&typePattern);
+    // Port objects are never freed, so the names stay valid after the lock is released.
+    return makeList(names);
+}
+
+jack_port_t* jack_port_by_name(jack_client_t* client, const char* port_name) {
+    Lock lock(server().mutex);
+    return findPort(server(), port_name);
+}
+
+jack_port_t* jack_port_by_id(jack_client_t* client, jack_port_id_t port_id) {
+    Server& s = server();
+    Lock lock(s.mutex);
+    return port_id < s.ports.size() ? s.ports[port_id].get() : nullptr;
+}
+
+jack_nframes_t jack_frames_since_cycle_start(const jack_client_t* client) { return 0; }
+
+jack_nframes_t jack_frame_time(const jack_client_t* client) {
+    return (jack_nframes_t)server().frameTime.load(std::memory_order_relaxed);
+}
+
+jack_nframes_t jack_last_frame_time(const jack_client_t* client) {
+    return (jack_nframes_t)server().frameTime.load(std::memory_order_relaxed);
+}
+
+jack_time_t jack_get_time() {
+    return (jack_time_t)std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void jack_free(void* ptr) { free(ptr); }
+
+int jack_client_real_time_priority(jack_client_t* client) { return -1; }
+
+int jack_client_create_thread(jack_client_t* client, jack_native_thread_t* thread, int priority,
+                              int realtime, void* (*start_routine)(void*), void* arg) {
+    return pthread_create(thread, nullptr, start_routine, arg);
+}
+
+int jack_client_stop_thread(jack_client_t* client, jack_native_thread_t thread) {
+    return pthread_join(thread, nullptr);
+}
+
+int jack_set_timebase_callback(jack_client_t* client, int conditional,
+                               JackTimebaseCallback timebase_callback, void* arg) {
+    Server& s = server();
+    Lock lock(s.mutex);
+    if (conditional && s.timebaseMaster && s.timebaseMaster != client) return EBUSY;
+    client->timebase.fn = timebase_callback;
+    client->timebase.arg = arg;
+    s.timebaseMaster = client;
+    // The new master fills in the position on the next cycle even while stopped.
+    s.newPosition = true;
+    return 0;
+}
+
+int jack_release_timebase(jack_client_t* client) {
+    Server& s = server();
+    Lock lock(s.mutex);
+    if (s.timebaseMaster != client) return EINVAL;
+    s.timebaseMaster = nullptr;
+    client->timebase = Callback<JackTimebaseCallback>();
+    return 0;
+}
+
+jack_transport_state_t jack_transport_query(const jack_client_t* client, jack_position_t* pos) {
+    TransportSnapshot snapshot = server().transport.load();
+    if (pos) *pos = snapshot.position;
+    return snapshot.state;
+}
+
+void jack_transport_start(jack_client_t* client) { JackSim::startTransport(); }
+
+void jack_transport_stop(jack_client_t* client) { JackSim::stopTransport(); }
+
+int jack_transport_locate(jack_client_t* client, jack_nframes_t frame) {
+    JackSim::locateTransport(frame);
+    return 0;
+}
+
+uint32_t jack_midi_get_event_count(void* port_buffer) {
+    return (uint32_t) static_cast<MIDIBuffer*>(port_buffer)->events.size();
+}
+
+int jack_midi_event_get(jack_midi_event_t* event, void* port_buffer, uint32_t event_index) {
+    MIDIBuffer* buffer = static_cast<MIDIBuffer*>(port_buffer);
+    if (event_index >= buffer->events.size()) return ENODATA;
+    *event = buffer->events[event_index];
+    return 0;
+}
+
+void jack_midi_clear_buffer(void* port_buffer) { static_cast<MIDIBuffer*>(port_buffer)->clear(); }
+
+size_t jack_midi_max_event_size(void* port_buffer) {
+    MIDIBuffer* buffer = static_cast<MIDIBuffer*>(port_buffer);
+    return buffer->data.size() - buffer->used;
+}
+
+jack_midi_data_t* jack_midi_event_reserve(void* port_buffer, jack_nframes_t time,
+                                          size_t data_size) {
+    return static_cast<MIDIBuffer*>(port_buffer)->reserve(time, data_size);
+}
+
+int jack_midi_event_write(void* port_buffer, jack_nframes_t time, const jack_midi_data_t* data,
+                          size_t data_size) {
+    jack_midi_data_t* event = static_cast<MIDIBuffer*>(port_buffer)->reserve(time, data_size);
+    if (!event) return ENOBUFS;
+    memcpy(event, data, data_size);
+    return 0;
+}
+
+uint32_t jack_midi_get_lost_event_count(void* port_buffer) {
+    return static_cast<MIDIBuffer*>(port_buffer)->lost;
+}
+
+jack_intclient_t jack_internal_client_load(jack_client_t* client, const char* client_name,
+                                           jack_options_t options, jack_status_t* status, ...) {
+    jack_status_t ignored;
+    if (!status) status = &ignored;
+    const char* loadName = client_name;
+    const char* loadInit = "";
+    va_list args;
+    va_start(args, status);
+    if (options & JackLoadName) loadName = va_arg(args, const char*);
+    if (options & JackLoadInit) loadInit = va_arg(args, const char*);
+    va_end(args);
+    *status = (jack_status_t)0;
+    void* library = dlopen(loadName, RTLD_NOW | RTLD_LOCAL);
+    int (*initialize)(jack_client_t*, const char*) = nullptr;
+    void (*finish)(void*) = nullptr;
+    if (library) {
+        initialize = (int (*)(jack_client_t*, const char*))dlsym(library, "jack_initialize");
+        finish = (void (*)(void*))dlsym(library, "jack_finish");
+    }
+    if (!initialize) {
+        if (library) dlclose(library);
+        *status = (jack_status_t)(JackFailure | JackLoadFailure);
+        return 0;
+    }
+    jack_client_t* handle = jack_client_open(
+        client_name, (jack_options_t)(options & JackUseExactName), status);
+    if (!handle) {
+        dlclose(library);
+        return 0;
+    }
+    if (initialize(handle, loadInit)) {
+        jack_client_close(handle);
+        dlclose(library);
+        *status = (jack_status_t)(*status | JackFailure | JackInitFailure);
+        return 0;
+    }
+    Server& s = server();
+    Lock lock(s.mutex);
+    jack_intclient_t id = s.nextInternal++;
+    s.internals.push_back({id, handle, library, finish});
+    return id;
+}
+
+jack_status_t jack_internal_client_unload(jack_client_t* client, jack_intclient_t intclient) {
+    Server& s = server();
+    InternalClient internal;
+    {
+        Lock lock(s.mutex);
+        auto it = std::find_if(s.internals.begin(), s.internals.end(),
+                               [intclient](const InternalClient& c) { return c.id == intclient; });
+        if (it == s.internals.end()) return (jack_status_t)(JackFailure | JackNoSuchClient);
+        internal = *it;
+        s.internals.erase(it);
+    }
+    if (internal.finish) internal.finish(internal.client->process.arg);
+    jack_client_close(internal.client);
+    dlclose(internal.library);
+    return (jack_status_t)0;
+}
+
+char* jack_get_internal_client_name(jack_client_t* client, jack_intclient_t intclient) {
+    Server& s = server();
+    Lock lock(s.mutex);
+    for (const InternalClient& internal : s.internals)
+        if (internal.id == intclient) return strdup(internal.client->name.c_str());
+    return nullptr;
+}
+}
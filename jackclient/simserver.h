@@ -0,0 +1,100 @@
+#ifndef _JACKCLIENT_SIMSERVER_H
+#define _JACKCLIENT_SIMSERVER_H
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+struct JackSimConfig {
+    uint32_t sampleRate = 48000;
+    uint32_t bufferSize = 256;
+    /** Ports of the "system" client: system:capture_N, system:playback_N and so on. */
+    uint32_t audioInputs = 2;
+    uint32_t audioOutputs = 2;
+    uint32_t midiInputs = 1;
+    uint32_t midiOutputs = 1;
+    /** Bytes of event data a MIDI port buffer holds; further events are lost and counted. */
+    size_t midiBufferBytes = 32768;
+};
+
+struct JackSimMIDIEvent {
+    uint32_t time;
+    std::vector<unsigned char> data;
+};
+
+/**
+ * An in-process JACK server for running clients without jackd or audio
+ * hardware. jackclient/simserver.cpp defines the part of the libjack API
+ * this library uses; link it instead of libjack (the simbench target does)
+ * and JackClient, its ports and helpers run unchanged against a simulated
+ * graph. The backend is chosen at link time, so the real-time path has no
+ * extra indirection with either.
+ *
+ * The server models clients, audio and MIDI ports, connections with mixing
+ * of multiple sources, latency propagation, transport with sync and
+ * timebase callbacks, buffer size and sample rate changes, xruns and
+ * shutdown. Cycles run in the calling thread with run(), as fast as the
+ * clients allow, or on a driver thread with start(), optionally paced to
+ * the sample rate; a paced cycle that overruns its period counts as an
+ * xrun. Process callbacks run in the order of the connection graph.
+ * Notifications (registrations, connections, latency) are delivered from a
+ * separate thread like the real server does; flush() waits for them.
+ * Frame times follow the simulated clock; jack_get_time reads the system
+ * clock, as libjack does, so time budgets inside process() still hold.
+ *
+ * Internal clients are loaded with dlopen; they find the simulated API only
+ * if the program is linked with -rdynamic.
+ * */
+namespace JackSim {
+/** Resets the server. Must be called before any client is opened, or not at all. */
+void configure(const JackSimConfig& config);
+JackSimConfig getConfig();
+
+/** Runs cycles in the calling thread and returns how many ran. */
+uint64_t run(uint64_t cycles);
+/** Runs cycles on a driver thread until stop(); paced cycles wait for the period to pass. */
+void start(bool paced = false);
+void stop();
+bool isRunning();
+/** Waits until every queued notification has been delivered. */
+void flush();
+
+/** Called on the cycle thread before and after the clients run, with the cycle's frame count. */
+void setCycleHooks(std::function<void(uint32_t)> before, std::function<void(uint32_t)> after);
+
+/** Changes the period between cycles and notifies every client, as jack_set_buffer_size does. */
+void setBufferSize(uint32_t nframes);
+void setSampleRate(uint32_t rate);
+/** Notifies every client of an xrun. */
+void triggerXRun();
+/** Stops processing and calls every client's shutdown callback. */
+void triggerShutdown();
+
+void startTransport();
+void stopTransport();
+void locateTransport(uint32_t frame);
+
+/**
+ * Audio buffer of any port for the current cycle, e.g. system:capture_1 to
+ * feed a signal in a before hook or system:playback_1 to read the result in
+ * an after hook. nullptr for unknown or MIDI ports.
+ * */
+float* getAudioBuffer(const std::string& port);
+/**
+ * Queues an event for a system MIDI capture port in the next cycle, or the
+ * current one from a before hook; false if the port is unknown.
+ * */
+bool sendMIDI(const std::string& port, uint32_t time, const unsigned char* data, size_t size);
+/** Events in a MIDI port's buffer in the current cycle, e.g. system:midi_playback_1. */
+std::vector<JackSimMIDIEvent> getMIDIEvents(const std::string& port);
+
+uint64_t getCycleCount();
+uint64_t getXRunCount();
+/** Frames since the server started; jack_frame_time. */
+uint64_t getFrameTime();
+/** Time the clients spent in the last cycles as a percentage of the period, smoothed. */
+float getLoad();
+}  // namespace JackSim
+#endif
@@ -0,0 +1,214 @@
+#ifndef _JACKCLIENT_STATICCLIENT_H
+#define _JACKCLIENT_STATICCLIENT_H
+#include <array>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "cyclestats.h"
+#include "jackclient.h"
+
+/**
+ * Port kinds for JackStaticClient. Each one knows how to register itself and
+ * which buffer type its process() argument has.
+ * */
+struct JackStaticAudioIn {
+    typedef const float* Buffer;
+    static const char* type() { return JACK_DEFAULT_AUDIO_TYPE; };
+    static const unsigned long FLAGS = JackPortIsInput;
+    static Buffer fetch(jack_port_t* port, jack_nframes_t nframes) {
+        return static_cast<const float*>(jack_port_get_buffer(port, nframes));
+    };
+};
+
+struct JackStaticAudioOut {
+    typedef float* Buffer;
+    static const char* type() { return JACK_DEFAULT_AUDIO_TYPE; };
+    static const unsigned long FLAGS = JackPortIsOutput;
+    static Buffer fetch(jack_port_t* port, jack_nframes_t nframes) {
+        return static_cast<float*>(jack_port_get_buffer(port, nframes));
+    };
+};
+
+struct JackStaticMIDIIn {
+    typedef JackMIDIEventRange Buffer;
+    static const char* type() { return JACK_DEFAULT_MIDI_TYPE; };
+    static const unsigned long FLAGS = JackPortIsInput;
+    static Buffer fetch(jack_port_t* port, jack_nframes_t nframes) {
+        return JackMIDIEventRange(jack_port_get_buffer(port, nframes));
+    };
+};
+
+/** Passed to process() already cleared; write with jack_midi_event_write/reserve. */
+struct JackStaticMIDIOut {
+    typedef void* Buffer;
+    static const char* type() { return JACK_DEFAULT_MIDI_TYPE; };
+    static const unsigned long FLAGS = JackPortIsOutput;
+    static Buffer fetch(jack_port_t* port, jack_nframes_t nframes) {
+        void* buffer = jack_port_get_buffer(port, nframes);
+        jack_midi_clear_buffer(buffer);
+        return buffer;
+    };
+};
+
+namespace JackStaticDetail {
+template <typename T, typename = void>
+struct HasTransportSync : std::false_type {};
+template <typename T>
+struct HasTransportSync<T, decltype((void)std::declval<T&>().transportSync(
+                               std::declval<Transport::JackTransportState>(),
+                               std::declval<Transport::JackPosition*>()))> : std::true_type {};
+
+template <typename T, typename = void>
+struct HasTimebase : std::false_type {};
+template <typename T>
+struct HasTimebase<T, decltype((void)std::declval<T&>().timebase(
+                          std::declval<Transport::JackTransportState>(), uint32_t(),
+                          std::declval<Transport::JackPosition*>(), bool()))> : std::true_type {};
+
+template <typename T, typename = void>
+struct HasXRun : std::false_type {};
+template <typename T>
+struct HasXRun<T, decltype((void)std::declval<T&>().xrun(std::declval<const JackXRunReport&>()))>
+    : std::true_type {};
+
+template <typename T, typename = void>
+struct HasLatency : std::false_type {};
+template <typename T>
+struct HasLatency<T, decltype((void)std::declval<T&>().latency(
+                         std::declval<jack_latency_callback_mode_t>()))> : std::true_type {};
+}  // namespace JackStaticDetail
+
+/**
+ * Client base whose callbacks are bound at compile time. The process
+ * callback registered with JACK is a function template that casts straight
+ * to Derived and calls
+ *
+ *     int process(uint32_t nframes, Ports::Buffer... buffers);
+ *
+ * with one argument per port, fetched by generated code, so small DSP can
+ * be inlined into the callback. The optional members
+ *
+ *     int transportSync(Transport::JackTransportState, Transport::JackPosition*);
+ *     void timebase(Transport::JackTransportState, uint32_t, Transport::JackPosition*, bool);
+ *     void xrun(const JackXRunReport&);
+ *     void latency(jack_latency_callback_mode_t);
+ *
+ * are registered only if Derived declares them; nothing is registered, and
+ * nothing is dispatched, for the others. The latency callback is the
+ * exception: it is always registered to keep JackLatencyCompensators up to
+ * date and without latency() falls back to JackClient::propagateLatency()
+ * over the ports of this class and any created through JackClient.
+ * The members must be accessible to JackStaticClient. Use open() of this
+ * class, not of JackClient.
+ * */
+template <typename Derived, typename... Ports>
+class JackStaticClient : public JackClient {
+   public:
+    static constexpr size_t PORT_COUNT = sizeof...(Ports);
+    typedef std::array<const char*, PORT_COUNT> PortNames;
+
+   private:
+    PortNames portNames;
+    std::array<jack_port_t*, PORT_COUNT> handles{};
+
+    static Derived& self(void* arg) {
+        return *static_cast<Derived*>(static_cast<JackStaticClient*>(arg));
+    };
+
+    template <size_t... I>
+    int dispatch(jack_nframes_t nframes, std::index_sequence<I...>) {
+        return static_cast<Derived*>(this)->process(nframes, Ports::fetch(handles[I], nframes)...);
+    };
+
+    template <size_t... I>
+    void registerPorts(std::index_sequence<I...>) {
+        int unused[] = {0, (handles[I] = jack_port_register(getHandle(), portNames[I],
+                                                            Ports::type(), Ports::FLAGS, 0),
+                            0)...};
+        (void)unused;
+        for (jack_port_t* handle : handles)
+            if (!handle) throw JackClientException("Could not register port");
+    };
+
+    // Never called: processCallback dispatches to Derived::process() directly.
+    int onProcess(const JackPortBuffers&, uint32_t) final { return 0; };
+
+    static int processCallback(jack_nframes_t nframes, void* arg) {
+        Derived& client = self(arg);
+        CycleScope cycle(client, nframes);
+        // As in JackClient::process, running out of arena memory silences the cycle.
+        try {
+            return client.dispatch(nframes, std::index_sequence_for<Ports...>());
+        } catch (std::bad_alloc&) {
+            cycle.fail(client.handles.data(), PORT_COUNT);
+            return 0;
+        }
+    };
+    static int syncCallback(jack_transport_state_t state, jack_position_t* pos, void* arg) {
+        return self(arg).transportSync(static_cast<Transport::JackTransportState>(state), pos);
+    };
+    static void timebaseCallback(jack_transport_state_t state, jack_nframes_t nframes,
+                                 jack_position_t* pos, int newPos, void* arg) {
+        self(arg).timebase(static_cast<Transport::JackTransportState>(state), nframes, pos,
+                           newPos ? true : false);
+    };
+    static int xrunCallback(void* arg) {
+        Derived& client = self(arg);
+        client.xrun(client.captureXRunReport());
+        return 0;
+    };
+    static void latencyCallback(jack_latency_callback_mode_t mode, void* arg) {
+        Derived& client = self(arg);
+        client.updateLatencyCompensation((JackLatencyMode)mode);
+        client.dispatchLatency(mode, JackStaticDetail::HasLatency<Derived>());
+    };
+    void dispatchLatency(jack_latency_callback_mode_t mode, std::true_type) {
+        static_cast<Derived*>(this)->latency(mode);
+    };
+    void dispatchLatency(jack_latency_callback_mode_t mode, std::false_type) {
+        this->propagateLatency((JackLatencyMode)mode, handles.data(), PORT_COUNT);
+    };
+
+    void registerSync(std::true_type) {
+        jack_set_sync_callback(getHandle(), &JackStaticClient::syncCallback, this);
+    };
+    void registerSync(std::false_type){};
+    void registerXRun(std::true_type) {
+        jack_set_xrun_callback(getHandle(), &JackStaticClient::xrunCallback, this);
+    };
+    void registerXRun(std::false_type){};
+
+   public:
+    JackStaticClient(const char* name, const PortNames& portNames,
+                     size_t commandQueueSize = 1024)
+        : JackClient(name, commandQueueSize), portNames(portNames){};
+
+    void open() {
+        this->openConnection();
+        if (!getHandle()) return;
+        registerPorts(std::index_sequence_for<Ports...>());
+        jack_set_process_callback(getHandle(), &JackStaticClient::processCallback, this);
+        registerSync(JackStaticDetail::HasTransportSync<Derived>());
+        registerXRun(JackStaticDetail::HasXRun<Derived>());
+        jack_set_latency_callback(getHandle(), &JackStaticClient::latencyCallback, this);
+    };
+    void enableTimebaseMaster() {
+        static_assert(JackStaticDetail::HasTimebase<Derived>::value,
+                      "enableTimebaseMaster() requires Derived::timebase()");
+        if (jack_set_timebase_callback(getHandle(), 0, &JackStaticClient::timebaseCallback, this))
+            throw JackClientException("Could not enable Timebase Master");
+    };
+    template <size_t I>
+    jack_port_t* getPortHandle() const {
+        static_assert(I < PORT_COUNT, "port index out of range");
+        return handles[I];
+    };
+    /** Full name ("client:port") of a port, e.g. for a JackConnectionPlan. */
+    std::string getPortName(size_t index) const { return jack_port_name(handles[index]); };
+};
+
+template <typename Derived, typename... Ports>
+constexpr size_t JackStaticClient<Derived, Ports...>::PORT_COUNT;
+#endif
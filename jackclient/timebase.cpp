@@ -0,0 +1,135 @@
+#include "timebase.h"
+
+#include <algorithm>
+#include <cmath>
+
+JackTempoMap::JackTempoMap(uint32_t sampleRate, double beatsPerMinute, float beatsPerBar,
+                           float beatType, double ticksPerBeat)
+    : sampleRate(sampleRate), ticksPerBeat(ticksPerBeat) {
+    if (sampleRate == 0) throw JackClientException("Sample rate must not be 0");
+    this->segments.push_back({0, beatsPerMinute, beatsPerBar, beatType, 0, 0.0, 0.0});
+}
+
+void JackTempoMap::addChange(uint64_t frame, double beatsPerMinute, float beatsPerBar,
+                             float beatType) {
+    if (beatsPerMinute <= 0.0 || beatsPerBar <= 0.0f)
+        throw JackClientException("Tempo and beats per bar must be positive");
+    Segment segment = {frame, beatsPerMinute, beatsPerBar, beatType, 0, 0.0, 0.0};
+    auto it = std::lower_bound(this->segments.begin(), this->segments.end(), frame,
+                               [](const Segment& s, uint64_t f) { return s.frame < f; });
+    if (it != this->segments.end() && it->frame == frame)
+        *it = segment;
+    else
+        this->segments.insert(it, segment);
+    this->computePositions();
+}
+
+void JackTempoMap::computePositions() {
+    double ticksPerBeat = this->ticksPerBeat;
+    for (size_t i = 1; i < this->segments.size(); i++) {
+        const Segment& prev = this->segments[i - 1];
+        Segment& segment = this->segments[i];
+        double beat = prev.beat + this->beatsSince(prev, segment.frame);
+        double bars = std::floor(beat / prev.beatsPerBar);
+        beat -= bars * prev.beatsPerBar;
+        segment.bar = prev.bar + (int64_t)bars;
+        segment.barStartTick = prev.barStartTick + bars * prev.beatsPerBar * ticksPerBeat;
+        // A new meter starts on a bar line; the partial bar before it counts as a whole one.
+        bool meter = segment.beatsPerBar != prev.beatsPerBar || segment.beatType != prev.beatType;
+        if (meter && beat > 1e-9) {
+            segment.bar++;
+            segment.barStartTick += beat * ticksPerBeat;
+            beat = 0.0;
+        }
+        segment.beat = beat;
+    }
+}
+
+size_t JackTempoMap::findSegment(uint64_t frame) const {
+    auto it = std::upper_bound(this->segments.begin(), this->segments.end(), frame,
+                               [](uint64_t f, const Segment& s) { return f < s.frame; });
+    return (size_t)(it - this->segments.begin()) - 1;
+}
+
+JackBBT JackTempoMap::toBBT(size_t index, double beats) const {
+    const Segment& segment = this->segments[index];
+    double beat = segment.beat + beats;
+    double bars = std::floor(beat / segment.beatsPerBar);
+    beat -= bars * segment.beatsPerBar;
+    JackBBT bbt;
+    bbt.bar = (int32_t)(segment.bar + (int64_t)bars) + 1;
+    bbt.beat = (int32_t)beat;
+    double tick = (beat - bbt.beat) * this->ticksPerBeat;
+    bbt.tick = std::min((int32_t)tick, (int32_t)this->ticksPerBeat - 1);
+    bbt.beat++;
+    bbt.barStartTick = segment.barStartTick + bars * segment.beatsPerBar * this->ticksPerBeat;
+    bbt.beatsPerMinute = segment.beatsPerMinute;
+    bbt.beatsPerBar = segment.beatsPerBar;
+    bbt.beatType = segment.beatType;
+    return bbt;
+}
+
+uint64_t JackTempoMap::getNextChange(uint64_t frame) const {
+    size_t next = this->findSegment(frame) + 1;
+    return next < this->segments.size() ? this->segments[next].frame : ~0ull;
+}
+
+JackTimebaseMaster::JackTimebaseMaster(const JackTempoMap& map)
+    : map(new JackTempoMap(map)), pending(nullptr), retired(nullptr), relocations(0) {}
+
+JackTimebaseMaster::~JackTimebaseMaster() {
+    delete this->pending.load();
+    delete this->retired.load();
+    delete this->map;
+}
+
+void JackTimebaseMaster::setTempoMap(const JackTempoMap& map) {
+    delete this->retired.exchange(nullptr, std::memory_order_acquire);
+    // A map that was never picked up can be freed right away.
+    delete this->pending.exchange(new JackTempoMap(map), std::memory_order_acq_rel);
+}
+
+void JackTimebaseMaster::update(Transport::JackTransportState state, uint32_t nframes,
+                                Transport::JackPosition* pos, bool newPos) {
+    // Only take a new map once the previous one has been freed, so none is ever lost.
+    if (!this->retired.load(std::memory_order_relaxed)) {
+        JackTempoMap* next = this->pending.exchange(nullptr, std::memory_order_acq_rel);
+        if (next) {
+            this->retired.store(this->map, std::memory_order_release);
+            this->map = next;
+            this->anchored = false;
+        }
+    }
+    const JackTempoMap& map = *this->map;
+    const std::vector<JackTempoMap::Segment>& segments = map.getSegments();
+    uint32_t frame = pos->frame;
+    if (!this->anchored || newPos || frame != this->nextFrame) {
+        this->segment = map.findSegment(frame);
+        this->beats = map.beatsSince(segments[this->segment], frame);
+        this->beatsPerFrame = map.getBeatsPerFrame(this->segment);
+        this->anchored = true;
+        this->relocations.fetch_add(1, std::memory_order_relaxed);
+    } else if (this->segment + 1 < segments.size() &&
+               frame >= segments[this->segment + 1].frame) {
+        // Re-anchor on the change itself, so the new tempo starts at its exact frame.
+        while (this->segment + 1 < segments.size() && frame >= segments[this->segment + 1].frame)
+            this->segment++;
+        this->beats = map.beatsSince(segments[this->segment], frame);
+        this->beatsPerFrame = map.getBeatsPerFrame(this->segment);
+    } else {
+        this->beats += (double)(frame - this->frame) * this->beatsPerFrame;
+    }
+    this->frame = frame;
+    this->nextFrame = state == Transport::JackTransportState::ROLLING ? frame + nframes : frame;
+
+    JackBBT bbt = map.toBBT(this->segment, this->beats);
+    pos->valid = (jack_position_bits_t)(pos->valid | JackPositionBBT);
+    pos->bar = bbt.bar;
+    pos->beat = bbt.beat;
+    pos->tick = bbt.tick;
+    pos->bar_start_tick = bbt.barStartTick;
+    pos->beats_per_bar = bbt.beatsPerBar;
+    pos->beat_type = bbt.beatType;
+    pos->ticks_per_beat = map.getTicksPerBeat();
+    pos->beats_per_minute = bbt.beatsPerMinute;
+}
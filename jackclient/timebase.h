@@ -0,0 +1,113 @@
+#ifndef _JACKCLIENT_TIMEBASE_H
+#define _JACKCLIENT_TIMEBASE_H
+#include <atomic>
+#include <vector>
+
+#include "jackclient.h"
+
+/** Musical position of a frame; bar and beat count from 1 as in JACK. */
+struct JackBBT {
+    int32_t bar;
+    int32_t beat;
+    int32_t tick;
+    double barStartTick;
+    double beatsPerMinute;
+    float beatsPerBar;
+    float beatType;
+};
+
+/**
+ * Tempo and meter changes at exact frames, built before use and read-only
+ * afterwards. The bar position at the start of every segment is computed
+ * when changes are added, so locating a frame is a binary search plus a few
+ * multiplications. A tempo change continues the current bar; a change of
+ * meter starts a new bar, rounding up if it falls inside one.
+ * */
+class JackTempoMap {
+   public:
+    struct Segment {
+        uint64_t frame;
+        double beatsPerMinute;
+        float beatsPerBar;
+        float beatType;
+        // Position at frame, computed from the previous segments.
+        int64_t bar;
+        double beat;
+        double barStartTick;
+    };
+
+   private:
+    uint32_t sampleRate;
+    double ticksPerBeat;
+    std::vector<Segment> segments;
+
+    void computePositions();
+
+   public:
+    JackTempoMap(uint32_t sampleRate, double beatsPerMinute = 120.0, float beatsPerBar = 4.0f,
+                 float beatType = 4.0f, double ticksPerBeat = 1920.0);
+    /** Changes tempo and meter from frame on; replaces a change at the same frame. */
+    void addChange(uint64_t frame, double beatsPerMinute, float beatsPerBar, float beatType);
+
+    /** Index of the segment containing frame. */
+    size_t findSegment(uint64_t frame) const;
+    /** Beats from the segment's start to frame, which must lie in the segment. */
+    double beatsSince(const Segment& segment, uint64_t frame) const {
+        return (double)(frame - segment.frame) * segment.beatsPerMinute / (60.0 * sampleRate);
+    };
+    /** BBT of the point beats into segment index. */
+    JackBBT toBBT(size_t index, double beats) const;
+    JackBBT locate(uint64_t frame) const {
+        size_t index = findSegment(frame);
+        return toBBT(index, beatsSince(segments[index], frame));
+    };
+    /** First change after frame, or ~0 if there is none, to split a cycle at a tempo change. */
+    uint64_t getNextChange(uint64_t frame) const;
+
+    uint32_t getSampleRate() const { return sampleRate; };
+    double getTicksPerBeat() const { return ticksPerBeat; };
+    double getBeatsPerFrame(size_t index) const {
+        return segments[index].beatsPerMinute / (60.0 * sampleRate);
+    };
+    const std::vector<Segment>& getSegments() const { return segments; };
+};
+
+/**
+ * Timebase master on top of JackClient::enableTimebaseMaster(): call
+ * update() from onTimebase (or timebase() of a JackStaticClient) and it
+ * fills in the BBT fields from a JackTempoMap. While the transport moves on
+ * by whole cycles the position is advanced from the previous cycle and only
+ * re-anchored at tempo changes; after a relocate the frame is looked up in
+ * the map.
+ *
+ * setTempoMap() hands a new map to the timebase thread without locking;
+ * the replaced map is freed by the next setTempoMap() or the destructor,
+ * never in the callback.
+ * */
+class JackTimebaseMaster {
+   private:
+    JackTempoMap* map;
+    std::atomic<JackTempoMap*> pending;
+    std::atomic<JackTempoMap*> retired;
+    size_t segment = 0;
+    double beats = 0.0;
+    double beatsPerFrame = 0.0;
+    uint32_t frame = 0;
+    uint32_t nextFrame = 0;
+    bool anchored = false;
+    std::atomic<uint64_t> relocations;
+
+   public:
+    explicit JackTimebaseMaster(const JackTempoMap& map);
+    ~JackTimebaseMaster();
+    JackTimebaseMaster(const JackTimebaseMaster&) = delete;
+    JackTimebaseMaster& operator=(const JackTimebaseMaster&) = delete;
+    /** Replaces the tempo map from the next callback on; not real-time safe. */
+    void setTempoMap(const JackTempoMap& map);
+    /** Fills pos with BBT for pos->frame. Timebase callback only. */
+    void update(Transport::JackTransportState state, uint32_t nframes,
+                Transport::JackPosition* pos, bool newPos);
+    /** Callbacks that had to look the frame up in the map instead of advancing. */
+    uint64_t getRelocationCount() const { return relocations.load(std::memory_order_relaxed); };
+};
+#endif
@@ -0,0 +1,342 @@
+#include "wavfile.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+
+#include "audiokernels.h"
+#include "jackclient.h"
+
+static const uint32_t JUNK_SIZE = 28;  // room for the ds64 chunk without a table
+static const uint16_t FORMAT_PCM = 1;
+static const uint16_t FORMAT_FLOAT = 3;
+static const uint16_t FORMAT_EXTENSIBLE = 0xfffe;
+
+static unsigned char* put16(unsigned char* p, uint16_t value) {
+    p[0] = value & 0xff;
+    p[1] = value >> 8;
+    return p + 2;
+}
+
+static unsigned char* put32(unsigned char* p, uint32_t value) {
+    for (int i = 0; i < 4; i++) p[i] = (value >> (8 * i)) & 0xff;
+    return p + 4;
+}
+
+static unsigned char* put64(unsigned char* p, uint64_t value) {
+    for (int i = 0; i < 8; i++) p[i] = (value >> (8 * i)) & 0xff;
+    return p + 8;
+}
+
+static uint16_t get16(const unsigned char* p) { return p[0] | p[1] << 8; }
+
+static uint32_t get32(const unsigned char* p) { return get16(p) | (uint32_t)get16(p + 2) << 16; }
+
+static uint64_t get64(const unsigned char* p) { return get32(p) | (uint64_t)get32(p + 4) << 32; }
+
+static unsigned char* putTag(unsigned char* p, const char* tag) {
+    std::memcpy(p, tag, 4);
+    return p + 4;
+}
+
+static uint32_t sampleBytes(JackSampleFormat format) {
+    switch (format) {
+        case JackSampleFormat::PCM16:
+            return 2;
+        case JackSampleFormat::PCM24:
+            return 3;
+        default:
+            return 4;
+    }
+}
+
+JackWavWriter::JackWavWriter(const std::string& path, uint32_t channels, uint32_t sampleRate,
+                             JackSampleFormat format, size_t bufferBytes)
+    : path(path),
+      channels(channels),
+      sampleRate(sampleRate),
+      format(format),
+      bytesPerSample(sampleBytes(format)) {
+    if (channels == 0) throw JackClientException("WAV file needs at least one channel");
+    size_t frameBytes = channels * this->bytesPerSample;
+    size_t size = bufferBytes / frameBytes * frameBytes;
+    this->staging.resize(size ? size : frameBytes);
+    this->fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (this->fd < 0) throw JackClientException("Could not open " + path + " for writing");
+    this->writeHeader();
+}
+
+JackWavWriter::~JackWavWriter() {
+    try {
+        this->close();
+    } catch (JackClientException&) {
+    }
+}
+
+void JackWavWriter::writeHeader() {
+    bool isFloat = this->format == JackSampleFormat::FLOAT32;
+    unsigned char header[128] = {};
+    unsigned char* p = header;
+    p = putTag(p, "RIFF");
+    p = put32(p, 0);
+    p = putTag(p, "WAVE");
+    p = putTag(p, "JUNK");
+    p = put32(p, JUNK_SIZE);
+    p += JUNK_SIZE;
+    p = putTag(p, "fmt ");
+    p = put32(p, isFloat ? 18 : 16);
+    p = put16(p, isFloat ? FORMAT_FLOAT : FORMAT_PCM);
+    p = put16(p, this->channels);
+    p = put32(p, this->sampleRate);
+    p = put32(p, this->sampleRate * this->channels * this->bytesPerSample);
+    p = put16(p, this->channels * this->bytesPerSample);
+    p = put16(p, this->bytesPerSample * 8);
+    if (isFloat) {
+        p = put16(p, 0);
+        // Non-PCM formats carry the frame count in a fact chunk.
+        p = putTag(p, "fact");
+        p = put32(p, 4);
+        this->factOffset = p - header;
+        p = put32(p, 0);
+    }
+    p = putTag(p, "data");
+    p = put32(p, 0);
+    this->headerSize = p - header;
+    this->writeAll(header, this->headerSize);
+}
+
+void JackWavWriter::writeAll(const unsigned char* data, size_t size) {
+    while (size) {
+        ssize_t written = ::write(this->fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            throw JackClientException("Could not write to " + this->path);
+        }
+        data += written;
+        size -= written;
+    }
+}
+
+void JackWavWriter::writeAt(uint64_t offset, const unsigned char* data, size_t size) {
+    if (::pwrite(this->fd, data, size, offset) != (ssize_t)size)
+        throw JackClientException("Could not update header of " + this->path);
+}
+
+void JackWavWriter::convert(unsigned char* dst, const float* const* src, uint32_t offset,
+                            uint32_t nframes) {
+    uint32_t channels = this->channels;
+    switch (this->format) {
+        case JackSampleFormat::FLOAT32:
+            // WAV is little-endian like every host JACK runs on, so floats are copied as is.
+            for (uint32_t i = 0; i < nframes; i++)
+                for (uint32_t c = 0; c < channels; c++, dst += 4)
+                    std::memcpy(dst, src[c] + offset + i, 4);
+            break;
+        case JackSampleFormat::PCM16:
+            for (uint32_t i = 0; i < nframes; i++)
+                for (uint32_t c = 0; c < channels; c++) {
+                    float s = fminf(fmaxf(src[c][offset + i], -1.0f), 1.0f);
+                    dst = put16(dst, (uint16_t)(int16_t)lrintf(s * 32767.0f));
+                }
+            break;
+        case JackSampleFormat::PCM24:
+            for (uint32_t i = 0; i < nframes; i++)
+                for (uint32_t c = 0; c < channels; c++) {
+                    float s = fminf(fmaxf(src[c][offset + i], -1.0f), 1.0f);
+                    uint32_t v = (uint32_t)(int32_t)lrintf(s * 8388607.0f);
+                    *dst++ = v & 0xff;
+                    *dst++ = (v >> 8) & 0xff;
+                    *dst++ = (v >> 16) & 0xff;
+                }
+            break;
+    }
+}
+
+void JackWavWriter::write(const float* const* src, uint32_t nframes) {
+    if (this->fd < 0) throw JackClientException("WAV file is closed");
+    size_t frameBytes = this->channels * this->bytesPerSample;
+    uint32_t done = 0;
+    while (done < nframes) {
+        size_t room = (this->staging.size() - this->staged) / frameBytes;
+        uint32_t count = nframes - done < room ? nframes - done : (uint32_t)room;
+        this->convert(this->staging.data() + this->staged, src, done, count);
+        this->staged += count * frameBytes;
+        done += count;
+        if (this->staged == this->staging.size()) this->flush();
+    }
+    this->frames += nframes;
+}
+
+void JackWavWriter::flush() {
+    if (this->fd < 0 || !this->staged) return;
+    this->writeAll(this->staging.data(), this->staged);
+    this->staged = 0;
+}
+
+void JackWavWriter::close() {
+    if (this->fd < 0) return;
+    this->flush();
+    uint64_t dataBytes = this->getDataBytes();
+    if (dataBytes & 1) {
+        unsigned char pad = 0;
+        this->writeAll(&pad, 1);
+    }
+    uint64_t riffSize = this->headerSize - 8 + dataBytes + (dataBytes & 1);
+    unsigned char field[4];
+    if (riffSize > 0xffffffffull) {
+        // Too large for 32 bit sizes: turn the JUNK chunk into ds64 and mark the file RF64.
+        unsigned char ds64[8 + JUNK_SIZE];
+        unsigned char* p = putTag(ds64, "ds64");
+        p = put32(p, JUNK_SIZE);
+        p = put64(p, riffSize);
+        p = put64(p, dataBytes);
+        p = put64(p, this->frames);
+        put32(p, 0);
+        this->writeAt(12, ds64, sizeof(ds64));
+        putTag(field, "RF64");
+        this->writeAt(0, field, 4);
+        put32(field, 0xffffffff);
+        this->writeAt(4, field, 4);
+        this->writeAt(this->headerSize - 4, field, 4);
+        if (this->factOffset) this->writeAt(this->factOffset, field, 4);
+    } else {
+        put32(field, (uint32_t)riffSize);
+        this->writeAt(4, field, 4);
+        put32(field, (uint32_t)dataBytes);
+        this->writeAt(this->headerSize - 4, field, 4);
+        if (this->factOffset) {
+            put32(field, (uint32_t)this->frames);
+            this->writeAt(this->factOffset, field, 4);
+        }
+    }
+    int result = ::close(this->fd);
+    this->fd = -1;
+    if (result) throw JackClientException("Could not close " + this->path);
+}
+
+JackWavReader::JackWavReader(const std::string& path, uint32_t bufferFrames) : path(path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw JackClientException("Could not open " + path + " for reading");
+    struct stat info;
+    if (fstat(fd, &info) || info.st_size < 12) {
+        ::close(fd);
+        throw JackClientException(path + " is not a WAV file");
+    }
+    void* ptr = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (ptr == MAP_FAILED) throw JackClientException("Could not map " + path);
+    this->map = static_cast<const unsigned char*>(ptr);
+    this->mapSize = info.st_size;
+    madvise(ptr, this->mapSize, MADV_SEQUENTIAL);
+    try {
+        this->parse();
+    } catch (JackClientException&) {
+        munmap(ptr, this->mapSize);
+        throw;
+    }
+    this->staging.resize((size_t)(bufferFrames ? bufferFrames : 1) * this->channels);
+}
+
+JackWavReader::~JackWavReader() {
+    if (this->map) munmap((void*)this->map, this->mapSize);
+}
+
+void JackWavReader::parse() {
+    const unsigned char* p = this->map;
+    const unsigned char* end = this->map + this->mapSize;
+    bool rf64 = !std::memcmp(p, "RF64", 4);
+    if ((!rf64 && std::memcmp(p, "RIFF", 4)) || std::memcmp(p + 8, "WAVE", 4))
+        throw JackClientException(this->path + " is not a WAV file");
+    uint64_t dataSize64 = 0;
+    uint16_t formatTag = 0;
+    uint16_t bits = 0;
+    p += 12;
+    while (end - p >= 8) {
+        uint64_t size = get32(p + 4);
+        const unsigned char* body = p + 8;
+        if (!std::memcmp(p, "ds64", 4) && size >= 16) {
+            dataSize64 = get64(body + 8);
+        } else if (!std::memcmp(p, "fmt ", 4) && size >= 16 && end - body >= 16) {
+            formatTag = get16(body);
+            this->channels = get16(body + 2);
+            this->sampleRate = get32(body + 4);
+            this->frameBytes = get16(body + 12);
+            bits = get16(body + 14);
+            // The sub format GUID starts with the actual format tag.
+            if (formatTag == FORMAT_EXTENSIBLE && size >= 40 && end - body >= 40)
+                formatTag = get16(body + 24);
+        } else if (!std::memcmp(p, "data", 4)) {
+            if (rf64 && size == 0xffffffff) size = dataSize64;
+            // Files cut short, e.g. by a crashed recorder, are read up to their end.
+            if (size > (uint64_t)(end - body)) size = end - body;
+            this->data = body;
+            this->frames = this->frameBytes ? size / this->frameBytes : 0;
+            break;
+        }
+        if (size > (uint64_t)(end - body)) break;
+        p = body + size + (size & 1);
+    }
+    if (!this->data || !this->channels)
+        throw JackClientException(this->path + " has no audio data");
+    if (formatTag == FORMAT_FLOAT && bits == 32)
+        this->format = JackSampleFormat::FLOAT32;
+    else if (formatTag == FORMAT_PCM && bits == 16)
+        this->format = JackSampleFormat::PCM16;
+    else if (formatTag == FORMAT_PCM && bits == 24)
+        this->format = JackSampleFormat::PCM24;
+    else
+        throw JackClientException(this->path + " has an unsupported sample format");
+    if (this->frameBytes != this->channels * sampleBytes(this->format))
+        throw JackClientException(this->path + " has an invalid block alignment");
+}
+
+void JackWavReader::willNeed(uint64_t frame, uint64_t nframes) {
+    if (frame >= this->frames) return;
+    if (nframes > this->frames - frame) nframes = this->frames - frame;
+    // madvise wants a page aligned start.
+    uintptr_t start = (uintptr_t)(this->data + frame * this->frameBytes);
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t aligned = start & ~(page - 1);
+    madvise((void*)aligned, start - aligned + nframes * this->frameBytes, MADV_WILLNEED);
+}
+
+uint32_t JackWavReader::read(uint64_t frame, float* const* dst, uint32_t nframes) {
+    if (frame >= this->frames) return 0;
+    if (nframes > this->frames - frame) nframes = (uint32_t)(this->frames - frame);
+    uint32_t channels = this->channels;
+    uint32_t step = (uint32_t)(this->staging.size() / channels);
+    float* planar[64];
+    uint32_t done = 0;
+    while (done < nframes) {
+        uint32_t count = nframes - done < step ? nframes - done : step;
+        const unsigned char* src = this->data + (frame + done) * this->frameBytes;
+        float* staged = this->staging.data();
+        switch (this->format) {
+            case JackSampleFormat::PCM16:
+                AudioKernels::fromPCM16(staged, (const int16_t*)src, count * channels);
+                break;
+            case JackSampleFormat::PCM24:
+                AudioKernels::fromPCM24(staged, src, count * channels);
+                break;
+            default:
+                std::memcpy(staged, src, (size_t)count * this->frameBytes);
+                break;
+        }
+        if (channels == 1) {
+            std::memcpy(dst[0] + done, staged, count * sizeof(float));
+        } else if (channels <= 64) {
+            for (uint32_t c = 0; c < channels; c++) planar[c] = dst[c] + done;
+            AudioKernels::deinterleave(planar, staged, channels, count);
+        } else {
+            for (uint32_t c = 0; c < channels; c++)
+                for (uint32_t i = 0; i < count; i++) dst[c][done + i] = staged[i * channels + c];
+        }
+        done += count;
+    }
+    return nframes;
+}
@@ -0,0 +1,91 @@
+#ifndef _JACKCLIENT_WAVFILE_H
+#define _JACKCLIENT_WAVFILE_H
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+enum class JackSampleFormat { PCM16, PCM24, FLOAT32 };
+
+/**
+ * Streaming WAV writer. A JUNK chunk reserves room for a ds64 chunk, so a
+ * file that grows past 4 GiB is turned into RF64 when it is closed. Samples
+ * are converted into a large staging buffer and written in few big blocks.
+ * Not real-time safe; meant for a disk thread.
+ * */
+class JackWavWriter {
+   private:
+    int fd = -1;
+    std::string path;
+    uint32_t channels;
+    uint32_t sampleRate;
+    JackSampleFormat format;
+    uint32_t bytesPerSample;
+    size_t headerSize = 0;
+    size_t factOffset = 0;
+    uint64_t frames = 0;
+    std::vector<unsigned char> staging;
+    size_t staged = 0;
+
+    void writeHeader();
+    void writeAll(const unsigned char* data, size_t size);
+    void writeAt(uint64_t offset, const unsigned char* data, size_t size);
+    void convert(unsigned char* dst, const float* const* src, uint32_t offset, uint32_t nframes);
+
+   public:
+    /** bufferBytes: size of the staging buffer, i.e. of every write to the file. */
+    JackWavWriter(const std::string& path, uint32_t channels, uint32_t sampleRate,
+                  JackSampleFormat format = JackSampleFormat::FLOAT32,
+                  size_t bufferBytes = 4 << 20);
+    ~JackWavWriter();
+    /** Appends nframes of planar audio, one buffer per channel. */
+    void write(const float* const* src, uint32_t nframes);
+    void flush();
+    /** Flushes, fixes up the chunk sizes and closes the file. Called by the destructor. */
+    void close();
+    bool isOpen() const { return fd >= 0; };
+    uint64_t getFrameCount() const { return frames; };
+    uint32_t getChannelCount() const { return channels; };
+    uint64_t getDataBytes() const { return frames * channels * bytesPerSample; };
+};
+
+/**
+ * WAV and RF64 reader that maps the file into memory. PCM16, PCM24 and
+ * float files, also in WAVE_FORMAT_EXTENSIBLE, are converted to planar
+ * floats with the vectorised AudioKernels. Page faults happen in read(), so
+ * like the writer it belongs on a disk thread.
+ * */
+class JackWavReader {
+   private:
+    std::string path;
+    const unsigned char* map = nullptr;
+    size_t mapSize = 0;
+    const unsigned char* data = nullptr;
+    uint32_t channels = 0;
+    uint32_t sampleRate = 0;
+    JackSampleFormat format = JackSampleFormat::FLOAT32;
+    uint32_t frameBytes = 0;
+    uint64_t frames = 0;
+    std::vector<float> staging;
+
+    void parse();
+
+   public:
+    /** bufferFrames: frames converted per step of read(). */
+    explicit JackWavReader(const std::string& path, uint32_t bufferFrames = 4096);
+    ~JackWavReader();
+    JackWavReader(const JackWavReader&) = delete;
+    JackWavReader& operator=(const JackWavReader&) = delete;
+    /**
+     * Converts up to nframes starting at frame into one buffer per channel and
+     * returns the number of frames read, which is less at the end of the file.
+     * */
+    uint32_t read(uint64_t frame, float* const* dst, uint32_t nframes);
+    /** Asks the kernel to start reading the given range ahead of time. */
+    void willNeed(uint64_t frame, uint64_t nframes);
+    uint32_t getChannelCount() const { return channels; };
+    uint32_t getSampleRate() const { return sampleRate; };
+    JackSampleFormat getFormat() const { return format; };
+    uint64_t getFrameCount() const { return frames; };
+};
+#endif
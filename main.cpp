@@ -1,5 +1,7 @@
 #include <iostream>
 
+#include "jackclient/audiokernels.h"
+#include "jackclient/internalclient.h"
 #include "jackclient/jackclient.h"
 
 class ExampleClient : public JackClient {
@@ -27,13 +29,17 @@ class ExampleClient : public JackClient {
     ~ExampleClient() { this->close(); }
 
    protected:
-    int onProcess(uint32_t sampleCount) {
-        float *out = outPort->getBuffer();
-        float *in = inPort->getBuffer();
-        for (uint32_t i = 0; i < sampleCount; i++) (*out++) = in[i];
+    int onProcess(const JackPortBuffers &buffers, uint32_t sampleCount) {
+        float *out = buffers.getBuffer(*outPort);
+        float *in = buffers.getBuffer(*inPort);
+        AudioKernels::copy(out, in, sampleCount);
         return 0;
     }
 };
+#ifdef JACKCLIENT_INTERNAL
+// `make internal` builds example_client.so, e.g. for jack_load example /path/example_client.so
+JACKCLIENT_INTERNAL_CLIENT(ExampleClient)
+#else
 int main() {
     try {
         ExampleClient client;
@@ -45,3 +51,4 @@ int main() {
     }
     return 0;
 }
+#endif